@@ -0,0 +1,966 @@
+// Standalone benchmark of the kernels, pair scheduling, NUMA placement and
+// parallel backends of the lab, and of the erf, reduction, lazy expression,
+// thread pool and sumunif examples of the slides, on synthetic data from a
+// fixed generator and without R.
+//
+// Usage: hausdorff_bench [--quick] [--filter TEXT] [--repetitions R]
+//                        [--output FILE] [--baseline FILE] [--threshold T]
+//
+// The results are written as JSON, one benchmark per line. With `--baseline`,
+// each benchmark is compared with the one of the same name and parameters in
+// a previous output, and the program fails if any is more than `threshold`
+// (0.1 by default) slower.
+
+#include "curve_layout.h"
+#include "hausdorff_sample.h"
+#include "numa_placement.h"
+#include "pair_scheduler.h"
+
+#include "erf-simd.h"
+#include "lazy-expr.h"
+#include "persistent-pool.h"
+#include "reductions.h"
+
+#include <boost/math/special_functions/erf.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef BENCH_HAVE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
+
+#ifdef BENCH_HAVE_SITMO
+#include <sitmo.h>
+#include "rng-streams.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchOptions
+{
+  bool quick = false;
+  std::string filter;
+  unsigned int repetitions = 5;
+  std::string output;
+  std::string baseline;
+  double threshold = 0.1;
+};
+
+struct BenchResult
+{
+  std::string name;
+  std::string backend;
+  std::size_t n;
+  std::size_t numPoints;
+  unsigned int dimension;
+  unsigned int threads;
+  double seconds;
+};
+
+// SplitMix64, so that the synthetic data do not depend on the standard
+// library.
+class BenchGenerator
+{
+public:
+  explicit BenchGenerator(std::uint64_t seed) : m_State(seed) {}
+
+  std::uint64_t next()
+  {
+    std::uint64_t z = (m_State += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+private:
+  std::uint64_t m_State;
+};
+
+// `numCurves` random walks of `numPoints` points in the unit cube, each stored
+// as a D x P column-major matrix like the curves of the lab, one after the
+// other.
+static std::vector<double> syntheticCurves(std::size_t numCurves,
+                                           std::size_t numPoints,
+                                           unsigned int dimension,
+                                           std::uint64_t seed = 42)
+{
+  BenchGenerator generator(seed);
+  std::vector<double> out(numCurves * numPoints * dimension);
+  std::vector<double> position(dimension);
+
+  for (std::size_t i = 0;i < numCurves;++i)
+  {
+    for (unsigned int k = 0;k < dimension;++k)
+      position[k] = generator.uniform();
+
+    double *curve = out.data() + i * numPoints * dimension;
+    for (std::size_t p = 0;p < numPoints;++p)
+    {
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        position[k] += 0.05 * (2.0 * generator.uniform() - 1.0);
+        curve[p * dimension + k] = position[k];
+      }
+    }
+  }
+
+  return out;
+}
+
+static CurvePlanes packSyntheticCurves(const std::vector<double> &data,
+                                       std::size_t numCurves,
+                                       std::size_t numPoints,
+                                       unsigned int dimension)
+{
+  CurvePlanes out(numCurves, dimension, numPoints);
+  for (std::size_t i = 0;i < numCurves;++i)
+  {
+    copyCurvePoints(data.data() + i * numPoints * dimension, dimension, numPoints,
+                    out.curve(i), out.stride(), 1);
+    out.pad(i);
+  }
+  return out;
+}
+
+// Best wall time of `repetitions` calls to `run()`, each preceded by an
+// untimed call to `setup()`.
+template <typename Setup, typename Run>
+static double bestTime(unsigned int repetitions, Setup setup, Run run)
+{
+  double best = std::numeric_limits<double>::infinity();
+  for (unsigned int r = 0;r < repetitions;++r)
+  {
+    setup();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+template <typename Run>
+static double bestTime(unsigned int repetitions, Run run)
+{
+  return bestTime(repetitions, [] {}, run);
+}
+
+// Runs `task(t)` for t in [0, numTasks) on `ncores` threads with the
+// scheduling of each backend of the lab: a dynamic schedule for OpenMP, TBB
+// with a grain size of 1 as `RcppParallel::parallelFor()`, and threads
+// taking one task at a time as `RcppThread::parallelFor()` with one batch per
+// task.
+template <typename Task>
+static void runTasks(const std::string &backend,
+                     std::size_t numTasks,
+                     unsigned int ncores,
+                     Task task)
+{
+  if (backend == "omp")
+  {
+    std::ptrdiff_t n = numTasks;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(ncores)
+#endif
+    for (std::ptrdiff_t t = 0;t < n;++t)
+      task(t);
+  }
+#ifdef BENCH_HAVE_TBB
+  else if (backend == "tbb")
+  {
+    tbb::task_arena arena(ncores);
+    arena.execute([&] {
+      tbb::parallel_for(tbb::blocked_range<std::size_t>(0, numTasks, 1),
+                        [&] (const tbb::blocked_range<std::size_t> &range) {
+        for (std::size_t t = range.begin();t < range.end();++t)
+          task(t);
+      });
+    });
+  }
+#endif
+  else if (backend == "thread")
+  {
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0;w < ncores;++w)
+    {
+      workers.emplace_back([&] {
+        for (std::size_t t = next++;t < numTasks;t = next++)
+          task(t);
+      });
+    }
+    for (std::size_t w = 0;w < workers.size();++w)
+      workers[w].join();
+  }
+  else
+  {
+    for (std::size_t t = 0;t < numTasks;++t)
+      task(t);
+  }
+}
+
+static std::vector<std::string> parallelBackends()
+{
+  std::vector<std::string> out;
+#ifdef _OPENMP
+  out.push_back("omp");
+#endif
+#ifdef BENCH_HAVE_TBB
+  out.push_back("tbb");
+#endif
+  out.push_back("thread");
+  return out;
+}
+
+static std::vector<unsigned int> threadCounts(bool quick)
+{
+  unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> out;
+  for (unsigned int t = 1;t < maxThreads;t *= 2)
+    out.push_back(t);
+  out.push_back(maxThreads);
+  if (quick && out.size() > 2)
+    out.erase(out.begin() + 1, out.end() - 1);
+  return out;
+}
+
+static const char *ALGORITHM_NAMES[] = {"naive", "early_break", "kdtree"};
+
+class BenchRunner
+{
+public:
+  explicit BenchRunner(const BenchOptions &options) : m_Options(options) {}
+
+  bool selected(const std::string &name) const
+  {
+    return m_Options.filter.empty() || name.find(m_Options.filter) != std::string::npos;
+  }
+
+  void add(const std::string &name,
+           const std::string &backend,
+           std::size_t n,
+           std::size_t numPoints,
+           unsigned int dimension,
+           unsigned int threads,
+           double seconds)
+  {
+    BenchResult result = {name, backend, n, numPoints, dimension, threads, seconds};
+    m_Results.push_back(result);
+    std::fprintf(stderr, "%-28s %-10s n=%-8zu P=%-5zu D=%u threads=%-3u %.3e s\n",
+                 name.c_str(), backend.c_str(), n, numPoints, dimension, threads, seconds);
+  }
+
+  const std::vector<BenchResult> &results() const { return m_Results; }
+  const BenchOptions &options() const { return m_Options; }
+
+private:
+  BenchOptions m_Options;
+  std::vector<BenchResult> m_Results;
+};
+
+// Time per pair of `hausdorffDistanceNaive()`, the loop of
+// `hausdorff_distance_cpp()`, on the plane layout of `listToMatrix()` rows.
+static void benchDistanceCpp(BenchRunner &runner)
+{
+  if (!runner.selected("hausdorff_distance_cpp"))
+    return;
+
+  const std::size_t numCurves = 8;
+  std::vector<std::size_t> sizes = runner.options().quick ? std::vector<std::size_t>{100} : std::vector<std::size_t>{100, 200, 400};
+
+  for (std::size_t numPoints : sizes)
+  {
+    for (unsigned int dimension = 1;dimension <= 3;++dimension)
+    {
+      std::vector<double> data = syntheticCurves(numCurves, numPoints, dimension);
+      std::vector< std::vector<double> > rows(numCurves, std::vector<double>(numPoints * dimension));
+      for (std::size_t i = 0;i < numCurves;++i)
+        copyCurvePoints(data.data() + i * numPoints * dimension, dimension, numPoints,
+                        rows[i].data(), numPoints, 1);
+
+      double sink = 0.0;
+      double seconds = bestTime(runner.options().repetitions, [&] {
+        for (std::size_t i = 0;i < numCurves;++i)
+          for (std::size_t j = i + 1;j < numCurves;++j)
+            sink += hausdorffDistanceNaive(rows[i], rows[j], dimension);
+      });
+      if (sink < 0.0)
+        std::abort();
+
+      runner.add("hausdorff_distance_cpp", "serial", numCurves * (numCurves - 1) / 2,
+                 numPoints, dimension, 1, seconds / (numCurves * (numCurves - 1) / 2));
+    }
+  }
+}
+
+// Time per pair of `HausdorffSample::distance()` with each algorithm, on
+// prepared curves.
+static void benchKernels(BenchRunner &runner)
+{
+  const std::size_t numCurves = 16;
+  std::vector<std::size_t> sizes = runner.options().quick ? std::vector<std::size_t>{200} : std::vector<std::size_t>{50, 200, 1000};
+
+  for (int a = HAUSDORFF_NAIVE;a <= HAUSDORFF_KDTREE;++a)
+  {
+    std::string name = std::string("kernel/") + ALGORITHM_NAMES[a];
+    if (!runner.selected(name))
+      continue;
+
+    for (std::size_t numPoints : sizes)
+    {
+      for (unsigned int dimension = 1;dimension <= 3;++dimension)
+      {
+        std::vector<double> data = syntheticCurves(numCurves, numPoints, dimension);
+        HausdorffSample sample(packSyntheticCurves(data, numCurves, numPoints, dimension),
+                               static_cast<HausdorffAlgorithm>(a));
+        for (std::size_t i = 0;i < numCurves;++i)
+          sample.prepare(i);
+
+        double sink = 0.0;
+        double seconds = bestTime(runner.options().repetitions, [&] {
+          for (std::size_t i = 0;i < numCurves;++i)
+            for (std::size_t j = i + 1;j < numCurves;++j)
+              sink += sample.distance(i, j);
+        });
+        if (sink < 0.0)
+          std::abort();
+
+        std::size_t numPairs = numCurves * (numCurves - 1) / 2;
+        runner.add(name, "serial", numPairs, numPoints, dimension, 1, seconds / numPairs);
+      }
+    }
+  }
+}
+
+// Copies of a list of curves into the rows of a matrix, as `listToMatrix()`,
+// and into coordinate planes, as `packCurves()`, one task per curve.
+static void benchPacking(BenchRunner &runner)
+{
+  const std::size_t numPoints = 200;
+  const unsigned int dimension = 3;
+  std::vector<std::size_t> counts = runner.options().quick ? std::vector<std::size_t>{1000} : std::vector<std::size_t>{1000, 10000};
+
+  for (std::size_t numCurves : counts)
+  {
+    std::vector<double> data = syntheticCurves(numCurves, numPoints, dimension);
+    std::vector<double> matrix(numCurves * numPoints * dimension);
+    CurvePlanes planes(numCurves, dimension, numPoints);
+
+    std::vector<std::string> backends = parallelBackends();
+    backends.insert(backends.begin(), "serial");
+    for (const std::string &backend : backends)
+    {
+      for (unsigned int threads : threadCounts(runner.options().quick))
+      {
+        if (backend == "serial" && threads > 1)
+          continue;
+
+        if (runner.selected("list_to_matrix"))
+        {
+          double seconds = bestTime(runner.options().repetitions, [&] {
+            runTasks(backend, numCurves, threads, [&] (std::size_t i) {
+              copyCurvePoints(data.data() + i * numPoints * dimension, dimension, numPoints,
+                              matrix.data() + i, numPoints * numCurves, numCurves);
+            });
+          });
+          runner.add("list_to_matrix", backend, numCurves, numPoints, dimension, threads, seconds);
+        }
+
+        if (runner.selected("pack_curves"))
+        {
+          double seconds = bestTime(runner.options().repetitions, [&] {
+            runTasks(backend, numCurves, threads, [&] (std::size_t i) {
+              copyCurvePoints(data.data() + i * numPoints * dimension, dimension, numPoints,
+                              planes.curve(i), planes.stride(), 1);
+              planes.pad(i);
+            });
+          });
+          runner.add("pack_curves", backend, numCurves, numPoints, dimension, threads, seconds);
+        }
+      }
+    }
+  }
+}
+
+// Full `dist` computations: curves prepared in parallel, then the pairs
+// scheduled in tiles as in the backends of the lab.
+static void benchDist(BenchRunner &runner)
+{
+  std::vector<std::size_t> counts = runner.options().quick ? std::vector<std::size_t>{100} : std::vector<std::size_t>{100, 400};
+  std::vector<unsigned int> dimensions = runner.options().quick ? std::vector<unsigned int>{3} : std::vector<unsigned int>{1, 3};
+  const std::size_t numPoints = 200;
+
+  for (int a = HAUSDORFF_NAIVE;a <= HAUSDORFF_EARLY_BREAK;++a)
+  {
+    std::string name = std::string("dist/") + ALGORITHM_NAMES[a];
+    if (!runner.selected(name))
+      continue;
+
+    for (std::size_t numCurves : counts)
+    {
+      for (unsigned int dimension : dimensions)
+      {
+        std::vector<double> data = syntheticCurves(numCurves, numPoints, dimension);
+        std::vector<double> out(numCurves * (numCurves - 1) / 2);
+
+        std::vector<std::string> backends = parallelBackends();
+        backends.insert(backends.begin(), "serial");
+        for (const std::string &backend : backends)
+        {
+          for (unsigned int threads : threadCounts(runner.options().quick))
+          {
+            if (backend == "serial" && threads > 1)
+              continue;
+
+            std::unique_ptr<HausdorffSample> sample;
+            double seconds = bestTime(runner.options().repetitions, [&] {
+              sample.reset(new HausdorffSample(packSyntheticCurves(data, numCurves, numPoints, dimension),
+                                               static_cast<HausdorffAlgorithm>(a)));
+            }, [&] {
+              runTasks(backend, numCurves, threads, [&] (std::size_t i) {
+                sample->prepare(i);
+              });
+              PairTiling tiling(numCurves, defaultTileSize(sample->curveBytes()));
+              runTasks(backend, tiling.size(), threads, [&] (std::size_t t) {
+                tiling.forEachPair(t, [&] (std::size_t i, std::size_t j, std::size_t k) {
+                  out[k] = sample->distance(i, j);
+                });
+              });
+            });
+
+            runner.add(name, backend, numCurves, numPoints, dimension, threads, seconds);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Full `dist` computations with the threads pinned, the curves placed on the
+// NUMA nodes of the threads and the tiles taken from the own node first, as
+// in `dist_omp_placed()`, against unpinned threads. The nodes are those of
+// `NumaTopology::detect()`; on a single-node machine, set
+// HAUSDORFF_NUMA_NODES to emulate several, which measures the overhead of
+// the placement rather than its benefit.
+static void benchDistNuma(BenchRunner &runner)
+{
+  if (!runner.selected("dist_numa"))
+    return;
+
+  std::size_t numCurves = runner.options().quick ? 100 : 400;
+  const std::size_t numPoints = 200;
+  const unsigned int dimension = 3;
+  std::vector<double> data = syntheticCurves(numCurves, numPoints, dimension);
+  std::vector<double> out(numCurves * (numCurves - 1) / 2);
+  NumaTopology topology = NumaTopology::detect();
+
+  const char *affinityNames[] = {"none", "compact", "spread"};
+  const ThreadAffinity affinities[] = {AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SPREAD};
+  for (std::size_t a = 0;a < 3;++a)
+  {
+    for (unsigned int threads : threadCounts(runner.options().quick))
+    {
+      ThreadPlacement placement(topology, affinities[a], threads);
+
+      std::unique_ptr<HausdorffSample> sample;
+      double seconds = bestTime(runner.options().repetitions, [&] {
+        sample.reset(new HausdorffSample(packSyntheticCurves(data, numCurves, numPoints, dimension)));
+      }, [&] {
+        PairTiling tiling(numCurves, defaultTileSize(sample->curveBytes()));
+        if (!placement.isPinned())
+        {
+          runTasks("thread", numCurves, threads, [&] (std::size_t i) {
+            sample->prepare(i);
+          });
+          runTasks("thread", tiling.size(), threads, [&] (std::size_t t) {
+            tiling.forEachPair(t, [&] (std::size_t i, std::size_t j, std::size_t k) {
+              out[k] = sample->distance(i, j);
+            });
+          });
+          return;
+        }
+
+        auto write = [&out] (std::size_t k, double value) {
+          out[k] = value;
+        };
+        sample->placeCurves(placement);
+        runTasks("thread", threads, threads, [&] (std::size_t t) {
+          preparePlacedCurves(*sample, placement, t);
+        });
+        NodeLocalTiles tiles(tiling, numCurves, placement.numNodes());
+        runTasks("thread", threads, threads, [&] (std::size_t t) {
+          computePlacedTiles(*sample, tiling, tiles, placement, t, write);
+        });
+      });
+
+      runner.add("dist_numa", affinityNames[a], numCurves, numPoints, dimension, threads, seconds);
+    }
+  }
+}
+
+// `boost::math::erf()` over a vector, as in the erf examples of the slides,
+// and the SIMD kernel of `slides/src/erf-simd.h` in its two accuracies.
+static void benchErf(BenchRunner &runner)
+{
+  if (!runner.selected("erf"))
+    return;
+
+  const std::size_t n = runner.options().quick ? 100000 : 1000000;
+  const std::size_t blockSize = 4096;
+  BenchGenerator generator(42);
+  std::vector<double> x(n);
+  std::vector<double> y(n);
+  for (std::size_t i = 0;i < n;++i)
+    x[i] = 6.0 * generator.uniform() - 3.0;
+
+  std::vector<std::string> backends = parallelBackends();
+  backends.insert(backends.begin(), "serial");
+  const char *names[] = {"erf", "erf_simd_full", "erf_simd_fast"};
+  for (const char *name : names)
+  {
+    if (!runner.selected(name))
+      continue;
+
+    for (const std::string &backend : backends)
+    {
+      for (unsigned int threads : threadCounts(runner.options().quick))
+      {
+        if (backend == "serial" && threads > 1)
+          continue;
+
+        double seconds = bestTime(runner.options().repetitions, [&] {
+          runTasks(backend, (n + blockSize - 1) / blockSize, threads, [&] (std::size_t b) {
+            std::size_t begin = b * blockSize;
+            std::size_t end = std::min(n, begin + blockSize);
+            if (std::strcmp(name, "erf") == 0)
+            {
+              for (std::size_t i = begin;i < end;++i)
+                y[i] = boost::math::erf(x[i]);
+            }
+            else
+            {
+              ErfAccuracy accuracy = std::strcmp(name, "erf_simd_full") == 0 ? ERF_FULL : ERF_FAST;
+              erfSimd(x.data() + begin, y.data() + begin, end - begin, accuracy);
+            }
+          });
+        });
+        runner.add(name, backend, n, 0, 0, threads, seconds);
+      }
+    }
+  }
+}
+
+// The reductions of `slides/src/reductions.h` over finite values, so that the
+// finiteness check reads the whole vector, one task per block.
+static void benchReductions(BenchRunner &runner)
+{
+  const std::size_t n = runner.options().quick ? 1000000 : 10000000;
+  const std::size_t numBlocks = numReductionBlocks(n);
+  BenchGenerator generator(42);
+  std::vector<double> x(n);
+  for (std::size_t i = 0;i < n;++i)
+    x[i] = 6.0 * generator.uniform() - 3.0;
+
+  std::vector<double> sums(numBlocks);
+  std::vector<VectorStats> stats(numBlocks);
+  std::vector<std::string> backends = parallelBackends();
+  backends.insert(backends.begin(), "serial");
+  const char *names[] = {"all_finite", "sum_pairwise", "vector_stats"};
+  for (const char *name : names)
+  {
+    if (!runner.selected(name))
+      continue;
+
+    for (const std::string &backend : backends)
+    {
+      for (unsigned int threads : threadCounts(runner.options().quick))
+      {
+        if (backend == "serial" && threads > 1)
+          continue;
+
+        std::atomic<bool> found(false);
+        double seconds = bestTime(runner.options().repetitions, [&] {
+          runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+            std::size_t begin = b * REDUCTION_BLOCK_SIZE;
+            std::size_t size = std::min(REDUCTION_BLOCK_SIZE, n - begin);
+            if (std::strcmp(name, "all_finite") == 0)
+              findNonFiniteBlocks(x.data(), n, b, b + 1, found);
+            else if (std::strcmp(name, "sum_pairwise") == 0)
+              sums[b] = pairwiseSum(x.data() + begin, size);
+            else
+              stats[b] = blockStats(x.data() + begin, size);
+          });
+          if (std::strcmp(name, "sum_pairwise") == 0)
+            sums[0] = pairwiseSum(sums.data(), numBlocks);
+          else if (std::strcmp(name, "vector_stats") == 0)
+            stats[0] = mergeStatsPairwise(stats.data(), numBlocks);
+        });
+        runner.add(name, backend, n, 0, 0, threads, seconds);
+      }
+    }
+  }
+}
+
+// sum(2 * erf(x) - 1) as R evaluates it, one parallel pass and one new vector
+// per operation, against the lazy expression of `slides/src/lazy-expr.h`,
+// evaluated block by block in a single pass without intermediate vectors.
+static void benchLazyExpr(BenchRunner &runner)
+{
+  const std::size_t n = runner.options().quick ? 1000000 : 10000000;
+  const std::size_t numBlocks = numLazyBlocks(n);
+  BenchGenerator generator(42);
+  std::vector<double> x(n);
+  for (std::size_t i = 0;i < n;++i)
+    x[i] = 6.0 * generator.uniform() - 3.0;
+
+  auto erf = [] (const double *in, double *out, std::size_t size) {
+    erfSimd(in, out, size, ERF_FULL);
+  };
+  auto expr = lazyMap(lazyBlockMap<double>(lazyVector(x), erf), [] (double e) {
+    return 2.0 * e - 1.0;
+  });
+
+  std::vector<double> sums(numBlocks);
+  std::vector<std::string> backends = parallelBackends();
+  backends.insert(backends.begin(), "serial");
+  const char *names[] = {"erf_affine_sum_eager", "erf_affine_sum_lazy"};
+  for (const char *name : names)
+  {
+    if (!runner.selected(name))
+      continue;
+
+    for (const std::string &backend : backends)
+    {
+      for (unsigned int threads : threadCounts(runner.options().quick))
+      {
+        if (backend == "serial" && threads > 1)
+          continue;
+
+        double seconds = bestTime(runner.options().repetitions, [&] {
+          if (std::strcmp(name, "erf_affine_sum_lazy") == 0)
+          {
+            runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+              sums[b] = lazySumBlock(expr, b);
+            });
+            sums[0] = pairwiseSum(sums.data(), numBlocks);
+            return;
+          }
+
+          // Left uninitialized, as R vectors, so that their pages are first
+          // touched by the parallel passes.
+          std::unique_ptr<double[]> e(new double[n]);
+          std::unique_ptr<double[]> scaled(new double[n]);
+          std::unique_ptr<double[]> shifted(new double[n]);
+          runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+            std::size_t begin = b * LAZY_BLOCK_SIZE;
+            erfSimd(x.data() + begin, e.get() + begin, std::min(LAZY_BLOCK_SIZE, n - begin), ERF_FULL);
+          });
+          runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+            std::size_t end = std::min(n, (b + 1) * LAZY_BLOCK_SIZE);
+            for (std::size_t i = b * LAZY_BLOCK_SIZE;i < end;++i)
+              scaled[i] = 2.0 * e[i];
+          });
+          runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+            std::size_t end = std::min(n, (b + 1) * LAZY_BLOCK_SIZE);
+            for (std::size_t i = b * LAZY_BLOCK_SIZE;i < end;++i)
+              shifted[i] = scaled[i] - 1.0;
+          });
+          runTasks(backend, numBlocks, threads, [&] (std::size_t b) {
+            std::size_t begin = b * LAZY_BLOCK_SIZE;
+            sums[b] = pairwiseSum(shifted.get() + begin, std::min(LAZY_BLOCK_SIZE, n - begin));
+          });
+          sums[0] = pairwiseSum(sums.data(), numBlocks);
+        });
+        runner.add(name, backend, n, 0, 0, threads, seconds);
+      }
+    }
+  }
+}
+
+// Latency of one call on a small input, as the thread pool examples of the
+// slides: a pool created for the call with one task and one future per
+// element, as with `RcppThread::ThreadPool::pushReturn()`, against the pool of
+// the process with one task per batch. The time is per call.
+static void benchPoolLatency(BenchRunner &runner)
+{
+  if (!runner.selected("pool_latency"))
+    return;
+
+  const unsigned int numCalls = 200;
+  const std::size_t sizes[] = {100, 10000};
+  for (std::size_t n : sizes)
+  {
+    std::vector<unsigned int> x(n);
+    for (std::size_t i = 0;i < n;++i)
+      x[i] = i + 1;
+    auto square = [&x] (std::size_t i) { return x[i] * x[i]; };
+
+    for (unsigned int threads : threadCounts(runner.options().quick))
+    {
+      double seconds = bestTime(runner.options().repetitions, [&] {
+        for (unsigned int c = 0;c < numCalls;++c)
+        {
+          PersistentPool pool(threads);
+          std::vector<std::future<unsigned int>> futures(n);
+          for (std::size_t i = 0;i < n;++i)
+          {
+            std::shared_ptr<std::packaged_task<unsigned int()>> task =
+              std::make_shared<std::packaged_task<unsigned int()>>([&square, i] { return square(i); });
+            futures[i] = task->get_future();
+            pool.push([task] { (*task)(); });
+          }
+          std::vector<unsigned int> results(n);
+          for (std::size_t i = 0;i < n;++i)
+            results[i] = futures[i].get();
+        }
+      });
+      runner.add("pool_latency", "per_call", n, 0, 0, threads, seconds / numCalls);
+
+      seconds = bestTime(runner.options().repetitions, [&] {
+        for (unsigned int c = 0;c < numCalls;++c)
+        {
+          std::vector<unsigned int> results(n);
+          PersistentPool::instance(threads).mapReturn(results, square);
+        }
+      });
+      runner.add("pool_latency", "persistent", n, 0, 0, threads, seconds / numCalls);
+    }
+  }
+}
+
+// Sums of `nstep` uniform draws of the sitmo generator, as in the sumunif
+// examples of the slides: one generator for the serial version, one per
+// thread for the OpenMP one and one per chunk of outputs for the streams.
+static void benchSumunif(BenchRunner &runner)
+{
+#ifdef BENCH_HAVE_SITMO
+  if (!runner.selected("sumunif"))
+    return;
+
+  const unsigned int n = runner.options().quick ? 10000 : 100000;
+  const unsigned int nstep = 100;
+  std::vector<double> out(n);
+
+  double seconds = bestTime(runner.options().repetitions, [&] {
+    sitmo::prng eng(1234);
+    double mx = sitmo::prng::max();
+    for (unsigned int i = 0;i < n;++i)
+    {
+      double tmp = 0.0;
+      for (unsigned int k = 0;k < nstep;++k)
+        tmp += eng() / mx;
+      out[i] = tmp;
+    }
+  });
+  runner.add("sumunif", "serial", n, nstep, 0, 1, seconds);
+
+#ifdef _OPENMP
+  for (unsigned int threads : threadCounts(runner.options().quick))
+  {
+    if (threads == 1)
+      continue;
+
+    double seconds = bestTime(runner.options().repetitions, [&] {
+#pragma omp parallel num_threads(threads)
+      {
+        sitmo::prng eng(1234 + omp_get_thread_num());
+        double mx = sitmo::prng::max();
+#pragma omp for
+        for (unsigned int i = 0;i < n;++i)
+        {
+          double tmp = 0.0;
+          for (unsigned int k = 0;k < nstep;++k)
+            tmp += eng() / mx;
+          out[i] = tmp;
+        }
+      }
+    });
+    runner.add("sumunif", "omp", n, nstep, 0, threads, seconds);
+  }
+#endif
+
+  // One stream per chunk of outputs, as `sumunif_sitmo_streams()`.
+  const std::size_t numChunks = numRngChunks(n);
+  for (unsigned int threads : threadCounts(runner.options().quick))
+  {
+    double seconds = bestTime(runner.options().repetitions, [&] {
+      runTasks(threads > 1 ? "omp" : "serial", numChunks, threads, [&] (std::size_t c) {
+        sitmo::prng eng;
+        setChunkStream(eng, 1234, c);
+        double draws[RNG_BATCH_SIZE];
+        std::size_t end = std::min<std::size_t>(n, (c + 1) * RNG_STREAM_CHUNK_SIZE);
+        for (std::size_t i = c * RNG_STREAM_CHUNK_SIZE;i < end;++i)
+        {
+          double tmp = 0.0;
+          for (std::size_t k = 0;k < nstep;k += RNG_BATCH_SIZE)
+          {
+            std::size_t size = std::min<std::size_t>(RNG_BATCH_SIZE, nstep - k);
+            uniformBatch(eng, draws, size);
+            for (std::size_t j = 0;j < size;++j)
+              tmp += draws[j];
+          }
+          out[i] = tmp;
+        }
+      });
+    });
+    runner.add("sumunif_streams", threads > 1 ? "omp" : "serial", n, nstep, 0, threads, seconds);
+  }
+#else
+  (void) runner;
+#endif
+}
+
+// Everything but the timing identifies a benchmark.
+static std::string benchKey(const BenchResult &result)
+{
+  std::ostringstream key;
+  key << "{\"name\": \"" << result.name << "\", \"backend\": \"" << result.backend
+      << "\", \"n\": " << result.n << ", \"points\": " << result.numPoints
+      << ", \"dimension\": " << result.dimension << ", \"threads\": " << result.threads;
+  return key.str();
+}
+
+static void writeResults(std::ostream &out, const std::vector<BenchResult> &results)
+{
+  out << "{\n\"context\": {\"isa\": \"" << hausdorff_simd_isa()
+      << "\", \"hardware_concurrency\": " << std::thread::hardware_concurrency()
+      << ", \"compiler\": \"" << __VERSION__ << "\"},\n\"benchmarks\": [\n";
+  for (std::size_t r = 0;r < results.size();++r)
+  {
+    char seconds[32];
+    std::snprintf(seconds, sizeof(seconds), "%.6e", results[r].seconds);
+    out << benchKey(results[r]) << ", \"seconds\": " << seconds << "}"
+        << (r + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "]\n}\n";
+}
+
+// Reads the benchmarks of a file written by `writeResults()`.
+static std::map<std::string, double> readBaseline(const std::string &path)
+{
+  std::map<std::string, double> out;
+  std::ifstream in(path.c_str());
+  if (!in)
+  {
+    std::fprintf(stderr, "Cannot read the baseline '%s'.\n", path.c_str());
+    std::exit(2);
+  }
+
+  std::string line;
+  const std::string marker = ", \"seconds\": ";
+  while (std::getline(in, line))
+  {
+    std::size_t position = line.find(marker);
+    if (line.compare(0, 9, "{\"name\": ") != 0 || position == std::string::npos)
+      continue;
+    out[line.substr(0, position)] = std::atof(line.c_str() + position + marker.size());
+  }
+  return out;
+}
+
+// Prints the ratio of each time to the baseline and returns the number of
+// benchmarks slower than the baseline by more than `threshold`.
+static int compareWithBaseline(const std::vector<BenchResult> &results,
+                               const std::string &path,
+                               double threshold)
+{
+  std::map<std::string, double> baseline = readBaseline(path);
+  int numRegressions = 0;
+
+  std::fprintf(stderr, "\nComparison with %s:\n", path.c_str());
+  for (const BenchResult &result : results)
+  {
+    std::map<std::string, double>::const_iterator found = baseline.find(benchKey(result));
+    if (found == baseline.end() || found->second <= 0.0)
+      continue;
+
+    double ratio = result.seconds / found->second;
+    bool regression = ratio > 1.0 + threshold;
+    numRegressions += regression;
+    std::fprintf(stderr, "%-28s %-10s n=%-8zu P=%-5zu D=%u threads=%-3u %6.2fx%s\n",
+                 result.name.c_str(), result.backend.c_str(), result.n, result.numPoints,
+                 result.dimension, result.threads, ratio, regression ? "  REGRESSION" : "");
+  }
+  return numRegressions;
+}
+
+static BenchOptions parseOptions(int argc, char **argv)
+{
+  BenchOptions options;
+  for (int a = 1;a < argc;++a)
+  {
+    std::string arg = argv[a];
+    bool hasValue = a + 1 < argc;
+    if (arg == "--quick")
+      options.quick = true;
+    else if (arg == "--filter" && hasValue)
+      options.filter = argv[++a];
+    else if (arg == "--repetitions" && hasValue)
+      options.repetitions = std::max(1, std::atoi(argv[++a]));
+    else if (arg == "--output" && hasValue)
+      options.output = argv[++a];
+    else if (arg == "--baseline" && hasValue)
+      options.baseline = argv[++a];
+    else if (arg == "--threshold" && hasValue)
+      options.threshold = std::atof(argv[++a]);
+    else
+    {
+      std::fprintf(stderr, "Usage: %s [--quick] [--filter TEXT] [--repetitions R] "
+                   "[--output FILE] [--baseline FILE] [--threshold T]\n", argv[0]);
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+int main(int argc, char **argv)
+{
+  BenchRunner runner(parseOptions(argc, argv));
+
+  benchDistanceCpp(runner);
+  benchKernels(runner);
+  benchPacking(runner);
+  benchDist(runner);
+  benchDistNuma(runner);
+  benchErf(runner);
+  benchReductions(runner);
+  benchLazyExpr(runner);
+  benchPoolLatency(runner);
+  benchSumunif(runner);
+
+  const BenchOptions &options = runner.options();
+  if (options.output.empty())
+    writeResults(std::cout, runner.results());
+  else
+  {
+    std::ofstream out(options.output.c_str());
+    writeResults(out, runner.results());
+  }
+
+  if (!options.baseline.empty())
+    return compareWithBaseline(runner.results(), options.baseline, options.threshold) > 0;
+  return 0;
+}
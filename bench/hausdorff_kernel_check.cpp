@@ -0,0 +1,172 @@
+// Checks that the Hausdorff kernels of every instruction set the CPU supports
+// return bit-for-bit the result of the scalar loop of
+// `hausdorff_distance_cpp()` (`hausdorffDistanceNaive()`), on random curves
+// of dimension 1 to 5 and of numbers of points that leave padding tails of
+// every length in the SIMD registers.
+//
+// Usage: hausdorff_kernel_check
+//
+// Exits with a non-zero status if any kernel differs.
+
+#include "curve_layout.h"
+#include "hausdorff_simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// SplitMix64, as in `hausdorff_bench`.
+class CheckGenerator
+{
+public:
+  explicit CheckGenerator(std::uint64_t seed) : m_State(seed) {}
+
+  std::uint64_t next()
+  {
+    std::uint64_t z = (m_State += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+private:
+  std::uint64_t m_State;
+};
+
+enum CheckData
+{
+  // Uniform coordinates in [-1, 1).
+  CHECK_UNIFORM,
+  // Small integer coordinates, so that many squared distances tie.
+  CHECK_GRID,
+  // Uniform coordinates in [-1e6, 1e6), too large for the single-precision
+  // search of the mixed kernel.
+  CHECK_LARGE,
+  CHECK_NUM_DATA
+};
+
+static const char *CHECK_DATA_NAMES[] = {"uniform", "grid", "large"};
+
+// Random curve of `numPoints` points stored as its first coordinates, then its
+// second ones, and so on, as the rows of the matrix of the lab.
+static std::vector<double> randomCurve(CheckGenerator &generator,
+                                       CheckData data,
+                                       unsigned int dimension,
+                                       std::size_t numPoints)
+{
+  std::vector<double> out(dimension * numPoints);
+  for (std::size_t q = 0;q < out.size();++q)
+  {
+    double u = 2.0 * generator.uniform() - 1.0;
+    if (data == CHECK_GRID)
+      out[q] = std::floor(4.0 * u);
+    else if (data == CHECK_LARGE)
+      out[q] = 1.0e6 * u;
+    else
+      out[q] = u;
+  }
+  return out;
+}
+
+static void copyToPlanes(const std::vector<double> &curve, CurvePlanes &planes, std::size_t i)
+{
+  std::size_t numPoints = planes.numPoints();
+  for (unsigned int k = 0;k < planes.dimension();++k)
+  {
+    for (std::size_t p = 0;p < numPoints;++p)
+      planes.curve(i)[k * planes.stride() + p] = curve[k * numPoints + p];
+  }
+  planes.pad(i);
+}
+
+static bool sameBits(double a, double b)
+{
+  return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+struct CheckCounts
+{
+  std::size_t numChecks = 0;
+  std::size_t numMismatches = 0;
+};
+
+static void check(CheckCounts &counts,
+                  const char *kernel,
+                  const char *isa,
+                  CheckData data,
+                  unsigned int dimension,
+                  std::size_t numPoints,
+                  double expected,
+                  double actual)
+{
+  ++counts.numChecks;
+  if (sameBits(expected, actual))
+    return;
+
+  // Only the first mismatches are reported, the count says the rest.
+  if (++counts.numMismatches <= 20)
+    std::printf("MISMATCH %s/%s data=%s D=%u P=%zu: expected %.17g, got %.17g\n",
+                kernel, isa, CHECK_DATA_NAMES[data], dimension, numPoints, expected, actual);
+}
+
+int main()
+{
+  const std::size_t numPointsList[] = {1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 63, 64, 65, 127};
+  const std::size_t numPairs = 8;
+  CheckGenerator generator(2024);
+  CheckCounts counts;
+
+  std::printf("isa:");
+  for (std::size_t n = 0;n < hausdorff_simd_num_isas();++n)
+    std::printf(" %s", hausdorff_simd_isa(n));
+  std::printf("\n");
+
+  for (unsigned int dimension = 1;dimension <= 5;++dimension)
+  {
+    for (std::size_t numPoints : numPointsList)
+    {
+      for (int data = 0;data < CHECK_NUM_DATA;++data)
+      {
+        for (std::size_t pair = 0;pair < numPairs;++pair)
+        {
+          CheckData checkData = static_cast<CheckData>(data);
+          std::vector<double> x = randomCurve(generator, checkData, dimension, numPoints);
+          std::vector<double> y = randomCurve(generator, checkData, dimension, numPoints);
+          double expected = hausdorffDistanceNaive(x, y, dimension);
+
+          CurvePlanes planes(2, dimension, numPoints);
+          copyToPlanes(x, planes, 0);
+          copyToPlanes(y, planes, 1);
+          const double *xPlanes = planes.curve(0);
+          const double *yPlanes = planes.curve(1);
+          std::size_t stride = planes.stride();
+
+          for (std::size_t n = 0;n < hausdorff_simd_num_isas();++n)
+          {
+            const char *isa = hausdorff_simd_isa(n);
+            check(counts, "fixed", isa, checkData, dimension, numPoints, expected,
+                  std::sqrt(hausdorff_squared_isa(n, xPlanes, yPlanes, dimension, numPoints, stride)));
+            check(counts, "generic", isa, checkData, dimension, numPoints, expected,
+                  std::sqrt(hausdorff_squared_isa(n, xPlanes, yPlanes, dimension, numPoints, stride, false)));
+            check(counts, "early_break", isa, checkData, dimension, numPoints, expected,
+                  std::sqrt(hausdorff_squared_early_break_isa(n, xPlanes, yPlanes, dimension, numPoints, stride)));
+          }
+
+          FloatCurvePlanes floatPlanes(2, dimension, numPoints);
+          floatPlanes.assign(0, planes);
+          floatPlanes.assign(1, planes);
+          check(counts, "mixed", hausdorff_simd_isa(), checkData, dimension, numPoints, expected,
+                std::sqrt(hausdorff_squared_mixed(planes, floatPlanes, 0, planes, floatPlanes, 1)));
+        }
+      }
+    }
+  }
+
+  std::printf("%zu checks, %zu mismatches\n", counts.numChecks, counts.numMismatches);
+  return counts.numMismatches > 0;
+}
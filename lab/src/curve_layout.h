@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Building blocks of the R interface that do not depend on R, so that the
+// standalone benchmark in `bench/` times the same code.
+
+// Copies the points of a D x P column-major curve matrix, point p of
+// coordinate k going to `out[k * planeStride + p * pointStride]`, and returns
+// whether all its coordinates are finite.
+inline bool copyCurvePoints(const double *curve,
+                            unsigned int dimension,
+                            std::size_t numPoints,
+                            double *out,
+                            std::size_t planeStride,
+                            std::size_t pointStride)
+{
+  bool finite = true;
+
+  for (std::size_t p = 0;p < numPoints;++p)
+  {
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      double value = curve[p * dimension + k];
+      finite = finite && std::isfinite(value);
+      out[k * planeStride + p * pointStride] = value;
+    }
+  }
+
+  return finite;
+}
+
+// Hausdorff distance between two curves with the same number of points, each
+// stored in a vector as the values of its first coordinate, then of its
+// second coordinate, and so on.
+template <typename Vector>
+double hausdorffDistanceNaive(const Vector &x,
+                              const Vector &y,
+                              unsigned int dimension)
+{
+  unsigned int numDimensions = dimension;
+  unsigned int numPoints = x.size() / numDimensions;
+
+  double dX = 0.0;
+  double dY = 0.0;
+
+  for (unsigned int i = 0;i < numPoints;++i)
+  {
+    double min_dist_x = std::numeric_limits<double>::infinity();
+    double min_dist_y = std::numeric_limits<double>::infinity();
+
+    for (unsigned int j = 0;j < numPoints;++j)
+    {
+      double dist_x = 0.0;
+      double dist_y = 0.0;
+
+      for (unsigned int k = 0;k < numDimensions;++k)
+      {
+        unsigned int index_i = k * numPoints + i;
+        unsigned int index_j = k * numPoints + j;
+        dist_x += std::pow(x[index_i] - y[index_j], 2);
+        dist_y += std::pow(y[index_i] - x[index_j], 2);
+      }
+
+      min_dist_x = std::min(min_dist_x, dist_x);
+      min_dist_y = std::min(min_dist_y, dist_y);
+    }
+
+    dX = std::max(dX, min_dist_x);
+    dY = std::max(dY, min_dist_y);
+  }
+
+  return std::sqrt(std::max(dX, dY));
+}
@@ -0,0 +1,181 @@
+#include "curve_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Both directions are computed in a single pass over the rows of the
+// distance table: the minimum of row i is the distance from the i-th point of
+// `x` to `y`, and the minima of the columns, updated row after row, are the
+// distances from the points of `y` to `x`.
+double modified_hausdorff_distance(const double *x,
+                                   const double *y,
+                                   unsigned int dimension,
+                                   std::size_t numPoints,
+                                   std::size_t stride)
+{
+  std::vector<double> row(numPoints);
+  std::vector<double> columnMinima(numPoints, std::numeric_limits<double>::infinity());
+  double sumX = 0.0;
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    std::fill(row.begin(), row.end(), 0.0);
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      const double xValue = x[k * stride + i];
+      const double *yPlane = y + k * stride;
+      for (std::size_t j = 0;j < numPoints;++j)
+      {
+        double diff = xValue - yPlane[j];
+        row[j] += diff * diff;
+      }
+    }
+
+    double rowMinimum = std::numeric_limits<double>::infinity();
+    for (std::size_t j = 0;j < numPoints;++j)
+    {
+      rowMinimum = std::min(rowMinimum, row[j]);
+      columnMinima[j] = std::min(columnMinima[j], row[j]);
+    }
+    sumX += std::sqrt(rowMinimum);
+  }
+
+  double sumY = 0.0;
+  for (std::size_t j = 0;j < numPoints;++j)
+    sumY += std::sqrt(columnMinima[j]);
+
+  return numPoints > 0 ? std::max(sumX, sumY) / numPoints : 0.0;
+}
+
+// Evaluates the alignment recursion
+//
+//   c(i, j) = combine(cost(i, j), min(c(i - 1, j), c(i, j - 1), c(i - 1, j - 1)))
+//
+// with c(0, 0) = cost(0, 0) over the cells |i - j| <= window of the P x P grid
+// and returns c(P - 1, P - 1), where cost(i, j) is the squared distance between
+// the i-th point of `x` and the j-th point of `y`, or the distance itself if
+// `takeRoot` is true.
+//
+// The cells of an anti-diagonal i + j = d only depend on the two previous
+// anti-diagonals, so the grid is swept one anti-diagonal at a time, keeping
+// three of them indexed by i: O(P) memory instead of a P x P table. Within an
+// anti-diagonal, the cells do not depend on each other, so both the costs
+// (one coordinate plane at a time) and the recursion run as plain loops over
+// contiguous arrays, which the compiler vectorizes.
+//
+// The cells of an anti-diagonal span a range of i that moves by at most one at
+// each step, so the cells just outside this range are set to infinity and the
+// next anti-diagonals never read older values.
+template <typename Combine>
+static double alignmentWavefront(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride,
+                                 std::ptrdiff_t window,
+                                 bool takeRoot,
+                                 Combine combine)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  std::ptrdiff_t P = numPoints;
+  std::vector<double> buffer(4 * numPoints, inf);
+  double *costs = buffer.data();
+  double *before = costs + numPoints;
+  double *previous = before + numPoints;
+  double *current = previous + numPoints;
+
+  for (std::ptrdiff_t d = 0;d < 2 * P - 1;++d)
+  {
+    std::ptrdiff_t lo = std::max(std::ptrdiff_t(0), d - (P - 1));
+    std::ptrdiff_t hi = std::min(d, P - 1);
+    if (window >= 0)
+    {
+      lo = std::max(lo, (d - window + 1) / 2);
+      hi = std::min(hi, (d + window) / 2);
+    }
+
+    std::fill(costs + lo, costs + hi + 1, 0.0);
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      const double *xPlane = x + k * stride;
+      const double *yPlane = y + k * stride + d;
+      for (std::ptrdiff_t i = lo;i <= hi;++i)
+      {
+        double diff = xPlane[i] - yPlane[-i];
+        costs[i] += diff * diff;
+      }
+    }
+    if (takeRoot)
+    {
+      for (std::ptrdiff_t i = lo;i <= hi;++i)
+        costs[i] = std::sqrt(costs[i]);
+    }
+
+    std::ptrdiff_t first = lo;
+    if (lo == 0)
+    {
+      // Cells of the first row (and the corner cell) only have a left
+      // neighbour.
+      current[0] = d == 0 ? costs[0] : combine(costs[0], previous[0]);
+      first = 1;
+    }
+    for (std::ptrdiff_t i = first;i <= hi;++i)
+    {
+      double best = std::min(previous[i], std::min(previous[i - 1], before[i - 1]));
+      current[i] = combine(costs[i], best);
+    }
+
+    if (lo > 0)
+      current[lo - 1] = inf;
+    if (hi + 1 < P)
+      current[hi + 1] = inf;
+
+    double *oldest = before;
+    before = previous;
+    previous = current;
+    current = oldest;
+  }
+
+  return P > 0 ? previous[P - 1] : 0.0;
+}
+
+double discrete_frechet_distance(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride)
+{
+  // The recursion only compares distances, so it runs on squared distances.
+  double dist = alignmentWavefront(x, y, dimension, numPoints, stride, -1, false,
+                                   [] (double cost, double best) {
+    return std::max(cost, best);
+  });
+
+  return std::sqrt(dist);
+}
+
+double dtw_distance(const double *x,
+                    const double *y,
+                    unsigned int dimension,
+                    std::size_t numPoints,
+                    std::size_t stride,
+                    int window)
+{
+  return alignmentWavefront(x, y, dimension, numPoints, stride, window, true,
+                            [] (double cost, double best) {
+    return cost + best;
+  });
+}
+
+CurveMetric parseCurveMetric(std::string metric)
+{
+  if (metric == "frechet")
+    return CURVE_FRECHET;
+  if (metric == "dtw")
+    return CURVE_DTW;
+  if (metric == "modified_hausdorff")
+    return CURVE_MODIFIED_HAUSDORFF;
+  Rcpp::stop("Unknown metric '%s'. Use 'frechet', 'dtw' or 'modified_hausdorff'.", metric);
+}
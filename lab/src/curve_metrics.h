@@ -0,0 +1,158 @@
+#pragma once
+#include <Rcpp.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "hausdorff_simd.h"
+
+// Modified Hausdorff distance of Dubuisson & Jain (1994): the largest of the
+// mean distances from the points of each curve to their nearest point on the
+// other curve. Both curves are stored as coordinate planes of `stride`
+// doubles (see `CurvePlanes`).
+double modified_hausdorff_distance(const double *x,
+                                   const double *y,
+                                   unsigned int dimension,
+                                   std::size_t numPoints,
+                                   std::size_t stride);
+
+// Discrete Fréchet distance of Eiter & Mannila (1994): the smallest, over the
+// monotone alignments of the points of both curves, of the largest distance
+// between aligned points.
+double discrete_frechet_distance(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride);
+
+// Dynamic time warping distance: the smallest, over the monotone alignments of
+// the points of both curves, of the sum of the distances between aligned
+// points. Points i and j can only be aligned if |i - j| <= `window` (the
+// Sakoe-Chiba band), or without constraint if `window` is negative.
+double dtw_distance(const double *x,
+                    const double *y,
+                    unsigned int dimension,
+                    std::size_t numPoints,
+                    std::size_t stride,
+                    int window);
+
+// Metric policies of `MetricSample`: each one computes the distance between
+// two curves stored as coordinate planes and names the `method` of the
+// resulting `dist` objects.
+struct ModifiedHausdorffMetric
+{
+  static const char *name() { return "modified_hausdorff"; }
+
+  double operator()(const double *x,
+                    const double *y,
+                    unsigned int dimension,
+                    std::size_t numPoints,
+                    std::size_t stride) const
+  {
+    return modified_hausdorff_distance(x, y, dimension, numPoints, stride);
+  }
+};
+
+struct DiscreteFrechetMetric
+{
+  static const char *name() { return "frechet"; }
+
+  double operator()(const double *x,
+                    const double *y,
+                    unsigned int dimension,
+                    std::size_t numPoints,
+                    std::size_t stride) const
+  {
+    return discrete_frechet_distance(x, y, dimension, numPoints, stride);
+  }
+};
+
+struct DtwMetric
+{
+  int m_Window;
+
+  DtwMetric(int window) : m_Window(window) {}
+
+  static const char *name() { return "dtw"; }
+
+  double operator()(const double *x,
+                    const double *y,
+                    unsigned int dimension,
+                    std::size_t numPoints,
+                    std::size_t stride) const
+  {
+    return dtw_distance(x, y, dimension, numPoints, stride, m_Window);
+  }
+};
+
+// Packed curves compared with the metric policy `Metric`. It has the same
+// interface as `HausdorffSample`, so the pair engines of the backends compute
+// any metric.
+template <typename Metric>
+class MetricSample
+{
+public:
+  MetricSample(CurvePlanes curves, Metric metric)
+    : m_Curves(std::move(curves)), m_Metric(metric) {}
+
+  std::size_t size() const { return m_Curves.size(); }
+  const CurvePlanes &curves() const { return m_Curves; }
+  const char *method() const { return Metric::name(); }
+
+  std::size_t curveBytes() const
+  {
+    return m_Curves.dimension() * m_Curves.stride() * sizeof(double);
+  }
+
+  // The metrics need no preprocessing.
+  void prepare(std::size_t) {}
+
+  double distance(std::size_t i, std::size_t j) const
+  {
+    return m_Metric(m_Curves.curve(i), m_Curves.curve(j), m_Curves.dimension(),
+                    m_Curves.numPoints(), m_Curves.stride());
+  }
+
+private:
+  CurvePlanes m_Curves;
+  Metric m_Metric;
+};
+
+enum CurveMetric
+{
+  CURVE_FRECHET,
+  CURVE_DTW,
+  CURVE_MODIFIED_HAUSDORFF
+};
+
+CurveMetric parseCurveMetric(std::string metric);
+
+// Runs `backend(sample)` on the curves wrapped in the `MetricSample` of
+// `metric`, where `backend` is a function object with a templated call
+// operator computing the `dist` object of any sample.
+template <typename Backend>
+Rcpp::NumericVector distWithMetric(CurvePlanes curves,
+                                   CurveMetric metric,
+                                   int window,
+                                   Backend backend)
+{
+  switch (metric)
+  {
+  case CURVE_DTW:
+  {
+    MetricSample<DtwMetric> sample(std::move(curves), DtwMetric(window));
+    return backend(sample);
+  }
+  case CURVE_MODIFIED_HAUSDORFF:
+  {
+    MetricSample<ModifiedHausdorffMetric> sample(std::move(curves), ModifiedHausdorffMetric());
+    return backend(sample);
+  }
+  default:
+  {
+    MetricSample<DiscreteFrechetMetric> sample(std::move(curves), DiscreteFrechetMetric());
+    return backend(sample);
+  }
+  }
+}
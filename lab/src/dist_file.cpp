@@ -0,0 +1,143 @@
+#include "dist_file.h"
+#include "pair_scheduler.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The values start on a cache line boundary after the header.
+static const std::size_t DIST_FILE_HEADER_SIZE = 64;
+static const char DIST_FILE_MAGIC[8] = {'H', 'D', 'I', 'S', 'T', '0', '0', '1'};
+
+struct DistFileHeader
+{
+  char magic[8];
+  std::uint64_t numCurves;
+  std::uint32_t valueSize;
+};
+
+static std::runtime_error systemError(const std::string &what,
+                                      const std::string &path)
+{
+  return std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+static std::size_t valueSize(DistValueType type)
+{
+  return type == DIST_FLOAT32 ? sizeof(float) : sizeof(double);
+}
+
+DistFile::DistFile(const std::string &path,
+                   std::size_t numCurves,
+                   DistValueType type)
+  : m_Path(path), m_NumCurves(numCurves), m_Type(type)
+{
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw systemError("Cannot create", path);
+
+  // The file is extended without writing it, so the distances only take disk
+  // space once they have been computed (on file systems with sparse files).
+  std::size_t fileSize = DIST_FILE_HEADER_SIZE + size() * valueSize(type);
+  if (::ftruncate(fd, fileSize) != 0)
+  {
+    ::close(fd);
+    throw systemError("Cannot resize", path);
+  }
+
+  map(fd, fileSize, true);
+
+  DistFileHeader header = {};
+  std::memcpy(header.magic, DIST_FILE_MAGIC, sizeof(header.magic));
+  header.numCurves = numCurves;
+  header.valueSize = valueSize(type);
+  std::memcpy(m_Mapping, &header, sizeof(header));
+}
+
+DistFile::DistFile(const std::string &path, bool writable)
+  : m_Path(path)
+{
+  int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (fd < 0)
+    throw systemError("Cannot open", path);
+
+  DistFileHeader header = {};
+  if (::pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      std::memcmp(header.magic, DIST_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      (header.valueSize != sizeof(float) && header.valueSize != sizeof(double)))
+  {
+    ::close(fd);
+    throw std::runtime_error("'" + path + "' is not a distance file.");
+  }
+
+  m_NumCurves = header.numCurves;
+  m_Type = header.valueSize == sizeof(float) ? DIST_FLOAT32 : DIST_FLOAT64;
+
+  struct stat info;
+  std::size_t fileSize = DIST_FILE_HEADER_SIZE + size() * header.valueSize;
+  if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < fileSize)
+  {
+    ::close(fd);
+    throw std::runtime_error("The distance file '" + path + "' is truncated.");
+  }
+
+  map(fd, fileSize, writable);
+}
+
+void DistFile::map(int fd, std::size_t fileSize, bool writable)
+{
+  int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *mapping = ::mmap(nullptr, fileSize, protection, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+    throw systemError("Cannot map", m_Path);
+
+  m_Mapping = mapping;
+  m_MappedBytes = fileSize;
+  m_Values = static_cast<char *>(mapping) + DIST_FILE_HEADER_SIZE;
+  m_Writable = writable;
+}
+
+DistFile::~DistFile()
+{
+  if (m_Mapping != nullptr)
+    ::munmap(m_Mapping, m_MappedBytes);
+}
+
+double DistFile::distance(std::size_t i, std::size_t j) const
+{
+  if (i == j)
+    return 0.0;
+  if (i > j)
+    std::swap(i, j);
+  return get(pairIndex(i, j, m_NumCurves));
+}
+
+void DistFile::row(std::size_t i, std::vector<double> &out) const
+{
+  out.resize(m_NumCurves);
+
+  // Before the diagonal, the row is scattered across the columns of the lower
+  // triangle; after it, it is the contiguous column of curve i.
+  for (std::size_t j = 0;j < i;++j)
+    out[j] = get(pairIndex(j, i, m_NumCurves));
+
+  out[i] = 0.0;
+
+  std::size_t k = pairIndex(i, i + 1, m_NumCurves);
+  for (std::size_t j = i + 1;j < m_NumCurves;++j, ++k)
+    out[j] = get(k);
+}
+
+void DistFile::flush()
+{
+  if (m_Writable && ::msync(m_Mapping, m_MappedBytes, MS_SYNC) != 0)
+    throw systemError("Cannot flush", m_Path);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum DistValueType
+{
+  DIST_FLOAT64,
+  DIST_FLOAT32
+};
+
+// Lower triangle of a distance matrix stored in a memory-mapped file, in the
+// same column-by-column order as a `dist` object.
+//
+// The file starts with a 64-byte header (magic, number of curves, value type)
+// followed by the N (N - 1) / 2 distances stored as float64 or float32. Only
+// the pages that are touched are resident, so the matrix can be much larger
+// than the available memory. Distinct pairs can be written concurrently.
+class DistFile
+{
+public:
+  // Creates (or truncates) `path` to hold the distances between `numCurves`
+  // curves.
+  DistFile(const std::string &path, std::size_t numCurves, DistValueType type);
+
+  // Opens an existing file, read-only unless `writable` is true.
+  explicit DistFile(const std::string &path, bool writable = false);
+
+  ~DistFile();
+
+  DistFile(const DistFile &) = delete;
+  DistFile &operator=(const DistFile &) = delete;
+
+  const std::string &path() const { return m_Path; }
+  std::size_t numCurves() const { return m_NumCurves; }
+  std::size_t size() const { return m_NumCurves * (m_NumCurves - 1) / 2; }
+  DistValueType type() const { return m_Type; }
+
+  // Access by position in the lower triangle, as in a `dist` vector.
+  double get(std::size_t k) const
+  {
+    if (m_Type == DIST_FLOAT32)
+      return static_cast<const float *>(m_Values)[k];
+    return static_cast<const double *>(m_Values)[k];
+  }
+
+  void set(std::size_t k, double value)
+  {
+    if (m_Type == DIST_FLOAT32)
+      static_cast<float *>(m_Values)[k] = value;
+    else
+      static_cast<double *>(m_Values)[k] = value;
+  }
+
+  // Distance between curves i and j (0 when i == j).
+  double distance(std::size_t i, std::size_t j) const;
+
+  // Distances from curve i to all curves, written into `out` (resized to N).
+  void row(std::size_t i, std::vector<double> &out) const;
+
+  // Flushes the mapped pages to disk.
+  void flush();
+
+private:
+  void map(int fd, std::size_t fileSize, bool writable);
+
+  std::string m_Path;
+  std::size_t m_NumCurves = 0;
+  DistValueType m_Type = DIST_FLOAT64;
+  std::size_t m_MappedBytes = 0;
+  void *m_Mapping = nullptr;
+  void *m_Values = nullptr;
+  bool m_Writable = false;
+};
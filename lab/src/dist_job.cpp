@@ -0,0 +1,263 @@
+#include "dist_job.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char DIST_CHECKPOINT_MAGIC[8] = {'H', 'C', 'K', 'P', 'T', '0', '0', '1'};
+
+// Followed by one byte per tile, 1 if it is done.
+struct DistCheckpointHeader
+{
+  char magic[8];
+  std::uint64_t fingerprint;
+  std::uint64_t numCurves;
+  std::uint64_t tileSize;
+  std::uint64_t numTiles;
+  std::uint32_t valueType;
+};
+
+static bool readCheckpoint(const std::string &path,
+                           const DistCheckpointHeader &expected,
+                           std::vector<unsigned char> &done)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  DistCheckpointHeader header = {};
+  done.resize(expected.numTiles);
+  bool ok = ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+    std::memcmp(&header, &expected, sizeof(header)) == 0 &&
+    ::read(fd, done.data(), done.size()) == static_cast<ssize_t>(done.size());
+  ::close(fd);
+  return ok;
+}
+
+// Writes the checkpoint next to `path` and renames it, so that a run killed
+// while writing leaves the previous checkpoint intact.
+static void writeCheckpoint(const std::string &path,
+                            const DistCheckpointHeader &header,
+                            const std::vector<unsigned char> &done)
+{
+  std::string tmpPath = path + ".tmp";
+  int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd >= 0 &&
+    ::write(fd, &header, sizeof(header)) == sizeof(header) &&
+    ::write(fd, done.data(), done.size()) == static_cast<ssize_t>(done.size()) &&
+    ::fsync(fd) == 0;
+  if (fd >= 0)
+    ::close(fd);
+
+  if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Cannot write the checkpoint '" + path + "': " + std::strerror(errno));
+}
+
+static DistCheckpointHeader checkpointHeader(std::uint64_t fingerprint,
+                                             std::size_t numCurves,
+                                             const PairTiling &tiling,
+                                             DistValueType type)
+{
+  // Zeroes the padding too, since headers are compared bytewise.
+  DistCheckpointHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, DIST_CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.fingerprint = fingerprint;
+  header.numCurves = numCurves;
+  header.tileSize = tiling.tileSize();
+  header.numTiles = tiling.size();
+  header.valueType = type;
+  return header;
+}
+
+DistJob::DistJob(const std::string &path,
+                 const PairTiling &tiling,
+                 std::size_t numCurves,
+                 DistValueType type,
+                 std::uint64_t fingerprint,
+                 const DistJobOptions &options)
+  : m_CheckpointPath(path + ".ckpt"), m_Tiling(tiling), m_Fingerprint(fingerprint),
+    m_Options(options), m_NumPairs(numCurves * (numCurves - 1) / 2),
+    m_Done(new std::atomic<unsigned char>[tiling.size()]),
+    m_PairsDone(0), m_TilesVisited(0), m_Cancelled(false),
+    m_Owner(std::this_thread::get_id())
+{
+  std::size_t numTiles = tiling.size();
+  DistCheckpointHeader header = checkpointHeader(fingerprint, numCurves, tiling, type);
+  std::vector<unsigned char> done;
+
+  // The checkpoint is only trusted if the distance file still matches it.
+  if (readCheckpoint(m_CheckpointPath, header, done))
+  {
+    try
+    {
+      m_File.reset(new DistFile(path, true));
+    }
+    catch (const std::runtime_error &)
+    {
+      m_File.reset();
+    }
+    if (m_File && (m_File->numCurves() != numCurves || m_File->type() != type))
+      m_File.reset();
+  }
+
+  if (!m_File)
+  {
+    ::unlink(m_CheckpointPath.c_str());
+    done.assign(numTiles, 0);
+    m_File.reset(new DistFile(path, numCurves, type));
+  }
+
+  for (std::size_t t = 0;t < numTiles;++t)
+  {
+    m_Done[t].store(done[t], std::memory_order_relaxed);
+    if (done[t])
+      m_ResumedPairs += tiling.numPairs(t);
+  }
+  m_PairsDone.store(m_ResumedPairs, std::memory_order_relaxed);
+
+  m_Start = std::chrono::steady_clock::now();
+  m_LastPoll = m_Start;
+  m_LastDisplay = m_Start;
+  m_LastCheckpoint = m_Start;
+}
+
+static void checkInterruptFunction(void *)
+{
+  R_CheckUserInterrupt();
+}
+
+// Whether the user pressed Ctrl-C, without the long jump of
+// `R_CheckUserInterrupt()` out of C++ code.
+static bool userInterrupted()
+{
+  return R_ToplevelExec(checkInterruptFunction, nullptr) == FALSE;
+}
+
+void DistJob::poll()
+{
+  if (std::this_thread::get_id() != m_Owner)
+    return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - m_LastPoll < std::chrono::milliseconds(100))
+    return;
+  m_LastPoll = now;
+
+  if (!isCancelled() && userInterrupted())
+  {
+    m_Interrupted = true;
+    cancel();
+  }
+
+  std::chrono::duration<double> elapsed = now - m_Start;
+  if (m_Options.timeLimit > 0.0 && elapsed.count() > m_Options.timeLimit)
+    cancel();
+
+  if (m_Options.displayProgress && now - m_LastDisplay >= std::chrono::seconds(1))
+  {
+    m_LastDisplay = now;
+    std::size_t done = pairsDone();
+    REprintf("\r%lu / %lu pairs (%.0f%%)", static_cast<unsigned long>(done),
+             static_cast<unsigned long>(m_NumPairs), m_NumPairs > 0 ? 100.0 * done / m_NumPairs : 100.0);
+  }
+
+  std::chrono::duration<double> sinceCheckpoint = now - m_LastCheckpoint;
+  if (sinceCheckpoint.count() >= m_Options.checkpointSeconds)
+    checkpoint();
+}
+
+void DistJob::checkpoint()
+{
+  try
+  {
+    // The tiles are read before the flush, so that the distances of all the
+    // tiles marked done are on disk when the checkpoint is.
+    std::size_t numTiles = m_Tiling.size();
+    std::vector<unsigned char> done(numTiles);
+    for (std::size_t t = 0;t < numTiles;++t)
+      done[t] = m_Done[t].load(std::memory_order_acquire);
+
+    m_File->flush();
+    writeCheckpoint(m_CheckpointPath,
+                    checkpointHeader(m_Fingerprint, m_File->numCurves(), m_Tiling, m_File->type()),
+                    done);
+  }
+  catch (const std::exception &error)
+  {
+    if (m_Error.empty())
+      m_Error = error.what();
+    cancel();
+  }
+  m_LastCheckpoint = std::chrono::steady_clock::now();
+}
+
+void DistJob::finish()
+{
+  if (m_Error.empty())
+    checkpoint();
+
+  std::size_t done = pairsDone();
+  if (m_Options.displayProgress)
+  {
+    REprintf("\r%lu / %lu pairs (%.0f%%)\n", static_cast<unsigned long>(done),
+             static_cast<unsigned long>(m_NumPairs), m_NumPairs > 0 ? 100.0 * done / m_NumPairs : 100.0);
+  }
+
+  if (!m_Error.empty())
+    Rcpp::stop("%s. Stopped after %d of %d pairs.", m_Error, done, m_NumPairs);
+
+  if (done < m_NumPairs)
+  {
+    Rcpp::stop("%s after %d of %d pairs, saved in '%s'. Call again with the same arguments to resume.",
+               m_Interrupted ? "Interrupted" : "Time limit reached", done, m_NumPairs, m_CheckpointPath);
+  }
+}
+
+// FNV-1a on 64-bit words.
+static std::uint64_t hashWords(std::uint64_t hash, const void *data, std::size_t numBytes)
+{
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (std::size_t b = 0;b + 8 <= numBytes;b += 8)
+  {
+    std::uint64_t word;
+    std::memcpy(&word, bytes + b, 8);
+    hash = (hash ^ word) * 0x100000001b3ULL;
+  }
+  for (std::size_t b = numBytes - numBytes % 8;b < numBytes;++b)
+    hash = (hash ^ bytes[b]) * 0x100000001b3ULL;
+  return hash;
+}
+
+std::uint64_t sampleFingerprint(const HausdorffSample &sample)
+{
+  const CurvePlanes &curves = sample.curves();
+  std::uint64_t header[5] = {
+    curves.size(), curves.dimension(), curves.numPoints(),
+    static_cast<std::uint64_t>(sample.algorithm()), static_cast<std::uint64_t>(sample.precision())
+  };
+
+  std::uint64_t hash = hashWords(0xcbf29ce484222325ULL, header, sizeof(header));
+
+  // The hashes of the points of a curve are added up, so that the hash of the
+  // curve does not depend on the order of its points, which preparing shuffles.
+  std::vector<double> point(curves.dimension());
+  for (std::size_t i = 0;i < curves.size();++i)
+  {
+    const double *curve = curves.curve(i);
+    std::uint64_t curveHash = 0;
+    for (std::size_t p = 0;p < curves.numPoints();++p)
+    {
+      for (unsigned int k = 0;k < curves.dimension();++k)
+        point[k] = curve[k * curves.stride() + p];
+      curveHash += hashWords(0xcbf29ce484222325ULL, point.data(), point.size() * sizeof(double));
+    }
+    hash = hashWords(hash, &curveHash, sizeof(curveHash));
+  }
+  return hash;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <Rcpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dist_file.h"
+#include "hausdorff_sample.h"
+#include "pair_scheduler.h"
+
+struct DistJobOptions
+{
+  // Seconds between two checkpoints.
+  double checkpointSeconds = 60.0;
+  // The job is cancelled after that many seconds, or never if 0.
+  double timeLimit = 0.0;
+  // Whether to print the number of pairs done every second.
+  bool displayProgress = false;
+};
+
+// A long computation of the distances between N curves into a `DistFile`,
+// tile by tile of a `PairTiling`, that reports its progress, can be cancelled
+// between two tiles and resumes where a previous run stopped.
+//
+// The tiles done are recorded in memory as they complete, with one atomic
+// flag per tile and one atomic counter of pairs, and saved periodically in
+// the checkpoint file `<path>.ckpt` once the distances are flushed to disk.
+// A later job on the same file with the same fingerprint (curves, algorithm,
+// precision, tiling and value type) skips the tiles of the checkpoint; any
+// other job starts from scratch.
+//
+// Only the thread that created the job talks to R: `poll()` checks for user
+// interrupts, prints the progress and saves the checkpoints when called from
+// it, and does nothing on the other threads. `poll()` never throws, since it
+// runs inside parallel regions: a checkpoint that cannot be saved cancels the
+// job, and the error is raised by `finish()` once the workers are done.
+class DistJob
+{
+public:
+  DistJob(const std::string &path,
+          const PairTiling &tiling,
+          std::size_t numCurves,
+          DistValueType type,
+          std::uint64_t fingerprint,
+          const DistJobOptions &options);
+
+  DistJob(const DistJob &) = delete;
+  DistJob &operator=(const DistJob &) = delete;
+
+  DistFile &file() { return *m_File; }
+  const PairTiling &tiling() const { return m_Tiling; }
+
+  std::size_t numPairs() const { return m_NumPairs; }
+  std::size_t pairsDone() const { return m_PairsDone.load(std::memory_order_relaxed); }
+
+  // Pairs already done when the job was resumed.
+  std::size_t resumedPairs() const { return m_ResumedPairs; }
+
+  // Number of tiles run, skipped or dropped so far.
+  std::size_t tilesVisited() const { return m_TilesVisited.load(std::memory_order_acquire); }
+
+  bool isCancelled() const { return m_Cancelled.load(std::memory_order_relaxed); }
+  void cancel() { m_Cancelled.store(true, std::memory_order_relaxed); }
+
+  // Runs the t-th tile as `task()`, which returns its number of pairs, unless
+  // it was done in a previous run or the job is cancelled.
+  template <typename Task>
+  void run(std::size_t t, Task task)
+  {
+    if (!isCancelled() && !m_Done[t].load(std::memory_order_relaxed))
+    {
+      std::size_t numPairs = task();
+      m_Done[t].store(1, std::memory_order_release);
+      m_PairsDone.fetch_add(numPairs, std::memory_order_relaxed);
+    }
+    m_TilesVisited.fetch_add(1, std::memory_order_release);
+  }
+
+  // Called between tiles. On the thread that created the job, at most every
+  // 100 ms: cancels the job on a user interrupt or past the time limit,
+  // prints the progress and saves a checkpoint when one is due.
+  void poll();
+
+  // Saves a last checkpoint and stops with an error if the job was
+  // cancelled or a checkpoint could not be saved. Must be called once no
+  // worker runs tiles anymore.
+  void finish();
+
+private:
+  // Saves a checkpoint, or records the error and cancels the job.
+  void checkpoint();
+
+  std::string m_CheckpointPath;
+  const PairTiling &m_Tiling;
+  std::uint64_t m_Fingerprint;
+  DistJobOptions m_Options;
+  std::unique_ptr<DistFile> m_File;
+  std::size_t m_NumPairs;
+  std::size_t m_ResumedPairs = 0;
+  std::unique_ptr<std::atomic<unsigned char>[]> m_Done;
+  std::atomic<std::size_t> m_PairsDone;
+  std::atomic<std::size_t> m_TilesVisited;
+  std::atomic<bool> m_Cancelled;
+  bool m_Interrupted = false;
+  std::string m_Error;
+
+  std::thread::id m_Owner;
+  std::chrono::steady_clock::time_point m_Start;
+  std::chrono::steady_clock::time_point m_LastPoll;
+  std::chrono::steady_clock::time_point m_LastDisplay;
+  std::chrono::steady_clock::time_point m_LastCheckpoint;
+};
+
+// Hash of the curves of a sample and of its algorithm and precision, which
+// identifies the inputs of a job. It does not depend on the order of the
+// points of each curve, so it is the same before and after the curves are
+// prepared, whether they come from a list or from a packed sample.
+std::uint64_t sampleFingerprint(const HausdorffSample &sample);
@@ -0,0 +1,156 @@
+#include "dist_profile.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+static const std::uint64_t PROFILE_EVENT_CONFIGS[] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// Opens a disabled counter of `config` for the calling thread, or returns -1.
+static int openEventCounter(std::uint64_t config)
+{
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+ThreadProfile::ThreadProfile()
+  : m_NumTasks(0), m_NumPairs(0), m_NumPoints(0), m_Seconds(0.0)
+{
+  for (int e = 0;e < PROFILE_NUM_EVENTS;++e)
+  {
+#ifdef __linux__
+    m_Events[e] = openEventCounter(PROFILE_EVENT_CONFIGS[e]);
+#else
+    m_Events[e] = -1;
+#endif
+  }
+}
+
+ThreadProfile::~ThreadProfile()
+{
+#ifdef __linux__
+  for (int e = 0;e < PROFILE_NUM_EVENTS;++e)
+  {
+    if (m_Events[e] >= 0)
+      close(m_Events[e]);
+  }
+#endif
+}
+
+void ThreadProfile::start()
+{
+#ifdef __linux__
+  for (int e = 0;e < PROFILE_NUM_EVENTS;++e)
+  {
+    if (m_Events[e] >= 0)
+      ioctl(m_Events[e], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+  visitedPoints() = 0;
+  m_Start = std::chrono::steady_clock::now();
+}
+
+void ThreadProfile::stop(std::size_t numPairs)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_Start;
+#ifdef __linux__
+  for (int e = 0;e < PROFILE_NUM_EVENTS;++e)
+  {
+    if (m_Events[e] >= 0)
+      ioctl(m_Events[e], PERF_EVENT_IOC_DISABLE, 0);
+  }
+#endif
+  m_Seconds += elapsed.count();
+  m_NumPairs += numPairs;
+  m_NumPoints += visitedPoints();
+  ++m_NumTasks;
+}
+
+double ThreadProfile::count(ProfileEvent event) const
+{
+#ifdef __linux__
+  // Value, time enabled and time running (see `read_format`). A multiplexed
+  // count would have to be extrapolated from the time it ran, which is
+  // misleading over short tasks, so it is reported as missing.
+  std::uint64_t values[3];
+  if (m_Events[event] >= 0 && read(m_Events[event], values, sizeof(values)) == sizeof(values) &&
+      values[2] > 0 && values[2] >= values[1])
+    return static_cast<double>(values[0]);
+#endif
+  return NA_REAL;
+}
+
+ThreadProfile &DistProfile::thread()
+{
+  std::thread::id id = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  for (std::size_t t = 0;t < m_Ids.size();++t)
+  {
+    if (m_Ids[t] == id)
+      return *m_Threads[t];
+  }
+
+  m_Ids.push_back(id);
+  m_Threads.push_back(std::unique_ptr<ThreadProfile>(new ThreadProfile()));
+  return *m_Threads.back();
+}
+
+Rcpp::DataFrame DistProfile::summary() const
+{
+  std::size_t numThreads = m_Threads.size();
+  Rcpp::NumericVector tasks(numThreads);
+  Rcpp::NumericVector pairs(numThreads);
+  Rcpp::NumericVector points(numThreads);
+  Rcpp::NumericVector seconds(numThreads);
+  Rcpp::NumericVector cycles(numThreads);
+  Rcpp::NumericVector instructions(numThreads);
+  Rcpp::NumericVector cacheMisses(numThreads);
+  Rcpp::NumericVector branchMisses(numThreads);
+
+  for (std::size_t t = 0;t < numThreads;++t)
+  {
+    const ThreadProfile &profile = *m_Threads[t];
+    tasks[t] = profile.numTasks();
+    pairs[t] = profile.numPairs();
+    points[t] = profile.numPoints();
+    seconds[t] = profile.seconds();
+    cycles[t] = profile.count(PROFILE_CYCLES);
+    instructions[t] = profile.count(PROFILE_INSTRUCTIONS);
+    cacheMisses[t] = profile.count(PROFILE_CACHE_MISSES);
+    branchMisses[t] = profile.count(PROFILE_BRANCH_MISSES);
+  }
+
+  return Rcpp::DataFrame::create(
+    Rcpp::Named("thread") = Rcpp::seq(1, numThreads),
+    Rcpp::Named("tasks") = tasks,
+    Rcpp::Named("pairs") = pairs,
+    Rcpp::Named("points") = points,
+    Rcpp::Named("seconds") = seconds,
+    Rcpp::Named("cycles") = cycles,
+    Rcpp::Named("instructions") = instructions,
+    Rcpp::Named("cache_misses") = cacheMisses,
+    Rcpp::Named("branch_misses") = branchMisses
+  );
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <Rcpp.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Hardware events counted by `ThreadProfile`.
+enum ProfileEvent
+{
+  PROFILE_CYCLES,
+  PROFILE_INSTRUCTIONS,
+  PROFILE_CACHE_MISSES,
+  PROFILE_BRANCH_MISSES,
+  PROFILE_NUM_EVENTS
+};
+
+// Counters of the tasks of pairs run by one thread. The hardware events are
+// counted in user space through `perf_event_open()` on Linux, only while the
+// thread runs a task. Events the kernel refuses to count (no PMU in most
+// virtual machines, or a too restrictive `perf_event_paranoid`) are missing.
+class ThreadProfile
+{
+public:
+  ThreadProfile();
+  ~ThreadProfile();
+
+  ThreadProfile(const ThreadProfile &) = delete;
+  ThreadProfile &operator=(const ThreadProfile &) = delete;
+
+  void start();
+  void stop(std::size_t numPairs);
+
+  // Number of distances between points computed by the kernels of the
+  // calling thread since its last `start()`.
+  static std::size_t &visitedPoints()
+  {
+    static thread_local std::size_t visited = 0;
+    return visited;
+  }
+
+  std::size_t numTasks() const { return m_NumTasks; }
+  std::size_t numPairs() const { return m_NumPairs; }
+  std::size_t numPoints() const { return m_NumPoints; }
+  double seconds() const { return m_Seconds; }
+
+  // Count of `event` over the tasks, or NA if it is missing or if the kernel
+  // multiplexed the counter, i.e. did not count it all the time it was
+  // enabled, because more events were requested than the PMU has counters.
+  double count(ProfileEvent event) const;
+
+private:
+  int m_Events[PROFILE_NUM_EVENTS];
+  std::size_t m_NumTasks;
+  std::size_t m_NumPairs;
+  std::size_t m_NumPoints;
+  double m_Seconds;
+  std::chrono::steady_clock::time_point m_Start;
+};
+
+// Per-thread profiles of one `dist` computation.
+class DistProfile
+{
+public:
+  // Profile of the calling thread, whose counters are opened on its first
+  // call.
+  ThreadProfile &thread();
+
+  // One row per thread with its numbers of tasks, pairs and distances between
+  // points computed by the kernels, which the early-break and k-d tree
+  // algorithms keep well below the points of the pairs, its busy time in
+  // seconds and its hardware counts.
+  Rcpp::DataFrame summary() const;
+
+private:
+  std::mutex m_Mutex;
+  std::vector<std::thread::id> m_Ids;
+  std::vector< std::unique_ptr<ThreadProfile> > m_Threads;
+};
+
+// Profiler policies of the pair loops of the backends: each task of pairs
+// runs as `profiler(task)`, where `task()` returns its number of pairs, and
+// computes the distance of each pair as `profiler.distance(x, i, j)`. The
+// default `NoProfiler` inlines to the bare loop, so that collection costs
+// nothing unless requested.
+struct NoProfiler
+{
+  template <typename Task>
+  void operator()(Task task) const
+  {
+    task();
+  }
+
+  template <typename Sample>
+  double distance(const Sample &x, std::size_t i, std::size_t j) const
+  {
+    return x.distance(i, j);
+  }
+};
+
+struct DistProfiler
+{
+  DistProfile *m_Profile;
+
+  template <typename Task>
+  void operator()(Task task) const
+  {
+    ThreadProfile &profile = m_Profile->thread();
+    profile.start();
+    std::size_t numPairs = task();
+    profile.stop(numPairs);
+  }
+
+  template <typename Sample>
+  double distance(const Sample &x, std::size_t i, std::size_t j) const
+  {
+    return x.distance(i, j, ThreadProfile::visitedPoints());
+  }
+};
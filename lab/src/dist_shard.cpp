@@ -0,0 +1,162 @@
+#include "dist_shard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char DIST_SHARD_MAGIC[8] = {'H', 'S', 'H', 'R', 'D', '0', '0', '1'};
+
+// Values per read or write, so that no call exceeds the 2 GB that Linux
+// transfers at once.
+static const std::size_t DIST_SHARD_CHUNK_SIZE = 1 << 16;
+
+static std::size_t shardValueSize(const DistShardHeader &header)
+{
+  return header.valueType == DIST_FLOAT32 ? sizeof(float) : sizeof(double);
+}
+
+void shardTiles(const PairTiling &tiling,
+                std::size_t numShards,
+                std::size_t shard,
+                std::size_t &begin,
+                std::size_t &end)
+{
+  std::size_t numTiles = tiling.size();
+  std::size_t numPairs = 0;
+  for (std::size_t t = 0;t < numTiles;++t)
+    numPairs += tiling.numPairs(t);
+
+  begin = numTiles;
+  end = numTiles;
+  if (numPairs == 0)
+    return;
+
+  // Tiles are assigned in order, so the shards are nondecreasing along them.
+  std::size_t pairsBefore = 0;
+  for (std::size_t t = 0;t < numTiles;++t)
+  {
+    std::size_t tileShard = std::min(pairsBefore * numShards / numPairs, numShards - 1);
+    if (tileShard >= shard && begin == numTiles)
+      begin = t;
+    if (tileShard > shard)
+    {
+      end = t;
+      break;
+    }
+    pairsBefore += tiling.numPairs(t);
+  }
+}
+
+std::string distShardPath(const std::string &prefix, std::size_t shard, std::size_t numShards)
+{
+  return prefix + ".shard-" + std::to_string(shard + 1) + "-of-" + std::to_string(numShards);
+}
+
+DistShardHeader distShardHeader(std::uint64_t fingerprint,
+                                std::size_t numCurves,
+                                const PairTiling &tiling,
+                                std::size_t shard,
+                                std::size_t numShards,
+                                DistValueType type)
+{
+  std::size_t begin, end;
+  shardTiles(tiling, numShards, shard, begin, end);
+
+  // Zeroes the padding too, since headers are compared bytewise.
+  DistShardHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, DIST_SHARD_MAGIC, sizeof(header.magic));
+  header.fingerprint = fingerprint;
+  header.numCurves = numCurves;
+  header.tileSize = tiling.tileSize();
+  header.tileBegin = begin;
+  header.tileEnd = end;
+  for (std::size_t t = begin;t < end;++t)
+    header.numValues += tiling.numPairs(t);
+  header.shard = shard;
+  header.numShards = numShards;
+  header.valueType = type;
+  return header;
+}
+
+bool readDistShardHeader(const std::string &path, DistShardHeader &header)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat status;
+  bool ok = ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+    std::memcmp(header.magic, DIST_SHARD_MAGIC, sizeof(header.magic)) == 0 &&
+    (header.valueType == DIST_FLOAT64 || header.valueType == DIST_FLOAT32) &&
+    ::fstat(fd, &status) == 0 &&
+    static_cast<std::uint64_t>(status.st_size) == sizeof(header) + header.numValues * shardValueSize(header);
+  ::close(fd);
+  return ok;
+}
+
+void writeDistShard(const std::string &path,
+                    const DistShardHeader &header,
+                    const std::vector<double> &values)
+{
+  std::string tmpPath = path + ".tmp";
+  int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd >= 0 && ::write(fd, &header, sizeof(header)) == sizeof(header);
+
+  std::vector<float> floats;
+  for (std::size_t begin = 0;ok && begin < header.numValues;begin += DIST_SHARD_CHUNK_SIZE)
+  {
+    std::size_t n = std::min<std::size_t>(DIST_SHARD_CHUNK_SIZE, header.numValues - begin);
+    const void *data = values.data() + begin;
+    if (header.valueType == DIST_FLOAT32)
+    {
+      floats.assign(values.begin() + begin, values.begin() + begin + n);
+      data = floats.data();
+    }
+    std::size_t bytes = n * shardValueSize(header);
+    ok = ::write(fd, data, bytes) == static_cast<ssize_t>(bytes);
+  }
+
+  ok = ok && ::fsync(fd) == 0;
+  if (fd >= 0)
+    ::close(fd);
+
+  if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Cannot write the shard '" + path + "': " + std::strerror(errno));
+}
+
+void readDistShardValues(const std::string &path,
+                         const DistShardHeader &header,
+                         std::vector<double> &values)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  values.resize(header.numValues);
+
+  bool ok = fd >= 0;
+  std::vector<float> floats;
+  for (std::size_t begin = 0;ok && begin < header.numValues;begin += DIST_SHARD_CHUNK_SIZE)
+  {
+    std::size_t n = std::min<std::size_t>(DIST_SHARD_CHUNK_SIZE, header.numValues - begin);
+    void *data = values.data() + begin;
+    if (header.valueType == DIST_FLOAT32)
+    {
+      floats.resize(n);
+      data = floats.data();
+    }
+    std::size_t bytes = n * shardValueSize(header);
+    ok = ::pread(fd, data, bytes, sizeof(header) + begin * shardValueSize(header)) == static_cast<ssize_t>(bytes);
+    if (ok && header.valueType == DIST_FLOAT32)
+      std::copy(floats.begin(), floats.end(), values.begin() + begin);
+  }
+
+  if (fd >= 0)
+    ::close(fd);
+  if (!ok)
+    throw std::runtime_error("Cannot read the shard '" + path + "': " + std::strerror(errno));
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dist_file.h"
+#include "pair_scheduler.h"
+
+// A `dist` computation split into shards, computed by independent processes
+// into their own files and merged afterwards.
+//
+// The tiles of a `PairTiling` are split into `numShards` ranges of
+// consecutive tiles with about the same number of pairs (see `shardTiles()`).
+// The shard file `<prefix>.shard-<s>-of-<S>` holds a header followed by the
+// distances of the pairs of its tiles, as float64 or float32, in the order of
+// `PairTiling::forEachPair()`. It is written next to its final path and then
+// renamed, so that a shard file either is complete or does not exist, and a
+// process killed while computing a shard leaves nothing behind but a
+// temporary file that the next run overwrites.
+
+// Identifies a shard and the computation it belongs to: shards can only be
+// merged if all fields but `shard`, `tileBegin`, `tileEnd` and `numValues`
+// agree. Compared bytewise, so it must be built by `distShardHeader()`.
+struct DistShardHeader
+{
+  char magic[8];
+  std::uint64_t fingerprint;
+  std::uint64_t numCurves;
+  std::uint64_t tileSize;
+  std::uint64_t tileBegin;
+  std::uint64_t tileEnd;
+  std::uint64_t numValues;
+  std::uint32_t shard;
+  std::uint32_t numShards;
+  std::uint32_t valueType;
+};
+
+// Tiles [begin, end) of the `shard`-th of `numShards` shards. A tile goes to
+// the shard in which its first pair falls when the pairs are split into
+// `numShards` equal ranges, so shards differ by less than one tile of pairs
+// and may be empty if there are fewer tiles than shards.
+void shardTiles(const PairTiling &tiling,
+                std::size_t numShards,
+                std::size_t shard,
+                std::size_t &begin,
+                std::size_t &end);
+
+std::string distShardPath(const std::string &prefix, std::size_t shard, std::size_t numShards);
+
+// Header of the `shard`-th shard of the distances between the `numCurves`
+// curves identified by `fingerprint` (see `sampleFingerprint()`).
+DistShardHeader distShardHeader(std::uint64_t fingerprint,
+                                std::size_t numCurves,
+                                const PairTiling &tiling,
+                                std::size_t shard,
+                                std::size_t numShards,
+                                DistValueType type);
+
+// Reads the header of the shard file `path` and returns whether it is a
+// complete shard file, whose size matches its header.
+bool readDistShardHeader(const std::string &path, DistShardHeader &header);
+
+// Writes `values`, header.numValues of them, as the shard file `path`.
+void writeDistShard(const std::string &path,
+                    const DistShardHeader &header,
+                    const std::vector<double> &values);
+
+// Reads the values of the shard file `path`, whose header is `header`.
+void readDistShardValues(const std::string &path,
+                         const DistShardHeader &header,
+                         std::vector<double> &values);
+
+// Calls `write(k, value)` for each value of a shard, where `k` is the
+// position of its pair in the `dist` vector.
+template <typename Writer>
+void forEachShardValue(const PairTiling &tiling,
+                       const DistShardHeader &header,
+                       const std::vector<double> &values,
+                       Writer write)
+{
+  std::size_t v = 0;
+  for (std::size_t t = header.tileBegin;t < header.tileEnd;++t)
+  {
+    tiling.forEachPair(t, [&values, &write, &v] (std::size_t, std::size_t, std::size_t k) {
+      write(k, values[v++]);
+    });
+  }
+}
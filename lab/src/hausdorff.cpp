@@ -1,5 +1,8 @@
 #include <Rcpp.h>
 
+#include <algorithm>
+#include <vector>
+
 // // [[Rcpp::plugins(openmp)]] // Uncomment on Windows and Linux
 
 // [[Rcpp::depends(RcppParallel)]]
@@ -86,6 +89,59 @@ double hausdorff_distance_cpp(RcppParallel::RMatrix<double>::Row x,
   return std::sqrt(std::max(dX, dY));
 }
 
+// Square tiles of pairs (i, j), i < j, of a sample of `numCurves` curves, the
+// side of which is chosen so that the curves of a tile fill about half of a
+// 256 KiB L2 cache. This is a copy of `PairTiling` and `defaultTileSize()`
+// (see `pair_scheduler.h`) reduced to what the backends below need, so that
+// this file compiles on its own.
+class PairTiles
+{
+public:
+  PairTiles(std::size_t numCurves, std::size_t bytesPerCurve)
+    : m_NumCurves(numCurves)
+  {
+    m_TileSize = 128 * 1024 / (2 * std::max(bytesPerCurve, std::size_t(1)));
+    m_TileSize = std::min(std::max(m_TileSize, std::size_t(1)), std::size_t(64));
+
+    std::size_t numBlocks = (m_NumCurves + m_TileSize - 1) / m_TileSize;
+    for (std::size_t a = 0;a < numBlocks;++a)
+    {
+      for (std::size_t b = a;b < numBlocks;++b)
+      {
+        m_RowBlocks.push_back(a);
+        m_ColBlocks.push_back(b);
+      }
+    }
+  }
+
+  std::size_t size() const { return m_RowBlocks.size(); }
+
+  // Calls `f(i, j, k)` for each pair (i, j) of the t-th tile, where `k` is
+  // the position of the pair in the `dist` vector.
+  template <typename Function>
+  void forEachPair(std::size_t t, Function f) const
+  {
+    std::size_t N = m_NumCurves;
+    std::size_t rowEnd = std::min((m_RowBlocks[t] + 1) * m_TileSize, N);
+    std::size_t colStart = m_ColBlocks[t] * m_TileSize;
+    std::size_t colEnd = std::min(colStart + m_TileSize, N);
+
+    for (std::size_t i = m_RowBlocks[t] * m_TileSize;i < rowEnd;++i)
+    {
+      std::size_t j = std::max(colStart, i + 1);
+      std::size_t k = i * (2 * N - i - 1) / 2 + (j - i - 1);
+      for (;j < colEnd;++j, ++k)
+        f(i, j, k);
+    }
+  }
+
+private:
+  std::size_t m_NumCurves;
+  std::size_t m_TileSize;
+  std::vector<std::size_t> m_RowBlocks;
+  std::vector<std::size_t> m_ColBlocks;
+};
+
 Rcpp::NumericMatrix listToMatrix(Rcpp::List x)
 {
   unsigned int nrows = x.size();
@@ -109,20 +165,22 @@ Rcpp::NumericVector dist_omp(Rcpp::NumericMatrix x,
                              unsigned int dimension = 1,
                              unsigned int ncores = 1)
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  std::size_t N = x.nrow();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
   RcppParallel::RMatrix<double> xSafe(x);
   RcppParallel::RVector<double> outSafe(out);
+  PairTiles tiling(N, x.ncol() * sizeof(double));
+  std::ptrdiff_t numTiles = tiling.size();
 
 #ifdef _OPENMP
-  #pragma omp parallel for num_threads(ncores)
+  #pragma omp parallel for schedule(dynamic) num_threads(ncores)
 #endif
-  for (unsigned int k = 0;k < K;++k)
+  for (std::ptrdiff_t t = 0;t < numTiles;++t)
   {
-    unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-    unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-    outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+    tiling.forEachPair(t, [&xSafe, &outSafe, dimension] (std::size_t i, std::size_t j, std::size_t k) {
+      outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+    });
   }
 
   out.attr("Size") = N;
@@ -148,20 +206,21 @@ struct HausdorffDistanceComputer : public RcppParallel::Worker
   const RcppParallel::RMatrix<double> m_SafeInput;
   RcppParallel::RVector<double> m_SafeOutput;
   unsigned int m_Dimension;
+  const PairTiles &m_Tiling;
 
   HausdorffDistanceComputer(const Rcpp::NumericMatrix x,
                     Rcpp::NumericVector out,
-                    unsigned int dimension)
-    : m_SafeInput(x), m_SafeOutput(out), m_Dimension(dimension) {}
+                    unsigned int dimension,
+                    const PairTiles &tiling)
+    : m_SafeInput(x), m_SafeOutput(out), m_Dimension(dimension), m_Tiling(tiling) {}
 
   void operator()(std::size_t begin, std::size_t end)
   {
-    unsigned int N = m_SafeInput.nrow();
-    for (std::size_t k = begin;k < end;++k)
+    for (std::size_t t = begin;t < end;++t)
     {
-      unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-      unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-      m_SafeOutput[k] = hausdorff_distance_cpp(m_SafeInput.row(i), m_SafeInput.row(j), m_Dimension);
+      m_Tiling.forEachPair(t, [this] (std::size_t i, std::size_t j, std::size_t k) {
+        m_SafeOutput[k] = hausdorff_distance_cpp(m_SafeInput.row(i), m_SafeInput.row(j), m_Dimension);
+      });
     }
   }
 };
@@ -170,11 +229,12 @@ Rcpp::NumericVector dist_parallel(Rcpp::NumericMatrix x,
                                   unsigned int dimension = 1,
                                   unsigned int ncores = 1)
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  std::size_t N = x.nrow();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
-  HausdorffDistanceComputer hausdorffDistance(x, out, dimension);
-  RcppParallel::parallelFor(0, K, hausdorffDistance, 1, ncores);
+  PairTiles tiling(N, x.ncol() * sizeof(double));
+  HausdorffDistanceComputer hausdorffDistance(x, out, dimension, tiling);
+  RcppParallel::parallelFor(0, tiling.size(), hausdorffDistance, 1, ncores);
   out.attr("Size") = x.nrow();
   out.attr("Labels") = Rcpp::seq(1, x.nrow());
   out.attr("Diag") = false;
@@ -197,20 +257,20 @@ Rcpp::NumericVector dist_thread(Rcpp::NumericMatrix x,
                                 unsigned int dimension = 1,
                                 unsigned int ncores = 1)
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  std::size_t N = x.nrow();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
   RcppParallel::RMatrix<double> xSafe(x);
   RcppParallel::RVector<double> outSafe(out);
+  PairTiles tiling(N, x.ncol() * sizeof(double));
 
-  auto task = [&xSafe, &outSafe, &dimension] (unsigned int k) {
-    unsigned int N = xSafe.nrow();
-    unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-    unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-    outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+  auto task = [&xSafe, &outSafe, &dimension, &tiling] (std::size_t t) {
+    tiling.forEachPair(t, [&xSafe, &outSafe, &dimension] (std::size_t i, std::size_t j, std::size_t k) {
+      outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+    });
   };
 
-  RcppThread::parallelFor(0, K, task, ncores);
+  RcppThread::parallelFor(0, tiling.size(), task, ncores);
 
   out.attr("Size") = N;
   out.attr("Labels") = Rcpp::seq(1, N);
@@ -0,0 +1,18 @@
+#pragma once
+#include "hausdorff_utils.h"
+
+// In-memory `dist` computation of each backend, defined in
+// `hausdorff_omp.cpp`, `hausdorff_parallel.cpp` and `hausdorff_thread.cpp`.
+// The pairs are scheduled in tiles of `tileSize` curves, or of
+// `defaultTileSize()` curves if it is 0.
+Rcpp::NumericVector dist_omp(HausdorffSample &xSample,
+                             unsigned int ncores,
+                             std::size_t tileSize);
+
+Rcpp::NumericVector dist_parallel(HausdorffSample &xSample,
+                                  unsigned int ncores,
+                                  std::size_t tileSize);
+
+Rcpp::NumericVector dist_thread(HausdorffSample &xSample,
+                                unsigned int ncores,
+                                std::size_t tileSize);
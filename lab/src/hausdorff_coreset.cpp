@@ -0,0 +1,337 @@
+#include "hausdorff_coreset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Farthest-point traversal of the `numPoints` points of a curve stored as
+// planes of `stride` doubles: starting from the first point, the point
+// farthest from the points already picked is added until all points lie
+// within `eps` of them. Returns the covering radius of the picked points,
+// whose indices are stored in `net`.
+static double greedyNet(const double *x,
+                        unsigned int dimension,
+                        std::size_t numPoints,
+                        std::size_t stride,
+                        double eps,
+                        std::vector<std::size_t> &net)
+{
+  net.clear();
+  if (numPoints == 0)
+    return 0.0;
+
+  // Squared distance from each point to the nearest picked point.
+  std::vector<double> gaps(numPoints, std::numeric_limits<double>::infinity());
+  std::vector<double> dist(numPoints);
+  std::size_t next = 0;
+  double radiusSquared = 0.0;
+
+  while (true)
+  {
+    net.push_back(next);
+
+    std::fill(dist.begin(), dist.end(), 0.0);
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      const double *plane = x + k * stride;
+      const double value = plane[next];
+      for (std::size_t p = 0;p < numPoints;++p)
+      {
+        double diff = plane[p] - value;
+        dist[p] += diff * diff;
+      }
+    }
+
+    radiusSquared = 0.0;
+    std::size_t farthest = next;
+    for (std::size_t p = 0;p < numPoints;++p)
+    {
+      gaps[p] = std::min(gaps[p], dist[p]);
+      if (gaps[p] > radiusSquared)
+      {
+        radiusSquared = gaps[p];
+        farthest = p;
+      }
+    }
+
+    if (radiusSquared <= eps * eps)
+      break;
+    next = farthest;
+  }
+
+  return std::sqrt(radiusSquared);
+}
+
+// Picks the coreset of each curve and its covering radius.
+struct CoresetSelector : public RcppParallel::Worker
+{
+  const RaggedCurvePlanes &m_Curves;
+  double m_Eps;
+  std::vector< std::vector<std::size_t> > &m_Nets;
+  std::vector<double> &m_Radii;
+
+  CoresetSelector(const RaggedCurvePlanes &curves,
+                  double eps,
+                  std::vector< std::vector<std::size_t> > &nets,
+                  std::vector<double> &radii)
+    : m_Curves(curves), m_Eps(eps), m_Nets(nets), m_Radii(radii) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin;i < end;++i)
+    {
+      m_Radii[i] = greedyNet(m_Curves.curve(i), m_Curves.dimension(), m_Curves.numPoints(i),
+                             m_Curves.stride(i), m_Eps, m_Nets[i]);
+    }
+  }
+};
+
+// Copies the points of each coreset into its planes of `m_Output`. The
+// traversal order spreads the first points over the whole curve, which suits
+// the early-break kernel as well as shuffling does.
+struct CoresetCopier : public RcppParallel::Worker
+{
+  const RaggedCurvePlanes &m_Curves;
+  const std::vector< std::vector<std::size_t> > &m_Nets;
+  RaggedCurvePlanes &m_Output;
+
+  CoresetCopier(const RaggedCurvePlanes &curves,
+                const std::vector< std::vector<std::size_t> > &nets,
+                RaggedCurvePlanes &output)
+    : m_Curves(curves), m_Nets(nets), m_Output(output) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin;i < end;++i)
+    {
+      const std::vector<std::size_t> &net = m_Nets[i];
+      for (unsigned int k = 0;k < m_Curves.dimension();++k)
+      {
+        const double *plane = m_Curves.curve(i) + k * m_Curves.stride(i);
+        double *out = m_Output.curve(i) + k * m_Output.stride(i);
+        for (std::size_t c = 0;c < net.size();++c)
+          out[c] = plane[net[c]];
+      }
+      m_Output.pad(i);
+    }
+  }
+};
+
+CurveCoresets buildCurveCoresets(const RaggedCurvePlanes &curves,
+                                 double eps,
+                                 unsigned int ncores)
+{
+  std::size_t N = curves.size();
+  std::vector< std::vector<std::size_t> > nets(N);
+  std::vector<double> radii(N);
+
+  CoresetSelector selector(curves, eps, nets, radii);
+  RcppParallel::parallelFor(0, N, selector, 1, ncores);
+
+  std::vector<std::size_t> sizes(N);
+  for (std::size_t i = 0;i < N;++i)
+    sizes[i] = nets[i].size();
+
+  RaggedCurvePlanes points(sizes, curves.dimension());
+  CoresetCopier copier(curves, nets, points);
+  RcppParallel::parallelFor(0, N, copier, 1, ncores);
+
+  return CurveCoresets(std::move(points), std::move(radii));
+}
+
+HausdorffInterval CurveCoresets::bounds(std::size_t i, std::size_t j) const
+{
+  double dij = std::sqrt(hausdorff_directed_squared_ragged(m_Points, i, m_Points, j));
+  double dji = std::sqrt(hausdorff_directed_squared_ragged(m_Points, j, m_Points, i));
+
+  // Rounded outward, so that the rounding of the sums and differences cannot
+  // leave the distance out of the interval.
+  HausdorffInterval out;
+  out.lower = std::nextafter(std::max(0.0, std::max(dij - m_Radii[j], dji - m_Radii[i])), 0.0);
+  out.upper = std::nextafter(std::max(dij + m_Radii[i], dji + m_Radii[j]),
+                             std::numeric_limits<double>::infinity());
+  return out;
+}
+
+struct PairToRefine
+{
+  std::size_t i;
+  std::size_t j;
+  std::size_t k;
+  double cost;
+
+  bool operator<(const PairToRefine &other) const { return cost > other.cost; }
+};
+
+// Bounds of the pairs of the cost-ordered tasks it is given.
+struct IntervalComputer : public RcppParallel::Worker
+{
+  const CurveCoresets &m_Coresets;
+  const CostOrderedPairs &m_Tasks;
+  RcppParallel::RVector<double> m_Lower;
+  RcppParallel::RVector<double> m_Upper;
+
+  IntervalComputer(const CurveCoresets &coresets,
+                   const CostOrderedPairs &tasks,
+                   Rcpp::NumericVector lower,
+                   Rcpp::NumericVector upper)
+    : m_Coresets(coresets), m_Tasks(tasks), m_Lower(lower), m_Upper(upper) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t t = begin;t < end;++t)
+    {
+      m_Tasks.forEachPair(t, [this] (std::size_t i, std::size_t j, std::size_t k) {
+        HausdorffInterval interval = m_Coresets.bounds(i, j);
+        m_Lower[k] = interval.lower;
+        m_Upper[k] = interval.upper;
+      });
+    }
+  }
+};
+
+// Exact distances of the pairs whose interval is too wide.
+struct PairRefiner : public RcppParallel::Worker
+{
+  const RaggedCurvePlanes &m_Curves;
+  const std::vector<PairToRefine> &m_Pairs;
+  RcppParallel::RVector<double> m_Lower;
+  RcppParallel::RVector<double> m_Upper;
+
+  PairRefiner(const RaggedCurvePlanes &curves,
+              const std::vector<PairToRefine> &pairs,
+              Rcpp::NumericVector lower,
+              Rcpp::NumericVector upper)
+    : m_Curves(curves), m_Pairs(pairs), m_Lower(lower), m_Upper(upper) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t r = begin;r < end;++r)
+    {
+      const PairToRefine &pair = m_Pairs[r];
+      double dist = std::sqrt(hausdorff_squared_ragged(m_Curves, pair.i, m_Curves, pair.j));
+      m_Lower[pair.k] = dist;
+      m_Upper[pair.k] = dist;
+    }
+  }
+};
+
+static void setDistAttributes(Rcpp::NumericVector out, std::size_t N)
+{
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+}
+
+// Bounds the distances between all curves from their coresets, then computes
+// exactly the pairs whose interval is wider than `tolerance`, most expensive
+// first. The number of refined pairs is returned in `numRefined`.
+static void hausdorffIntervals(const RaggedCurvePlanes &curves,
+                               double eps,
+                               double tolerance,
+                               unsigned int ncores,
+                               Rcpp::NumericVector lower,
+                               Rcpp::NumericVector upper,
+                               std::size_t &numRefined)
+{
+  if (!(eps >= 0.0))
+    Rcpp::stop("`eps` must be a non-negative number.");
+
+  std::size_t N = curves.size();
+  CurveCoresets coresets = buildCurveCoresets(curves, eps, ncores);
+
+  CostOrderedPairs tasks = raggedPairTasks(coresets.points(), ncores);
+  IntervalComputer intervalComputer(coresets, tasks, lower, upper);
+  RcppParallel::parallelFor(0, tasks.size(), intervalComputer, 1, ncores);
+
+  std::vector<PairToRefine> pairs;
+  for (std::size_t i = 0;i < N;++i)
+  {
+    for (std::size_t j = i + 1;j < N;++j)
+    {
+      std::size_t k = pairIndex(i, j, N);
+      if (upper[k] - lower[k] > tolerance)
+      {
+        double cost = static_cast<double>(curves.numPoints(i)) * curves.numPoints(j);
+        PairToRefine pair = {i, j, k, cost};
+        pairs.push_back(pair);
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  PairRefiner pairRefiner(curves, pairs, lower, upper);
+  RcppParallel::parallelFor(0, pairs.size(), pairRefiner, 1, ncores);
+  numRefined = pairs.size();
+}
+
+// Approximate Hausdorff distance between two curves stored as in
+// `hausdorff_distance_cpp()`, possibly with different numbers of points: the
+// `lower` and `upper` bounds obtained from greedy eps-nets of both curves,
+// replaced by the exact distance if they are more than `tolerance` apart.
+// [[Rcpp::export]]
+Rcpp::NumericVector hausdorff_distance_approx(Rcpp::NumericVector x,
+                                              Rcpp::NumericVector y,
+                                              double eps,
+                                              double tolerance,
+                                              unsigned int dimension = 1)
+{
+  std::vector<std::size_t> sizes(2);
+  sizes[0] = x.size() / dimension;
+  sizes[1] = y.size() / dimension;
+  RaggedCurvePlanes curves(sizes, dimension);
+
+  for (unsigned int k = 0;k < dimension;++k)
+  {
+    std::copy(x.begin() + k * sizes[0], x.begin() + (k + 1) * sizes[0],
+              curves.curve(0) + k * curves.stride(0));
+    std::copy(y.begin() + k * sizes[1], y.begin() + (k + 1) * sizes[1],
+              curves.curve(1) + k * curves.stride(1));
+  }
+  curves.pad(0);
+  curves.pad(1);
+
+  Rcpp::NumericVector lower(1);
+  Rcpp::NumericVector upper(1);
+  std::size_t numRefined = 0;
+  hausdorffIntervals(curves, eps, tolerance, 1, lower, upper, numRefined);
+
+  return Rcpp::NumericVector::create(
+    Rcpp::Named("lower") = lower[0],
+    Rcpp::Named("upper") = upper[0]
+  );
+}
+
+// Approximate distance matrix of the curves of `x` (a list of D x P_i curves,
+// or curves packed by `pack_ragged_curves()`): `lower` and `upper` are `dist`
+// objects of bounds on the Hausdorff distances obtained from greedy eps-nets
+// of the curves, built once per curve. Pairs whose bounds are more than
+// `tolerance` apart are computed exactly, and their number is returned in
+// `refined`.
+// [[Rcpp::export]]
+Rcpp::List hausdorff_dist_approx(SEXP x,
+                                 double eps,
+                                 double tolerance,
+                                 unsigned int dimension = 1,
+                                 unsigned int ncores = 1)
+{
+  Rcpp::XPtr<RaggedCurvePlanes> curves = asRaggedCurves(x, dimension, ncores);
+  std::size_t N = curves->size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector lower(K);
+  Rcpp::NumericVector upper(K);
+  std::size_t numRefined = 0;
+
+  hausdorffIntervals(*curves, eps, tolerance, ncores, lower, upper, numRefined);
+
+  setDistAttributes(lower, N);
+  setDistAttributes(upper, N);
+  return Rcpp::List::create(
+    Rcpp::Named("lower") = lower,
+    Rcpp::Named("upper") = upper,
+    Rcpp::Named("refined") = numRefined
+  );
+}
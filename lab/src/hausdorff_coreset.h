@@ -0,0 +1,45 @@
+#pragma once
+#include "hausdorff_utils.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+struct HausdorffInterval
+{
+  double lower;
+  double upper;
+};
+
+// Coresets of a sample of curves: a subset C_i of the points of each curve X_i
+// such that every point of X_i lies within the covering radius r_i of a point
+// of C_i. For the directed Hausdorff distances h,
+//
+//   h(C_i, C_j) - r_j <= h(X_i, X_j) <= h(C_i, C_j) + r_i
+//
+// so that the Hausdorff distance between two curves is bounded from their
+// coresets alone, which are much smaller than the curves.
+class CurveCoresets
+{
+public:
+  CurveCoresets(RaggedCurvePlanes points, std::vector<double> radii)
+    : m_Points(std::move(points)), m_Radii(std::move(radii)) {}
+
+  std::size_t size() const { return m_Points.size(); }
+  const RaggedCurvePlanes &points() const { return m_Points; }
+  double radius(std::size_t i) const { return m_Radii[i]; }
+
+  // Interval containing the Hausdorff distance between curves i and j.
+  HausdorffInterval bounds(std::size_t i, std::size_t j) const;
+
+private:
+  RaggedCurvePlanes m_Points;
+  std::vector<double> m_Radii;
+};
+
+// Greedy eps-nets of the curves: the points of each curve are picked by
+// farthest-point traversal until all of them lie within `eps` of a picked
+// point. The coresets are built in parallel, once per curve.
+CurveCoresets buildCurveCoresets(const RaggedCurvePlanes &curves,
+                                 double eps,
+                                 unsigned int ncores = 1);
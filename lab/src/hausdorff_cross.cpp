@@ -0,0 +1,86 @@
+#include "hausdorff_utils.h"
+
+// Side of the square tiles of the query x reference rectangle handed out to
+// the workers. The curves of a tile fit together in L2 cache for the curve
+// sizes of the lab, and each tile writes contiguous column segments.
+const std::size_t CROSS_TILE_SIZE = 16;
+
+struct CrossDistanceComputer : public RcppParallel::Worker
+{
+  const HausdorffSample &m_Queries;
+  const HausdorffSample &m_Reference;
+  RcppParallel::RMatrix<double> m_SafeOutput;
+  std::size_t m_NumTileRows;
+
+  CrossDistanceComputer(const HausdorffSample &queries,
+                        const HausdorffSample &reference,
+                        Rcpp::NumericMatrix out)
+    : m_Queries(queries), m_Reference(reference), m_SafeOutput(out),
+      m_NumTileRows((queries.size() + CROSS_TILE_SIZE - 1) / CROSS_TILE_SIZE) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t t = begin;t < end;++t)
+    {
+      std::size_t rowStart = (t % m_NumTileRows) * CROSS_TILE_SIZE;
+      std::size_t rowEnd = std::min(rowStart + CROSS_TILE_SIZE, m_Queries.size());
+      std::size_t colStart = (t / m_NumTileRows) * CROSS_TILE_SIZE;
+      std::size_t colEnd = std::min(colStart + CROSS_TILE_SIZE, m_Reference.size());
+
+      for (std::size_t j = colStart;j < colEnd;++j)
+      {
+        for (std::size_t i = rowStart;i < rowEnd;++i)
+          m_SafeOutput(i, j) = m_Queries.distance(i, m_Reference, j);
+      }
+    }
+  }
+};
+
+Rcpp::NumericMatrix hausdorff_cross(const HausdorffSample &x,
+                                    const HausdorffSample &y,
+                                    unsigned int ncores = 1)
+{
+  if (!x.isCompatible(y))
+    Rcpp::stop("Query and reference curves must have the same dimension, the same number of points and be packed with the same algorithm and precision.");
+
+  std::size_t nx = x.size();
+  std::size_t ny = y.size();
+  Rcpp::NumericMatrix out(nx, ny);
+  if (nx == 0 || ny == 0)
+    return out;
+
+  std::size_t numTiles = ((nx + CROSS_TILE_SIZE - 1) / CROSS_TILE_SIZE) *
+    ((ny + CROSS_TILE_SIZE - 1) / CROSS_TILE_SIZE);
+  CrossDistanceComputer crossDistance(x, y, out);
+  RcppParallel::parallelFor(0, numTiles, crossDistance, 1, ncores);
+
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix hausdorff_cross(Rcpp::List x,
+                                    Rcpp::List y,
+                                    unsigned int dimension = 1,
+                                    unsigned int ncores = 1,
+                                    std::string algorithm = "naive",
+                                    std::string precision = "double")
+{
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffPrecision hausdorffPrecision = parseHausdorffPrecision(precision, hausdorffAlgorithm);
+  HausdorffSample xSample = prepareSample(x, dimension, hausdorffAlgorithm, hausdorffPrecision, ncores);
+  HausdorffSample ySample = prepareSample(y, dimension, hausdorffAlgorithm, hausdorffPrecision, ncores);
+  return hausdorff_cross(xSample, ySample, ncores);
+}
+
+// Streaming variant: `reference` has been packed once by `pack_curves()` and
+// each call scores a new batch of query curves against it.
+// [[Rcpp::export]]
+Rcpp::NumericMatrix hausdorff_cross_packed(Rcpp::List x,
+                                           SEXP reference,
+                                           unsigned int ncores = 1)
+{
+  Rcpp::XPtr<HausdorffSample> ySample = asPackedCurves(reference);
+  HausdorffSample xSample = prepareSample(x, ySample->curves().dimension(), ySample->algorithm(),
+                                          ySample->precision(), ncores);
+  return hausdorff_cross(xSample, *ySample, ncores);
+}
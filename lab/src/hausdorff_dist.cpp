@@ -0,0 +1,325 @@
+#include "hausdorff_backends.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+enum DistBackend
+{
+  DIST_SERIAL,
+  DIST_OMP,
+  DIST_PARALLEL,
+  DIST_THREAD
+};
+
+static const char *DIST_BACKEND_NAMES[] = {"serial", "omp", "parallel", "thread"};
+
+struct DistConfig
+{
+  DistBackend backend;
+  unsigned int ncores;
+  std::size_t tileSize;
+};
+
+// Below this number of squared point distances (a few milliseconds of work),
+// starting threads costs more than it saves and the serial path is used
+// without calibration.
+static const double SERIAL_MAX_OPERATIONS = 2e7;
+
+// Number of curves of the first subsample timed by the calibration run. It
+// is doubled until the serial run on the subsample takes at least
+// `CALIBRATION_MIN_SECONDS`, so that cheap pairs are timed on enough work.
+static const std::size_t CALIBRATION_CURVES = 24;
+static const double CALIBRATION_MIN_SECONDS = 5e-3;
+
+// Least amount of work worth handing to one more thread.
+static const double MIN_SECONDS_PER_THREAD = 1e-3;
+
+// Tiles are shrunk until each thread gets at least this many of them, so that
+// the dynamic schedules can balance the load.
+static const std::size_t TILES_PER_THREAD = 8;
+
+static DistBackend parseDistBackend(std::string backend)
+{
+  for (int b = DIST_SERIAL;b <= DIST_THREAD;++b)
+  {
+    if (backend == DIST_BACKEND_NAMES[b])
+      return static_cast<DistBackend>(b);
+  }
+  Rcpp::stop("Unknown backend '%s'. Use 'auto', 'serial', 'omp', 'parallel' or 'thread'.", backend);
+}
+
+static std::size_t distTileSize(std::size_t numCurves,
+                                unsigned int ncores,
+                                std::size_t curveBytes)
+{
+  std::size_t tileSize = defaultTileSize(curveBytes);
+  while (tileSize > 1)
+  {
+    std::size_t numTileRows = (numCurves + tileSize - 1) / tileSize;
+    if (numTileRows * (numTileRows + 1) / 2 >= TILES_PER_THREAD * ncores)
+      break;
+    tileSize /= 2;
+  }
+  return tileSize;
+}
+
+Rcpp::NumericVector dist_serial(HausdorffSample &xSample, std::size_t tileSize = 0)
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  for (std::size_t i = 0;i < N;++i)
+    xSample.prepare(i);
+
+  PairTiling tiling(N, tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  for (std::size_t t = 0;t < tiling.size();++t)
+  {
+    tiling.forEachPair(t, [&xSample, &outSafe] (std::size_t i, std::size_t j, std::size_t k) {
+      outSafe[k] = xSample.distance(i, j);
+    });
+  }
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+static Rcpp::NumericVector runDist(HausdorffSample &xSample, const DistConfig &config)
+{
+  switch (config.backend)
+  {
+  case DIST_OMP:
+    return dist_omp(xSample, config.ncores, config.tileSize);
+  case DIST_PARALLEL:
+    return dist_parallel(xSample, config.ncores, config.tileSize);
+  case DIST_THREAD:
+    return dist_thread(xSample, config.ncores, config.tileSize);
+  default:
+    return dist_serial(xSample, config.tileSize);
+  }
+}
+
+// Best of two runs, in seconds.
+static double timeDist(HausdorffSample &xSample, const DistConfig &config)
+{
+  double best = std::numeric_limits<double>::infinity();
+  for (int run = 0;run < 2;++run)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    runDist(xSample, config);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Prepared copy of the first `numCurves` curves of `xSample`.
+static std::unique_ptr<HausdorffSample> calibrationSample(const HausdorffSample &xSample, std::size_t numCurves)
+{
+  const CurvePlanes &curves = xSample.curves();
+  CurvePlanes subsample(numCurves, curves.dimension(), curves.numPoints());
+  for (std::size_t i = 0;i < numCurves;++i)
+    std::memcpy(subsample.curve(i), curves.curve(i), xSample.curveBytes());
+
+  std::unique_ptr<HausdorffSample> out(new HausdorffSample(std::move(subsample), xSample.algorithm(),
+                                                           xSample.precision()));
+  for (std::size_t i = 0;i < numCurves;++i)
+    out->prepare(i);
+  return out;
+}
+
+// Time of a run of `config` on `numPairs` pairs, extrapolated from its runs on
+// `sample` and on `pairSample`, which holds a single pair: the time of the
+// latter is the fixed cost of a run (waking or starting the threads), which
+// does not grow with the number of pairs.
+static double estimateDist(HausdorffSample &sample,
+                           HausdorffSample &pairSample,
+                           const DistConfig &config,
+                           double numPairs)
+{
+  double fixedSeconds = timeDist(pairSample, config);
+  double seconds = timeDist(sample, config);
+  double numSamplePairs = sample.size() * (sample.size() - 1) / 2.0;
+  return fixedSeconds + std::max(0.0, seconds - fixedSeconds) * numPairs / numSamplePairs;
+}
+
+// Picks the backend and number of threads from timings on the first curves of
+// `xSample`: the serial run estimates the total amount of work, which caps the
+// number of threads, and the backends are then compared with that many
+// threads.
+static DistConfig calibrateDist(const HausdorffSample &xSample, unsigned int maxThreads)
+{
+  DistConfig best = {DIST_SERIAL, 1, 0};
+  std::size_t numCurves = std::min(xSample.size(), CALIBRATION_CURVES);
+  std::unique_ptr<HausdorffSample> sample = calibrationSample(xSample, numCurves);
+  while (numCurves < xSample.size() && timeDist(*sample, best) < CALIBRATION_MIN_SECONDS)
+  {
+    numCurves = std::min(xSample.size(), 2 * numCurves);
+    sample = calibrationSample(xSample, numCurves);
+  }
+  std::unique_ptr<HausdorffSample> pairSample = calibrationSample(xSample, 2);
+
+  double N = xSample.size();
+  double numPairs = N * (N - 1) / 2;
+  double bestSeconds = estimateDist(*sample, *pairSample, best, numPairs);
+
+  double threads = std::floor(bestSeconds / MIN_SECONDS_PER_THREAD);
+  unsigned int ncores = static_cast<unsigned int>(std::max(1.0, std::min<double>(threads, maxThreads)));
+  if (ncores == 1)
+    return best;
+
+  for (int b = DIST_OMP;b <= DIST_THREAD;++b)
+  {
+    DistConfig config = {static_cast<DistBackend>(b), ncores, distTileSize(numCurves, ncores, xSample.curveBytes())};
+    double seconds = estimateDist(*sample, *pairSample, config, numPairs);
+    if (seconds < bestSeconds)
+    {
+      best = config;
+      bestSeconds = seconds;
+    }
+  }
+
+  return best;
+}
+
+// Tuning decisions are shared by the samples with the same algorithm,
+// precision and dimension, with numbers of points and curves in the same
+// power of two and the same thread budget.
+static std::string tuningKey(const HausdorffSample &xSample, unsigned int maxThreads)
+{
+  std::ostringstream key;
+  key << "a" << xSample.algorithm()
+      << "p" << xSample.precision()
+      << "d" << xSample.curves().dimension()
+      << "P" << std::ilogb(static_cast<double>(xSample.curves().numPoints()))
+      << "N" << std::ilogb(static_cast<double>(xSample.size()))
+      << "t" << maxThreads;
+  return key.str();
+}
+
+static std::string defaultTuningCache()
+{
+  const char *path = std::getenv("HAUSDORFF_TUNING_CACHE");
+  if (path != nullptr)
+    return path;
+  const char *home = std::getenv("HOME");
+  return std::string(home != nullptr ? home : ".") + "/.hausdorff_tuning";
+}
+
+// The cache is a text file with one `key backend ncores` line per decision,
+// the last line of a key taking precedence. A missing or unreadable file is
+// an empty cache.
+static bool readTuningCache(const std::string &path,
+                            const std::string &key,
+                            DistConfig &config)
+{
+  std::ifstream cache(path.c_str());
+  std::string line;
+  bool found = false;
+
+  while (std::getline(cache, line))
+  {
+    std::istringstream fields(line);
+    std::string lineKey, backend;
+    unsigned int ncores = 0;
+    if (!(fields >> lineKey >> backend >> ncores) || lineKey != key || ncores == 0)
+      continue;
+
+    for (int b = DIST_SERIAL;b <= DIST_THREAD;++b)
+    {
+      if (backend == DIST_BACKEND_NAMES[b])
+      {
+        config.backend = static_cast<DistBackend>(b);
+        config.ncores = ncores;
+        found = true;
+      }
+    }
+  }
+
+  return found;
+}
+
+// Failing to write the cache only means calibrating again next time.
+static void writeTuningCache(const std::string &path,
+                             const std::string &key,
+                             const DistConfig &config)
+{
+  std::ofstream cache(path.c_str(), std::ios::app);
+  cache << key << " " << DIST_BACKEND_NAMES[config.backend] << " " << config.ncores << "\n";
+}
+
+// Hausdorff distance matrix computed with the backend, number of threads and
+// tile size picked for the input: tiny inputs are computed serially, others
+// with the configuration found by a short calibration run on the first curves
+// and cached per machine in the file `cache` (by default the
+// `HAUSDORFF_TUNING_CACHE` environment variable or `~/.hausdorff_tuning`).
+// `ncores` caps the number of threads (0 for all cores) and `backend` can
+// force one of "serial", "omp", "parallel" or "thread". The configuration
+// used is returned in the "config" attribute.
+// [[Rcpp::export]]
+Rcpp::NumericVector hausdorff_dist(SEXP x,
+                                   unsigned int dimension = 1,
+                                   std::string backend = "auto",
+                                   unsigned int ncores = 0,
+                                   std::string algorithm = "naive",
+                                   std::string precision = "double",
+                                   std::string cache = "")
+{
+  unsigned int maxThreads = ncores > 0 ? ncores : std::max(1u, std::thread::hardware_concurrency());
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, maxThreads);
+
+  double N = xSample->size();
+  double numPoints = xSample->curves().numPoints();
+  double numOperations = N * (N - 1) / 2 * numPoints * numPoints * xSample->curves().dimension();
+
+  DistConfig config = {DIST_SERIAL, 1, 0};
+  std::string source;
+
+  if (backend != "auto")
+  {
+    config.backend = parseDistBackend(backend);
+    config.ncores = config.backend == DIST_SERIAL ? 1 : maxThreads;
+    source = "user";
+  }
+  else if (numOperations < SERIAL_MAX_OPERATIONS || maxThreads == 1)
+  {
+    source = "serial";
+  }
+  else
+  {
+    std::string cachePath = cache.empty() ? defaultTuningCache() : cache;
+    std::string key = tuningKey(*xSample, maxThreads);
+    source = "cache";
+    if (!readTuningCache(cachePath, key, config))
+    {
+      config = calibrateDist(*xSample, maxThreads);
+      writeTuningCache(cachePath, key, config);
+      source = "calibration";
+    }
+  }
+
+  config.tileSize = distTileSize(xSample->size(), config.ncores, xSample->curveBytes());
+  Rcpp::NumericVector out = runDist(*xSample, config);
+  out.attr("config") = Rcpp::List::create(
+    Rcpp::Named("backend") = DIST_BACKEND_NAMES[config.backend],
+    Rcpp::Named("ncores") = config.ncores,
+    Rcpp::Named("tile_size") = config.tileSize,
+    Rcpp::Named("source") = source
+  );
+  return out;
+}
@@ -0,0 +1,231 @@
+#include "hausdorff_kdtree.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// Maximum number of points stored in a leaf. Leaves are scanned linearly,
+// which is faster than descending further for a handful of points.
+static const std::size_t KDTREE_LEAF_SIZE = 8;
+
+// Nodes are split at the median, so the depth of the tree never exceeds the
+// number of bits of `std::size_t` and a depth-first search never defers more
+// than one node per level.
+static const int KDTREE_MAX_STACK = 64;
+
+void CurveKdTree::build(const double *curve,
+                        unsigned int dimension,
+                        std::size_t numPoints,
+                        std::size_t stride)
+{
+  m_Dimension = dimension;
+  m_Nodes.clear();
+  m_Boxes.clear();
+  m_Points.assign(numPoints * dimension, 0.0);
+
+  if (numPoints == 0)
+    return;
+
+  std::vector<std::size_t> order(numPoints);
+  std::iota(order.begin(), order.end(), 0);
+  buildNode(order, curve, stride, 0, numPoints);
+
+  for (std::size_t p = 0;p < numPoints;++p)
+  {
+    for (unsigned int k = 0;k < dimension;++k)
+      m_Points[p * dimension + k] = curve[k * stride + order[p]];
+  }
+}
+
+int CurveKdTree::buildNode(std::vector<std::size_t> &order,
+                           const double *curve,
+                           std::size_t stride,
+                           std::size_t begin,
+                           std::size_t end)
+{
+  int id = m_Nodes.size();
+  m_Nodes.push_back({begin, end, -1, -1});
+
+  std::size_t offset = m_Boxes.size();
+  m_Boxes.resize(offset + 2 * m_Dimension);
+  unsigned int splitDimension = 0;
+  double maxExtent = -1.0;
+
+  for (unsigned int k = 0;k < m_Dimension;++k)
+  {
+    double lower = std::numeric_limits<double>::infinity();
+    double upper = -std::numeric_limits<double>::infinity();
+
+    for (std::size_t p = begin;p < end;++p)
+    {
+      double value = curve[k * stride + order[p]];
+      lower = std::min(lower, value);
+      upper = std::max(upper, value);
+    }
+
+    m_Boxes[offset + k] = lower;
+    m_Boxes[offset + m_Dimension + k] = upper;
+
+    if (upper - lower > maxExtent)
+    {
+      maxExtent = upper - lower;
+      splitDimension = k;
+    }
+  }
+
+  if (end - begin <= KDTREE_LEAF_SIZE)
+    return id;
+
+  const double *plane = curve + splitDimension * stride;
+  std::size_t mid = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                   [plane] (std::size_t a, std::size_t b) { return plane[a] < plane[b]; });
+
+  int left = buildNode(order, curve, stride, begin, mid);
+  int right = buildNode(order, curve, stride, mid, end);
+  m_Nodes[id].left = left;
+  m_Nodes[id].right = right;
+  return id;
+}
+
+// The gap to the box is computed with the same operations as the distance to
+// any point inside it, so by monotonicity of rounding it never exceeds the
+// computed distance to those points and pruning on it is exact.
+double CurveKdTree::boxDistance(int node, const double *query) const
+{
+  const double *lower = &m_Boxes[node * 2 * m_Dimension];
+  const double *upper = lower + m_Dimension;
+  double dist = 0.0;
+
+  for (unsigned int k = 0;k < m_Dimension;++k)
+  {
+    double diff = 0.0;
+    if (query[k] < lower[k])
+      diff = query[k] - lower[k];
+    else if (query[k] > upper[k])
+      diff = query[k] - upper[k];
+    dist += diff * diff;
+  }
+
+  return dist;
+}
+
+double CurveKdTree::nearest(const double *query, double bound, std::size_t &visited) const
+{
+  double best = std::numeric_limits<double>::infinity();
+  if (m_Nodes.empty())
+    return best;
+
+  // Each stack entry keeps the distance to the box of its node, computed when
+  // the node was pushed, so that it can be discarded without recomputation
+  // once a closer point has been found.
+  int stackNodes[KDTREE_MAX_STACK];
+  double stackDistances[KDTREE_MAX_STACK];
+  int top = 0;
+  stackNodes[top] = 0;
+  stackDistances[top++] = boxDistance(0, query);
+
+  while (top > 0)
+  {
+    --top;
+    if (stackDistances[top] >= best)
+      continue;
+
+    int id = stackNodes[top];
+
+    // Descend towards the nearer child, deferring the farther one.
+    while (m_Nodes[id].left >= 0)
+    {
+      const Node &node = m_Nodes[id];
+      double leftDistance = boxDistance(node.left, query);
+      double rightDistance = boxDistance(node.right, query);
+      int farChild = node.right;
+      double farDistance = rightDistance;
+      id = node.left;
+
+      if (rightDistance < leftDistance)
+      {
+        farChild = node.left;
+        farDistance = leftDistance;
+        id = node.right;
+      }
+
+      if (farDistance < best)
+      {
+        stackNodes[top] = farChild;
+        stackDistances[top++] = farDistance;
+      }
+    }
+
+    const Node &leaf = m_Nodes[id];
+    for (std::size_t p = leaf.begin;p < leaf.end;++p)
+    {
+      const double *point = &m_Points[p * m_Dimension];
+      ++visited;
+      double dist = 0.0;
+
+      for (unsigned int k = 0;k < m_Dimension;++k)
+      {
+        double diff = query[k] - point[k];
+        dist += diff * diff;
+      }
+
+      if (dist < best)
+      {
+        best = dist;
+        if (best <= bound)
+          return best;
+      }
+    }
+  }
+
+  return best;
+}
+
+double directed_hausdorff_kdtree(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride,
+                                 const CurveKdTree &tree,
+                                 double cmax,
+                                 double limit,
+                                 std::size_t *visited)
+{
+  std::vector<double> query(dimension);
+  std::size_t numProbes = std::min(numPoints, KDTREE_LEAF_SIZE);
+  std::size_t numVisited = 0;
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    for (unsigned int k = 0;k < dimension;++k)
+      query[k] = x[k * stride + i];
+
+    // Once the running maximum is large, a close enough point is usually
+    // among the first few (shuffled) points of `y`, which is cheaper to check
+    // than descending the tree.
+    bool found = false;
+    for (std::size_t j = 0;j < numProbes && !found;++j)
+    {
+      double dist = 0.0;
+      ++numVisited;
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        double diff = query[k] - y[k * stride + j];
+        dist += diff * diff;
+      }
+
+      found = dist <= cmax;
+    }
+
+    if (!found)
+      cmax = std::max(cmax, tree.nearest(query.data(), cmax, numVisited));
+    if (cmax > limit)
+      break;
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return cmax;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Compact k-d tree over the points of a single curve.
+//
+// Points are copied in tree order and stored point by point so that each leaf
+// is a contiguous block of memory. Every node keeps the bounding box of its
+// points, which is used to prune whole subtrees during nearest neighbour
+// queries.
+class CurveKdTree
+{
+public:
+  // Builds the tree from a curve stored as coordinate planes of `stride`
+  // doubles (see `CurvePlanes`).
+  void build(const double *curve,
+             unsigned int dimension,
+             std::size_t numPoints,
+             std::size_t stride);
+
+  // Squared distance from `query` (an array of `dimension` coordinates) to its
+  // nearest point in the tree. The search stops as soon as a point no farther
+  // than `bound` is found, in which case the returned value is not larger
+  // than `bound` but not necessarily the minimum. The number of points of the
+  // tree whose distance to `query` was computed is added to `visited`.
+  double nearest(const double *query, double bound, std::size_t &visited) const;
+
+  std::size_t size() const { return m_Points.size() / (m_Dimension > 0 ? m_Dimension : 1); }
+
+private:
+  struct Node
+  {
+    std::size_t begin;
+    std::size_t end;
+    int left;
+    int right;
+  };
+
+  int buildNode(std::vector<std::size_t> &order,
+                const double *curve,
+                std::size_t stride,
+                std::size_t begin,
+                std::size_t end);
+
+  double boxDistance(int node, const double *query) const;
+
+  unsigned int m_Dimension = 0;
+  std::vector<Node> m_Nodes;
+  std::vector<double> m_Boxes;
+  std::vector<double> m_Points;
+};
+
+// Directed Hausdorff pass querying every point of `x` against the tree built
+// on the points of `y`, with early break on the running maximum `cmax`. Both
+// curves are stored as coordinate planes of `stride` doubles. The pass is
+// abandoned once the running maximum exceeds `limit`. Returns the updated
+// running maximum (squared), and adds the number of distances between points
+// computed to `visited` if it is not null.
+double directed_hausdorff_kdtree(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride,
+                                 const CurveKdTree &tree,
+                                 double cmax,
+                                 double limit = std::numeric_limits<double>::infinity(),
+                                 std::size_t *visited = nullptr);
@@ -1,25 +1,289 @@
+#include "curve_metrics.h"
+#include "dist_job.h"
+#include "dist_profile.h"
 #include "hausdorff_utils.h"
 
 // // [[Rcpp::plugins(openmp)]] // Uncomment on Windows and Linux
 
+// Prepares the curves and calls `write(k, distance)` for each pair, where `k`
+// is the position of the pair in the `dist` vector. The pairs are scheduled
+// in tiles of `tileSize` curves, or of `defaultTileSize()` curves if it is 0,
+// and each tile runs through `profiler` (see `dist_profile.h`).
+template <typename Sample, typename Writer, typename Profiler = NoProfiler>
+void dist_omp(Sample &xSample,
+              Writer write,
+              unsigned int ncores,
+              std::size_t tileSize = 0,
+              Profiler profiler = Profiler())
+{
+  std::ptrdiff_t N = xSample.size();
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(ncores)
+#endif
+  for (std::ptrdiff_t i = 0;i < N;++i)
+    xSample.prepare(i);
+
+  PairTiling tiling(N, tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  std::ptrdiff_t numTiles = tiling.size();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(ncores)
+#endif
+  for (std::ptrdiff_t t = 0;t < numTiles;++t)
+  {
+    profiler([&xSample, &write, &tiling, &profiler, t] {
+      std::size_t numPairs = 0;
+      tiling.forEachPair(t, [&xSample, &write, &profiler, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+        write(k, profiler.distance(xSample, i, j));
+        ++numPairs;
+      });
+      return numPairs;
+    });
+  }
+}
+
+// Same as above with the threads pinned as in `placement` (see
+// `numa_placement.h`): the curves are first moved to the NUMA nodes of the
+// threads that read them, then each thread prepares curves of its node and
+// takes the tiles of its node before those of the others. There is one
+// iteration per thread, the scheduling being done by `NodeLocalTiles`.
+template <typename Writer>
+void dist_omp_placed(HausdorffSample &xSample,
+                     Writer write,
+                     const ThreadPlacement &placement,
+                     std::size_t tileSize = 0)
+{
+  xSample.placeCurves(placement);
+  std::ptrdiff_t numThreads = placement.numThreads();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+#endif
+  for (std::ptrdiff_t t = 0;t < numThreads;++t)
+    preparePlacedCurves(xSample, placement, t);
+
+  PairTiling tiling(xSample.size(), tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  NodeLocalTiles tiles(tiling, xSample.size(), placement.numNodes());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+#endif
+  for (std::ptrdiff_t t = 0;t < numThreads;++t)
+    computePlacedTiles(xSample, tiling, tiles, placement, t, write);
+}
+
+// Same as above for a `DistJob` (see `dist_job.h`): each tile runs through
+// `job.run()`, which skips the tiles done by a previous run and drops the
+// others once the job is cancelled, and the master thread, which created the
+// job, polls it between its tiles.
+template <typename Sample>
+void dist_omp_job(Sample &xSample, DistJob &job, unsigned int ncores)
+{
+  std::ptrdiff_t N = xSample.size();
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(ncores)
+#endif
+  for (std::ptrdiff_t i = 0;i < N;++i)
+    xSample.prepare(i);
+
+  const PairTiling &tiling = job.tiling();
+  DistFile &outFile = job.file();
+  std::ptrdiff_t numTiles = tiling.size();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(ncores)
+#endif
+  for (std::ptrdiff_t t = 0;t < numTiles;++t)
+  {
+    job.poll();
+    job.run(t, [&xSample, &outFile, &tiling, t] {
+      std::size_t numPairs = 0;
+      tiling.forEachPair(t, [&xSample, &outFile, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+        outFile.set(k, xSample.distance(i, j));
+        ++numPairs;
+      });
+      return numPairs;
+    });
+  }
+}
+
+// `dist` object of the distances between the curves of any sample with the
+// interface of `HausdorffSample`, named `method`.
+template <typename Sample, typename Profiler = NoProfiler>
+Rcpp::NumericVector dist_omp_vector(Sample &xSample,
+                                    unsigned int ncores,
+                                    std::size_t tileSize,
+                                    const char *method,
+                                    Profiler profiler = Profiler())
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_omp(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, ncores, tileSize, profiler);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = method;
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_omp_placed(HausdorffSample &xSample,
+                                    const ThreadPlacement &placement)
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_omp_placed(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, placement);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_omp(HausdorffSample &xSample,
+                             unsigned int ncores = 1,
+                             std::size_t tileSize = 0)
+{
+  return dist_omp_vector(xSample, ncores, tileSize, "hausdorff");
+}
+
 Rcpp::NumericVector dist_omp(Rcpp::NumericMatrix x,
                              unsigned int dimension = 1,
-                             unsigned int ncores = 1)
+                             unsigned int ncores = 1,
+                             std::string algorithm = "naive",
+                             std::string precision = "double")
+{
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffSample xSample(packCurves(x, dimension), hausdorffAlgorithm,
+                          parseHausdorffPrecision(precision, hausdorffAlgorithm));
+  return dist_omp(xSample, ncores);
+}
+
+// With `profile = TRUE`, the "profile" attribute of the result holds the
+// per-thread numbers of tiles, pairs and distances between points, busy time
+// and hardware counters of the pair loop.
+// With `affinity` other than "none" (see `parseThreadPlacement()`), the
+// threads are pinned and the curves and tiles placed on their NUMA nodes.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_omp(SEXP x,
+                             unsigned int dimension = 1,
+                             unsigned int ncores = 1,
+                             std::string algorithm = "naive",
+                             std::string precision = "double",
+                             bool profile = false,
+                             std::string affinity = "none")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  ThreadPlacement placement = parseThreadPlacement(affinity, ncores);
+  if (placement.isPinned())
+  {
+    if (profile)
+      Rcpp::stop("Profiling is not available with pinned threads. Use affinity = 'none'.");
+    return dist_omp_placed(*xSample, placement);
+  }
+
+  if (!profile)
+    return dist_omp(*xSample, ncores);
+
+  DistProfile distProfile;
+  DistProfiler profiler = {&distProfile};
+  Rcpp::NumericVector out = dist_omp_vector(*xSample, ncores, 0, "hausdorff", profiler);
+  out.attr("profile") = distProfile.summary();
+  return out;
+}
+
+// Out-of-core variant: the distances are written to the memory-mapped file
+// `file` as float64 or float32 and a handle to it is returned.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_omp_file(SEXP x,
+                                   std::string file,
+                                   unsigned int dimension = 1,
+                                   unsigned int ncores = 1,
+                                   std::string algorithm = "naive",
+                                   std::string type = "float64",
+                                   std::string precision = "double")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  Rcpp::XPtr<DistFile> out = createDistFile(file, xSample->size(), type);
+  DistFile &outFile = *out;
+
+  dist_omp(*xSample, [&outFile] (std::size_t k, double value) {
+    outFile.set(k, value);
+  }, ncores);
+
+  outFile.flush();
+  return out;
+}
+
+// Resumable variant of `dist_omp_file()` for long computations (see
+// `dist_job.h`): the tiles done are checkpointed in `<file>.ckpt` every
+// `checkpoint` seconds, and a later call with the same curves and arguments
+// only computes the remaining ones. The computation stops cleanly on a user
+// interrupt or after `time_limit` seconds (never if 0), and prints its
+// progress if `display_progress` is true.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_omp_job(SEXP x,
+                                  std::string file,
+                                  unsigned int dimension = 1,
+                                  unsigned int ncores = 1,
+                                  std::string algorithm = "naive",
+                                  std::string type = "float64",
+                                  std::string precision = "double",
+                                  double checkpoint = 60,
+                                  double time_limit = 0,
+                                  bool display_progress = false)
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  PairTiling tiling(xSample->size(), defaultTileSize(xSample->curveBytes()));
+
+  DistJobOptions options;
+  options.checkpointSeconds = checkpoint;
+  options.timeLimit = time_limit;
+  options.displayProgress = display_progress;
+  DistJob job(file, tiling, xSample->size(), parseDistValueType(type), sampleFingerprint(*xSample), options);
+
+  dist_omp_job(*xSample, job, ncores);
+  job.finish();
+  return dist_file_open(file);
+}
+
+// Curves with different numbers of points: the pairs are split into tasks of
+// similar cost, which the dynamic schedule hands out most expensive first.
+Rcpp::NumericVector dist_omp_ragged(const RaggedCurvePlanes &curves, unsigned int ncores = 1)
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  std::size_t N = curves.size();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
-  RcppParallel::RMatrix<double> xSafe(x);
   RcppParallel::RVector<double> outSafe(out);
 
+  CostOrderedPairs tasks = raggedPairTasks(curves, ncores);
+  std::ptrdiff_t numTasks = tasks.size();
+
 #ifdef _OPENMP
-#pragma omp parallel for num_threads(ncores)
+#pragma omp parallel for schedule(dynamic, 1) num_threads(ncores)
 #endif
-  for (unsigned int k = 0;k < K;++k)
+  for (std::ptrdiff_t t = 0;t < numTasks;++t)
   {
-    unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-    unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-    outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+    tasks.forEachPair(t, [&curves, &outSafe] (std::size_t i, std::size_t j, std::size_t k) {
+      outSafe[k] = std::sqrt(hausdorff_squared_ragged(curves, i, curves, j));
+    });
   }
 
   out.attr("Size") = N;
@@ -31,11 +295,40 @@ Rcpp::NumericVector dist_omp(Rcpp::NumericMatrix x,
   return out;
 }
 
+// `x` is a list of D x P_i curves with different numbers of points P_i, or
+// curves packed by `pack_ragged_curves()`.
 // [[Rcpp::export]]
-Rcpp::NumericVector dist_omp(Rcpp::List x,
-                             unsigned int dimension = 1,
-                             unsigned int ncores = 1)
+Rcpp::NumericVector dist_omp_ragged(SEXP x,
+                                    unsigned int dimension = 1,
+                                    unsigned int ncores = 1)
+{
+  Rcpp::XPtr<RaggedCurvePlanes> curves = asRaggedCurves(x, dimension, ncores);
+  return dist_omp_ragged(*curves, ncores);
+}
+
+struct OmpMetricDist
+{
+  unsigned int m_NumCores;
+
+  template <typename Sample>
+  Rcpp::NumericVector operator()(Sample &xSample) const
+  {
+    return dist_omp_vector(xSample, m_NumCores, 0, xSample.method());
+  }
+};
+
+// Distance matrix for one of the metrics of `curve_metrics.h` instead of the
+// Hausdorff distance: "frechet" (discrete Fréchet), "dtw" (dynamic time
+// warping within a Sakoe-Chiba band of half-width `window`, unconstrained if
+// negative) or "modified_hausdorff". The pairs are scheduled as in
+// `dist_omp()`.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_omp_metric(Rcpp::List x,
+                                    std::string metric = "frechet",
+                                    unsigned int dimension = 1,
+                                    unsigned int ncores = 1,
+                                    int window = -1)
 {
-  Rcpp::NumericMatrix xMatrix = listToMatrix(x);
-  return dist_omp(xMatrix, dimension, ncores);
+  OmpMetricDist backend = {ncores};
+  return distWithMetric(packCurves(x, dimension, ncores), parseCurveMetric(metric), window, backend);
 }
@@ -1,38 +1,379 @@
+#include "curve_metrics.h"
+#include "dist_job.h"
+#include "dist_profile.h"
 #include "hausdorff_utils.h"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include <memory>
+
+// Calls `write(k, distance)` for each pair of the tiles it is given, where `k`
+// is the position of the pair in the `dist` vector.
+template <typename Sample, typename Writer, typename Profiler = NoProfiler>
 struct HausdorffDistanceComputer : public RcppParallel::Worker
 {
-  const RcppParallel::RMatrix<double> m_SafeInput;
-  RcppParallel::RVector<double> m_SafeOutput;
-  unsigned int m_Dimension;
+  const Sample &m_Input;
+  const PairTiling &m_Tiling;
+  Writer m_Write;
+  Profiler m_Profiler;
 
-  HausdorffDistanceComputer(const Rcpp::NumericMatrix x,
-                            Rcpp::NumericVector out,
-                            unsigned int dimension)
-    : m_SafeInput(x), m_SafeOutput(out), m_Dimension(dimension) {}
+  HausdorffDistanceComputer(const Sample &x,
+                            const PairTiling &tiling,
+                            Writer write,
+                            Profiler profiler = Profiler())
+    : m_Input(x), m_Tiling(tiling), m_Write(write), m_Profiler(profiler) {}
 
   void operator()(std::size_t begin, std::size_t end)
   {
-    unsigned int N = m_SafeInput.nrow();
-    for (std::size_t k = begin;k < end;++k)
+    for (std::size_t t = begin;t < end;++t)
     {
-      unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-      unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-      m_SafeOutput[k] = hausdorff_distance_cpp(m_SafeInput.row(i), m_SafeInput.row(j), m_Dimension);
+      m_Profiler([this, t] {
+        std::size_t numPairs = 0;
+        m_Tiling.forEachPair(t, [this, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+          m_Write(k, m_Profiler.distance(m_Input, i, j));
+          ++numPairs;
+        });
+        return numPairs;
+      });
     }
   }
 };
 
+template <typename Sample, typename Writer, typename Profiler = NoProfiler>
+void dist_parallel(Sample &xSample,
+                   Writer write,
+                   unsigned int ncores,
+                   std::size_t tileSize = 0,
+                   Profiler profiler = Profiler())
+{
+  CurvePreprocessor<Sample> curvePreprocessor(xSample);
+  RcppParallel::parallelFor(0, xSample.size(), curvePreprocessor, 1, ncores);
+
+  PairTiling tiling(xSample.size(), tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  HausdorffDistanceComputer<Sample, Writer, Profiler> hausdorffDistance(xSample, tiling, write, profiler);
+  RcppParallel::parallelFor(0, tiling.size(), hausdorffDistance, 1, ncores);
+}
+
+// Pins each thread entering an arena of `placement.numThreads()` slots to the
+// CPU of the thread of `placement` with the index of its slot, until it
+// leaves the arena.
+class PlacedArenaObserver : public tbb::task_scheduler_observer
+{
+public:
+  PlacedArenaObserver(tbb::task_arena &arena, const ThreadPlacement &placement)
+    : tbb::task_scheduler_observer(arena), m_Placement(placement)
+  {
+    observe(true);
+  }
+
+  ~PlacedArenaObserver()
+  {
+    observe(false);
+  }
+
+  void on_scheduler_entry(bool) override
+  {
+    int slot = tbb::this_task_arena::current_thread_index();
+    if (slot >= 0 && static_cast<std::size_t>(slot) < m_Placement.numThreads())
+      affinity().reset(new ScopedThreadAffinity(m_Placement.cpu(slot)));
+  }
+
+  void on_scheduler_exit(bool) override
+  {
+    affinity().reset();
+  }
+
+private:
+  // Affinity of the calling thread, restored when it leaves the arena.
+  static std::unique_ptr<ScopedThreadAffinity> &affinity()
+  {
+    static thread_local std::unique_ptr<ScopedThreadAffinity> threadAffinity;
+    return threadAffinity;
+  }
+
+  const ThreadPlacement &m_Placement;
+};
+
+// See `dist_omp_placed()`. The threads run in an arena with one slot per
+// thread of `placement`, each pinned to the CPU of its slot by
+// `PlacedArenaObserver`, and compute the tiles as the thread of their slot
+// rather than of the task they run: TBB may still give several tasks to the
+// same worker, which then finds the queues drained after the first one.
+template <typename Writer>
+void dist_parallel_placed(HausdorffSample &xSample,
+                          Writer write,
+                          const ThreadPlacement &placement,
+                          std::size_t tileSize = 0)
+{
+  xSample.placeCurves(placement);
+  std::size_t numThreads = placement.numThreads();
+
+  PairTiling tiling(xSample.size(), tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  NodeLocalTiles tiles(tiling, xSample.size(), placement.numNodes());
+
+  tbb::task_arena arena(numThreads, 1);
+  PlacedArenaObserver observer(arena, placement);
+  tbb::blocked_range<std::size_t> threads(0, numThreads, 1);
+
+  // The curves are shared out by thread of `placement`, so every one of them
+  // must run, pinned to its own CPU by `preparePlacedCurves()`.
+  arena.execute([&xSample, &placement, &threads] {
+    tbb::parallel_for(threads, [&xSample, &placement] (const tbb::blocked_range<std::size_t> &range) {
+      for (std::size_t t = range.begin();t < range.end();++t)
+        preparePlacedCurves(xSample, placement, t);
+    }, tbb::simple_partitioner());
+  });
+
+  auto compute = [&xSample, &write, &placement, &tiling, &tiles] (const tbb::blocked_range<std::size_t> &) {
+    std::size_t slot = tbb::this_task_arena::current_thread_index();
+    computePlacedTiles(xSample, tiling, tiles, placement, slot, write);
+  };
+  arena.execute([&compute, &threads] {
+    tbb::parallel_for(threads, compute, tbb::simple_partitioner());
+  });
+}
+
+// Runs the tiles it is given through `job` (see `dist_omp_job()`).
+template <typename Sample>
+struct DistJobComputer : public RcppParallel::Worker
+{
+  const Sample &m_Input;
+  DistJob &m_Job;
+
+  DistJobComputer(const Sample &x, DistJob &job)
+    : m_Input(x), m_Job(job) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    const PairTiling &tiling = m_Job.tiling();
+    DistFile &outFile = m_Job.file();
+
+    for (std::size_t t = begin;t < end;++t)
+    {
+      m_Job.run(t, [this, &tiling, &outFile, t] {
+        std::size_t numPairs = 0;
+        tiling.forEachPair(t, [this, &outFile, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+          outFile.set(k, m_Input.distance(i, j));
+          ++numPairs;
+        });
+        return numPairs;
+      });
+    }
+  }
+};
+
+// Same as `dist_thread_job()`: whether TBB runs tiles on the calling thread
+// depends on the backend (the tinythread one only joins its threads), so the
+// loop runs on a thread of its own and the calling thread polls the job until
+// all the tiles are visited.
+template <typename Sample>
+void dist_parallel_job(Sample &xSample, DistJob &job, unsigned int ncores)
+{
+  CurvePreprocessor<Sample> curvePreprocessor(xSample);
+  RcppParallel::parallelFor(0, xSample.size(), curvePreprocessor, 1, ncores);
+
+  std::size_t numTiles = job.tiling().size();
+  DistJobComputer<Sample> distJob(xSample, job);
+  std::thread loop([&distJob, numTiles, ncores] {
+    RcppParallel::parallelFor(0, numTiles, distJob, 1, ncores);
+  });
+
+  while (job.tilesVisited() < numTiles)
+  {
+    job.poll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  loop.join();
+}
+
+template <typename Sample, typename Profiler = NoProfiler>
+Rcpp::NumericVector dist_parallel_vector(Sample &xSample,
+                                         unsigned int ncores,
+                                         std::size_t tileSize,
+                                         const char *method,
+                                         Profiler profiler = Profiler())
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_parallel(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, ncores, tileSize, profiler);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = method;
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_parallel_placed(HausdorffSample &xSample,
+                                         const ThreadPlacement &placement)
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_parallel_placed(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, placement);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_parallel(HausdorffSample &xSample,
+                                  unsigned int ncores = 1,
+                                  std::size_t tileSize = 0)
+{
+  return dist_parallel_vector(xSample, ncores, tileSize, "hausdorff");
+}
+
 Rcpp::NumericVector dist_parallel(Rcpp::NumericMatrix x,
                                   unsigned int dimension = 1,
-                                  unsigned int ncores = 1)
+                                  unsigned int ncores = 1,
+                                  std::string algorithm = "naive",
+                                  std::string precision = "double")
+{
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffSample xSample(packCurves(x, dimension), hausdorffAlgorithm,
+                          parseHausdorffPrecision(precision, hausdorffAlgorithm));
+  return dist_parallel(xSample, ncores);
+}
+
+// See `dist_omp()` for `profile` and `affinity`.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_parallel(SEXP x,
+                                  unsigned int dimension = 1,
+                                  unsigned int ncores = 1,
+                                  std::string algorithm = "naive",
+                                  std::string precision = "double",
+                                  bool profile = false,
+                                  std::string affinity = "none")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  ThreadPlacement placement = parseThreadPlacement(affinity, ncores);
+  if (placement.isPinned())
+  {
+    if (profile)
+      Rcpp::stop("Profiling is not available with pinned threads. Use affinity = 'none'.");
+    return dist_parallel_placed(*xSample, placement);
+  }
+
+  if (!profile)
+    return dist_parallel(*xSample, ncores);
+
+  DistProfile distProfile;
+  DistProfiler profiler = {&distProfile};
+  Rcpp::NumericVector out = dist_parallel_vector(*xSample, ncores, 0, "hausdorff", profiler);
+  out.attr("profile") = distProfile.summary();
+  return out;
+}
+
+// Out-of-core variant: the distances are written to the memory-mapped file
+// `file` as float64 or float32 and a handle to it is returned.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_parallel_file(SEXP x,
+                                        std::string file,
+                                        unsigned int dimension = 1,
+                                        unsigned int ncores = 1,
+                                        std::string algorithm = "naive",
+                                        std::string type = "float64",
+                                        std::string precision = "double")
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  Rcpp::XPtr<DistFile> out = createDistFile(file, xSample->size(), type);
+  DistFile &outFile = *out;
+
+  dist_parallel(*xSample, [&outFile] (std::size_t k, double value) {
+    outFile.set(k, value);
+  }, ncores);
+
+  outFile.flush();
+  return out;
+}
+
+// Resumable variant of `dist_parallel_file()` for long computations (see
+// `dist_job.h`): the tiles done are checkpointed in `<file>.ckpt` every
+// `checkpoint` seconds, and a later call with the same curves and arguments
+// only computes the remaining ones. The computation stops cleanly on a user
+// interrupt or after `time_limit` seconds (never if 0), and prints its
+// progress if `display_progress` is true.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_parallel_job(SEXP x,
+                                       std::string file,
+                                       unsigned int dimension = 1,
+                                       unsigned int ncores = 1,
+                                       std::string algorithm = "naive",
+                                       std::string type = "float64",
+                                       std::string precision = "double",
+                                       double checkpoint = 60,
+                                       double time_limit = 0,
+                                       bool display_progress = false)
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  PairTiling tiling(xSample->size(), defaultTileSize(xSample->curveBytes()));
+
+  DistJobOptions options;
+  options.checkpointSeconds = checkpoint;
+  options.timeLimit = time_limit;
+  options.displayProgress = display_progress;
+  DistJob job(file, tiling, xSample->size(), parseDistValueType(type), sampleFingerprint(*xSample), options);
+
+  dist_parallel_job(*xSample, job, ncores);
+  job.finish();
+  return dist_file_open(file);
+}
+
+// Computes the pairs of the cost-ordered tasks it is given.
+struct RaggedDistanceComputer : public RcppParallel::Worker
+{
+  const RaggedCurvePlanes &m_Input;
+  const CostOrderedPairs &m_Tasks;
+  RcppParallel::RVector<double> m_SafeOutput;
+
+  RaggedDistanceComputer(const RaggedCurvePlanes &x,
+                         const CostOrderedPairs &tasks,
+                         Rcpp::NumericVector out)
+    : m_Input(x), m_Tasks(tasks), m_SafeOutput(out) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t t = begin;t < end;++t)
+    {
+      m_Tasks.forEachPair(t, [this] (std::size_t i, std::size_t j, std::size_t k) {
+        m_SafeOutput[k] = std::sqrt(hausdorff_squared_ragged(m_Input, i, m_Input, j));
+      });
+    }
+  }
+};
+
+// Curves with different numbers of points: the pairs are split into tasks of
+// similar cost, sorted most expensive first, and the task range is split with
+// a grain size of one task so that idle workers can steal any of them.
+Rcpp::NumericVector dist_parallel_ragged(const RaggedCurvePlanes &curves, unsigned int ncores = 1)
+{
+  std::size_t N = curves.size();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
 
-  HausdorffDistanceComputer hausdorffDistance(x, out, dimension);
-  RcppParallel::parallelFor(0, K, hausdorffDistance, 1, ncores);
+  CostOrderedPairs tasks = raggedPairTasks(curves, ncores);
+  RaggedDistanceComputer raggedDistance(curves, tasks, out);
+  RcppParallel::parallelFor(0, tasks.size(), raggedDistance, 1, ncores);
 
   out.attr("Size") = N;
   out.attr("Labels") = Rcpp::seq(1, N);
@@ -43,11 +384,36 @@ Rcpp::NumericVector dist_parallel(Rcpp::NumericMatrix x,
   return out;
 }
 
+// `x` is a list of D x P_i curves with different numbers of points P_i, or
+// curves packed by `pack_ragged_curves()`.
 // [[Rcpp::export]]
-Rcpp::NumericVector dist_parallel(Rcpp::List x,
-                                  unsigned int dimension = 1,
-                                  unsigned int ncores = 1)
+Rcpp::NumericVector dist_parallel_ragged(SEXP x,
+                                         unsigned int dimension = 1,
+                                         unsigned int ncores = 1)
+{
+  Rcpp::XPtr<RaggedCurvePlanes> curves = asRaggedCurves(x, dimension, ncores);
+  return dist_parallel_ragged(*curves, ncores);
+}
+
+struct ParallelMetricDist
+{
+  unsigned int m_NumCores;
+
+  template <typename Sample>
+  Rcpp::NumericVector operator()(Sample &xSample) const
+  {
+    return dist_parallel_vector(xSample, m_NumCores, 0, xSample.method());
+  }
+};
+
+// Same as `dist_omp_metric()` with the RcppParallel backend.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_parallel_metric(Rcpp::List x,
+                                         std::string metric = "frechet",
+                                         unsigned int dimension = 1,
+                                         unsigned int ncores = 1,
+                                         int window = -1)
 {
-  Rcpp::NumericMatrix xMatrix = listToMatrix(x);
-  return dist_parallel(xMatrix, dimension, ncores);
+  ParallelMetricDist backend = {ncores};
+  return distWithMetric(packCurves(x, dimension, ncores), parseCurveMetric(metric), window, backend);
 }
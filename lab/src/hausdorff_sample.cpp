@@ -0,0 +1,137 @@
+#include "hausdorff_sample.h"
+#include "numa_placement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+HausdorffSample::HausdorffSample(CurvePlanes curves,
+                                 HausdorffAlgorithm algorithm,
+                                 HausdorffPrecision precision)
+  : m_Curves(std::move(curves)), m_Algorithm(algorithm), m_Precision(precision),
+    m_FloatCurves(precision == HAUSDORFF_MIXED ? m_Curves.size() : 0,
+                  m_Curves.dimension(), m_Curves.numPoints()),
+    m_Boxes(2 * m_Curves.dimension() * m_Curves.size()),
+    m_Prepared(m_Curves.size(), 0)
+{
+  if (m_Algorithm == HAUSDORFF_KDTREE)
+    m_Trees.resize(m_Curves.size());
+}
+
+void HausdorffSample::prepare(std::size_t i)
+{
+  if (m_Prepared[i])
+    return;
+
+  m_Prepared[i] = 1;
+
+  unsigned int dimension = m_Curves.dimension();
+  const double *curve = m_Curves.curve(i);
+  double *box = m_Boxes.data() + 2 * dimension * i;
+  for (unsigned int k = 0;k < dimension;++k)
+  {
+    const double *plane = curve + k * m_Curves.stride();
+    std::pair<const double *, const double *> range = std::minmax_element(plane, plane + m_Curves.numPoints());
+    box[k] = *range.first;
+    box[dimension + k] = *range.second;
+  }
+
+  if (m_Algorithm != HAUSDORFF_NAIVE)
+    shuffleCurvePoints(m_Curves, i);
+
+  if (m_Algorithm == HAUSDORFF_KDTREE)
+    m_Trees[i].build(m_Curves.curve(i), m_Curves.dimension(), m_Curves.numPoints(), m_Curves.stride());
+
+  if (m_Precision == HAUSDORFF_MIXED)
+    m_FloatCurves.assign(i, m_Curves);
+}
+
+double HausdorffSample::distance(std::size_t i, std::size_t j) const
+{
+  return distance(i, *this, j);
+}
+
+double HausdorffSample::distance(std::size_t i,
+                                 const HausdorffSample &other,
+                                 std::size_t j) const
+{
+  return distance(i, other, j, std::numeric_limits<double>::infinity());
+}
+
+double HausdorffSample::distance(std::size_t i, std::size_t j, std::size_t &visited) const
+{
+  return distance(i, *this, j, std::numeric_limits<double>::infinity(), &visited);
+}
+
+double HausdorffSample::distance(std::size_t i,
+                                 const HausdorffSample &other,
+                                 std::size_t j,
+                                 double limit,
+                                 std::size_t *visited) const
+{
+  if (m_Precision == HAUSDORFF_MIXED)
+    return std::sqrt(hausdorff_squared_mixed(m_Curves, m_FloatCurves, i, other.m_Curves, other.m_FloatCurves, j,
+                                             visited));
+
+  const double *x = m_Curves.curve(i);
+  const double *y = other.m_Curves.curve(j);
+  unsigned int dimension = m_Curves.dimension();
+  std::size_t numPoints = m_Curves.numPoints();
+  std::size_t stride = m_Curves.stride();
+  double dist = 0.0;
+  double squaredLimit = limit * limit;
+
+  switch (m_Algorithm)
+  {
+  case HAUSDORFF_EARLY_BREAK:
+    dist = hausdorff_squared_early_break(x, y, dimension, numPoints, stride, squaredLimit, visited);
+    break;
+  case HAUSDORFF_KDTREE:
+    dist = directed_hausdorff_kdtree(x, y, dimension, numPoints, stride, other.m_Trees[j], 0.0, squaredLimit,
+                                     visited);
+    if (dist <= squaredLimit)
+      dist = directed_hausdorff_kdtree(y, x, dimension, numPoints, stride, m_Trees[i], dist, squaredLimit,
+                                       visited);
+    break;
+  default:
+    dist = hausdorff_squared_simd(x, y, dimension, numPoints, stride);
+    if (visited)
+      *visited += 2 * numPoints * numPoints;
+    break;
+  }
+
+  return std::sqrt(dist);
+}
+
+double HausdorffSample::lowerBound(std::size_t i,
+                                   const HausdorffSample &other,
+                                   std::size_t j) const
+{
+  unsigned int dimension = m_Curves.dimension();
+  const double *xBox = m_Boxes.data() + 2 * dimension * i;
+  const double *yBox = other.m_Boxes.data() + 2 * dimension * j;
+  double bound = 0.0;
+
+  for (unsigned int k = 0;k < 2 * dimension;++k)
+    bound = std::max(bound, std::abs(xBox[k] - yBox[k]));
+
+  return bound;
+}
+
+bool HausdorffSample::isCompatible(const HausdorffSample &other) const
+{
+  return m_Algorithm == other.m_Algorithm &&
+    m_Precision == other.m_Precision &&
+    m_Curves.dimension() == other.m_Curves.dimension() &&
+    m_Curves.numPoints() == other.m_Curves.numPoints();
+}
+
+void HausdorffSample::placeCurves(const ThreadPlacement &placement)
+{
+  if (placement.numNodes() == m_NumCurveNodes)
+    return;
+
+  m_Curves = placeCurvesOnNodes(m_Curves, placement);
+  m_NumCurveNodes = placement.numNodes();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "hausdorff_kdtree.h"
+#include "hausdorff_simd.h"
+
+class ThreadPlacement;
+
+// A packed sample of curves together with the per-curve preprocessing needed
+// by the selected algorithm, so that the backends only have to call
+// `prepare()` once per curve and `distance()` once per pair.
+class HausdorffSample
+{
+public:
+  HausdorffSample(CurvePlanes curves,
+                  HausdorffAlgorithm algorithm = HAUSDORFF_NAIVE,
+                  HausdorffPrecision precision = HAUSDORFF_DOUBLE);
+
+  std::size_t size() const { return m_Curves.size(); }
+  const CurvePlanes &curves() const { return m_Curves; }
+  HausdorffAlgorithm algorithm() const { return m_Algorithm; }
+  HausdorffPrecision precision() const { return m_Precision; }
+
+  // Memory footprint of one packed curve, used to size cache blocks.
+  std::size_t curveBytes() const
+  {
+    return m_Curves.dimension() * m_Curves.stride() * sizeof(double);
+  }
+
+  // Preprocesses the i-th curve: computes its bounding box, shuffles its
+  // points for the early-break algorithms, builds its k-d tree for the
+  // `HAUSDORFF_KDTREE` one and rounds it to single precision for
+  // `HAUSDORFF_MIXED`.
+  // Distinct curves can be prepared concurrently and preparing a curve twice
+  // does nothing, so that packed samples can be reused. Every curve must have
+  // been prepared before calling `distance()`.
+  void prepare(std::size_t i);
+
+  double distance(std::size_t i, std::size_t j) const;
+
+  // Distance between the i-th curve of this sample and the j-th curve of
+  // `other`, which must hold curves of the same dimension and number of
+  // points, prepared with the same algorithm and precision.
+  double distance(std::size_t i,
+                  const HausdorffSample &other,
+                  std::size_t j) const;
+
+  // Same as above, but the computation may be abandoned as soon as the
+  // distance is known to exceed `limit`, in which case the returned value is
+  // larger than `limit` but not necessarily the distance. Only the
+  // early-break algorithms can abandon their scans. If `visited` is not null,
+  // the number of distances between points computed is added to it.
+  double distance(std::size_t i,
+                  const HausdorffSample &other,
+                  std::size_t j,
+                  double limit,
+                  std::size_t *visited = nullptr) const;
+
+  // Distance between the i-th and j-th curves of this sample, adding the
+  // number of distances between points computed to `visited`.
+  double distance(std::size_t i, std::size_t j, std::size_t &visited) const;
+
+  // Lower bound on the distance between the i-th curve of this sample and the
+  // j-th curve of `other`, from the bounding boxes of their points: a curve
+  // whose box sticks out of the other's box by `h` along one axis has a point
+  // at least `h` away from all the points of the other curve.
+  double lowerBound(std::size_t i,
+                    const HausdorffSample &other,
+                    std::size_t j) const;
+
+  bool isCompatible(const HausdorffSample &other) const;
+
+  // Moves the curves of each NUMA node of `placement` (see `curveNode()`) to
+  // pages of that node, unless they already are spread over that many nodes.
+  // The data built by `prepare()` stays where the preparing threads allocated
+  // it.
+  void placeCurves(const ThreadPlacement &placement);
+
+private:
+  CurvePlanes m_Curves;
+  HausdorffAlgorithm m_Algorithm;
+  HausdorffPrecision m_Precision;
+  std::vector<CurveKdTree> m_Trees;
+  FloatCurvePlanes m_FloatCurves;
+  // Minimum then maximum of each coordinate, 2 * dimension values per curve.
+  std::vector<double> m_Boxes;
+  std::vector<unsigned char> m_Prepared;
+  std::size_t m_NumCurveNodes = 1;
+};
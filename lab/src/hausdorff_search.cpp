@@ -0,0 +1,200 @@
+#include "hausdorff_utils.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+typedef std::pair<double, std::size_t> Neighbour;
+
+// k nearest curves of each curve. The other curves are visited by increasing
+// lower bound, which stops the search as soon as the bound exceeds the current
+// k-th distance, and each distance is abandoned once it exceeds the k-th one.
+struct NearestNeighbourSearch : public RcppParallel::Worker
+{
+  const HausdorffSample &m_Sample;
+  std::size_t m_NumNeighbours;
+  RcppParallel::RMatrix<int> m_SafeIndices;
+  RcppParallel::RMatrix<double> m_SafeDistances;
+
+  NearestNeighbourSearch(const HausdorffSample &sample,
+                         std::size_t numNeighbours,
+                         Rcpp::IntegerMatrix indices,
+                         Rcpp::NumericMatrix distances)
+    : m_Sample(sample), m_NumNeighbours(numNeighbours),
+      m_SafeIndices(indices), m_SafeDistances(distances) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    std::size_t N = m_Sample.size();
+    std::vector<Neighbour> candidates;
+    std::vector<Neighbour> best;
+
+    for (std::size_t i = begin;i < end;++i)
+    {
+      candidates.clear();
+      for (std::size_t j = 0;j < N;++j)
+      {
+        if (j != i)
+          candidates.push_back(Neighbour(m_Sample.lowerBound(i, m_Sample, j), j));
+      }
+      std::sort(candidates.begin(), candidates.end());
+
+      // Max-heap on (distance, index) so that ties are broken by index and
+      // the result does not depend on the visiting order.
+      best.clear();
+      for (std::size_t c = 0;c < candidates.size();++c)
+      {
+        bool full = best.size() == m_NumNeighbours;
+        if (full && candidates[c].first > best.front().first)
+          break;
+
+        std::size_t j = candidates[c].second;
+        double limit = full ? best.front().first : std::numeric_limits<double>::infinity();
+        Neighbour neighbour(m_Sample.distance(i, m_Sample, j, limit), j);
+
+        if (!full)
+        {
+          best.push_back(neighbour);
+          std::push_heap(best.begin(), best.end());
+        }
+        else if (neighbour < best.front())
+        {
+          std::pop_heap(best.begin(), best.end());
+          best.back() = neighbour;
+          std::push_heap(best.begin(), best.end());
+        }
+      }
+
+      std::sort_heap(best.begin(), best.end());
+      for (std::size_t r = 0;r < best.size();++r)
+      {
+        m_SafeIndices(i, r) = best[r].second + 1;
+        m_SafeDistances(i, r) = best[r].first;
+      }
+    }
+  }
+};
+
+// Curves with a larger index within distance `eps` of each curve.
+struct RadiusSearch : public RcppParallel::Worker
+{
+  const HausdorffSample &m_Sample;
+  double m_Radius;
+  std::vector< std::vector<Neighbour> > &m_Neighbours;
+
+  RadiusSearch(const HausdorffSample &sample,
+               double radius,
+               std::vector< std::vector<Neighbour> > &neighbours)
+    : m_Sample(sample), m_Radius(radius), m_Neighbours(neighbours) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin;i < end;++i)
+    {
+      for (std::size_t j = i + 1;j < m_Sample.size();++j)
+      {
+        if (m_Sample.lowerBound(i, m_Sample, j) > m_Radius)
+          continue;
+
+        double dist = m_Sample.distance(i, m_Sample, j, m_Radius);
+        if (dist <= m_Radius)
+          m_Neighbours[i].push_back(Neighbour(dist, j));
+      }
+    }
+  }
+};
+
+Rcpp::List hausdorff_knn(HausdorffSample &xSample,
+                         unsigned int k,
+                         unsigned int ncores = 1)
+{
+  std::size_t N = xSample.size();
+  if (k == 0 || k >= N)
+    Rcpp::stop("`k` must be between 1 and %d, the number of curves minus one.", N - 1);
+
+  CurvePreprocessor<HausdorffSample> curvePreprocessor(xSample);
+  RcppParallel::parallelFor(0, N, curvePreprocessor, 1, ncores);
+
+  Rcpp::IntegerMatrix indices(N, k);
+  Rcpp::NumericMatrix distances(N, k);
+  NearestNeighbourSearch nearestNeighbourSearch(xSample, k, indices, distances);
+  RcppParallel::parallelFor(0, N, nearestNeighbourSearch, 1, ncores);
+
+  return Rcpp::List::create(
+    Rcpp::Named("index") = indices,
+    Rcpp::Named("distance") = distances
+  );
+}
+
+// The `k` nearest curves of each curve of `x`, as the 1-based `index` of the
+// neighbours and their `distance`, both N x k matrices sorted by increasing
+// distance. Pairs are skipped using bounding box lower bounds and distances
+// are abandoned once they exceed the current k-th one when `algorithm` is
+// "early_break" or "kdtree".
+// [[Rcpp::export]]
+Rcpp::List hausdorff_knn(SEXP x,
+                         unsigned int k,
+                         unsigned int dimension = 1,
+                         unsigned int ncores = 1,
+                         std::string algorithm = "naive",
+                         std::string precision = "double")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  return hausdorff_knn(*xSample, k, ncores);
+}
+
+Rcpp::DataFrame hausdorff_radius(HausdorffSample &xSample,
+                                 double eps,
+                                 unsigned int ncores = 1)
+{
+  std::size_t N = xSample.size();
+  if (!(eps >= 0.0))
+    Rcpp::stop("`eps` must be a non-negative number.");
+
+  CurvePreprocessor<HausdorffSample> curvePreprocessor(xSample);
+  RcppParallel::parallelFor(0, N, curvePreprocessor, 1, ncores);
+
+  std::vector< std::vector<Neighbour> > neighbours(N);
+  RadiusSearch radiusSearch(xSample, eps, neighbours);
+  RcppParallel::parallelFor(0, N, radiusSearch, 1, ncores);
+
+  std::size_t numEdges = 0;
+  for (std::size_t i = 0;i < N;++i)
+    numEdges += neighbours[i].size();
+
+  Rcpp::IntegerVector from(numEdges);
+  Rcpp::IntegerVector to(numEdges);
+  Rcpp::NumericVector distance(numEdges);
+  std::size_t e = 0;
+  for (std::size_t i = 0;i < N;++i)
+  {
+    for (std::size_t l = 0;l < neighbours[i].size();++l, ++e)
+    {
+      from[e] = i + 1;
+      to[e] = neighbours[i][l].second + 1;
+      distance[e] = neighbours[i][l].first;
+    }
+  }
+
+  return Rcpp::DataFrame::create(
+    Rcpp::Named("from") = from,
+    Rcpp::Named("to") = to,
+    Rcpp::Named("distance") = distance
+  );
+}
+
+// Pairs of curves of `x` at distance at most `eps`, as an edge list with
+// 1-based indices `from < to`, sorted by `from` then `to`. Pairs are skipped
+// and distances abandoned as in `hausdorff_knn()`.
+// [[Rcpp::export]]
+Rcpp::DataFrame hausdorff_radius(SEXP x,
+                                 double eps,
+                                 unsigned int dimension = 1,
+                                 unsigned int ncores = 1,
+                                 std::string algorithm = "naive",
+                                 std::string precision = "double")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  return hausdorff_radius(*xSample, eps, ncores);
+}
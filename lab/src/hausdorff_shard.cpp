@@ -0,0 +1,309 @@
+#include "dist_job.h"
+#include "dist_shard.h"
+#include "hausdorff_utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Writes the distances of the tiles of a shard, numbered from `m_TileBegin`,
+// into `m_Values`, each tile from the offset of its first pair.
+struct ShardDistanceComputer : public RcppParallel::Worker
+{
+  const HausdorffSample &m_Input;
+  const PairTiling &m_Tiling;
+  std::size_t m_TileBegin;
+  const std::vector<std::size_t> &m_Offsets;
+  std::vector<double> &m_Values;
+
+  ShardDistanceComputer(const HausdorffSample &x,
+                        const PairTiling &tiling,
+                        std::size_t tileBegin,
+                        const std::vector<std::size_t> &offsets,
+                        std::vector<double> &values)
+    : m_Input(x), m_Tiling(tiling), m_TileBegin(tileBegin), m_Offsets(offsets), m_Values(values) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t t = begin;t < end;++t)
+    {
+      double *out = m_Values.data() + m_Offsets[t];
+      m_Tiling.forEachPair(m_TileBegin + t, [this, &out] (std::size_t i, std::size_t j, std::size_t) {
+        *out++ = m_Input.distance(i, j);
+      });
+    }
+  }
+};
+
+// Prepares the curves that the tiles `[tileBegin, tileEnd)` of `tiling` read,
+// those of their rows and of their columns.
+struct ShardCurvePreprocessor : public RcppParallel::Worker
+{
+  HausdorffSample &m_Sample;
+  std::vector<std::size_t> m_Curves;
+
+  ShardCurvePreprocessor(HausdorffSample &x,
+                         const PairTiling &tiling,
+                         std::size_t tileBegin,
+                         std::size_t tileEnd)
+    : m_Sample(x)
+  {
+    std::vector<unsigned char> read(x.size(), 0);
+    for (std::size_t t = tileBegin;t < tileEnd;++t)
+    {
+      std::size_t rowEnd = std::min(tiling.rowStart(t) + tiling.tileSize(), x.size());
+      std::size_t colEnd = std::min(tiling.colStart(t) + tiling.tileSize(), x.size());
+      std::fill(read.begin() + tiling.rowStart(t), read.begin() + rowEnd, 1);
+      std::fill(read.begin() + tiling.colStart(t), read.begin() + colEnd, 1);
+    }
+    for (std::size_t i = 0;i < read.size();++i)
+    {
+      if (read[i])
+        m_Curves.push_back(i);
+    }
+  }
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t c = begin;c < end;++c)
+      m_Sample.prepare(m_Curves[c]);
+  }
+};
+
+// Curves `x` as in `asHausdorffSample()`, but a list is only packed: its
+// curves are prepared (points shuffled, k-d trees built, ...) by the shards
+// that read them.
+static Rcpp::XPtr<HausdorffSample> asShardSample(SEXP x,
+                                                 unsigned int dimension,
+                                                 std::string algorithm,
+                                                 std::string precision,
+                                                 unsigned int ncores)
+{
+  if (TYPEOF(x) == EXTPTRSXP)
+    return asPackedCurves(x);
+
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffPrecision hausdorffPrecision = parseHausdorffPrecision(precision, hausdorffAlgorithm);
+  HausdorffSample *sample = new HausdorffSample(packCurves(Rcpp::List(x), dimension, ncores),
+                                                hausdorffAlgorithm, hausdorffPrecision);
+  return Rcpp::XPtr<HausdorffSample>(sample, true);
+}
+
+static std::size_t checkNumShards(unsigned int num_shards)
+{
+  if (num_shards == 0)
+    Rcpp::stop("num_shards should be at least 1.");
+  return num_shards;
+}
+
+// Computes the `shard`-th (1-based) of `num_shards` shards of the distances
+// between the curves `x` into the file `<prefix>.shard-<shard>-of-<num_shards>`
+// (see `dist_shard.h`) with `ncores` threads, and returns its path. A shard
+// file already complete for the same curves and arguments is kept as is, so
+// that a worker can be run again for all shards and only computes the ones
+// that are missing or failed. The shards can be computed by different
+// processes, on this machine or on any machine sharing the directory. Each
+// process packs all the curves, but only prepares those its shard reads.
+// [[Rcpp::export]]
+std::string dist_shard(SEXP x,
+                       std::string prefix,
+                       unsigned int shard,
+                       unsigned int num_shards,
+                       unsigned int dimension = 1,
+                       unsigned int ncores = 1,
+                       std::string algorithm = "naive",
+                       std::string type = "float64",
+                       std::string precision = "double")
+{
+  std::size_t numShards = checkNumShards(num_shards);
+  if (shard < 1 || shard > numShards)
+    Rcpp::stop("shard should be between 1 and num_shards.");
+
+  Rcpp::XPtr<HausdorffSample> xSample = asShardSample(x, dimension, algorithm, precision, ncores);
+  PairTiling tiling(xSample->size(), defaultTileSize(xSample->curveBytes()));
+  DistShardHeader header = distShardHeader(sampleFingerprint(*xSample), xSample->size(), tiling,
+                                           shard - 1, numShards, parseDistValueType(type));
+
+  std::string path = distShardPath(prefix, shard - 1, numShards);
+  DistShardHeader existing;
+  if (readDistShardHeader(path, existing) && std::memcmp(&existing, &header, sizeof(header)) == 0)
+    return path;
+
+  std::size_t numTiles = header.tileEnd - header.tileBegin;
+  std::vector<std::size_t> offsets(numTiles + 1, 0);
+  for (std::size_t t = 0;t < numTiles;++t)
+    offsets[t + 1] = offsets[t] + tiling.numPairs(header.tileBegin + t);
+
+  ShardCurvePreprocessor shardPreprocessor(*xSample, tiling, header.tileBegin, header.tileEnd);
+  RcppParallel::parallelFor(0, shardPreprocessor.m_Curves.size(), shardPreprocessor, 1, ncores);
+
+  std::vector<double> values(header.numValues);
+  ShardDistanceComputer shardDistance(*xSample, tiling, header.tileBegin, offsets, values);
+  RcppParallel::parallelFor(0, numTiles, shardDistance, 1, ncores);
+
+  try
+  {
+    writeDistShard(path, header, values);
+  }
+  catch (const std::runtime_error &error)
+  {
+    Rcpp::stop(error.what());
+  }
+  return path;
+}
+
+// State of each of the `num_shards` shard files of `prefix` for the curves
+// `x` and the other arguments of `dist_shard()`: "done", "missing" (no
+// complete file, e.g. a worker that failed or is still running) or "stale"
+// (a complete file computed for other curves or arguments).
+// [[Rcpp::export]]
+Rcpp::DataFrame dist_shard_status(SEXP x,
+                                  std::string prefix,
+                                  unsigned int num_shards,
+                                  unsigned int dimension = 1,
+                                  unsigned int ncores = 1,
+                                  std::string algorithm = "naive",
+                                  std::string type = "float64",
+                                  std::string precision = "double")
+{
+  std::size_t numShards = checkNumShards(num_shards);
+  Rcpp::XPtr<HausdorffSample> xSample = asShardSample(x, dimension, algorithm, precision, ncores);
+  PairTiling tiling(xSample->size(), defaultTileSize(xSample->curveBytes()));
+  std::uint64_t fingerprint = sampleFingerprint(*xSample);
+  DistValueType valueType = parseDistValueType(type);
+
+  Rcpp::IntegerVector shards(numShards);
+  Rcpp::CharacterVector files(numShards);
+  Rcpp::CharacterVector status(numShards);
+  Rcpp::NumericVector pairs(numShards);
+  for (std::size_t s = 0;s < numShards;++s)
+  {
+    DistShardHeader header = distShardHeader(fingerprint, xSample->size(), tiling, s, numShards, valueType);
+    std::string path = distShardPath(prefix, s, numShards);
+    DistShardHeader existing;
+
+    shards[s] = s + 1;
+    files[s] = path;
+    pairs[s] = header.numValues;
+    if (!readDistShardHeader(path, existing))
+      status[s] = "missing";
+    else if (std::memcmp(&existing, &header, sizeof(header)) != 0)
+      status[s] = "stale";
+    else
+      status[s] = "done";
+  }
+
+  return Rcpp::DataFrame::create(Rcpp::Named("shard") = shards,
+                                 Rcpp::Named("file") = files,
+                                 Rcpp::Named("status") = status,
+                                 Rcpp::Named("pairs") = pairs,
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
+// Headers of the `numShards` shard files of `prefix`, checked to be complete
+// and to belong to the same computation, whose tiling is returned.
+static std::vector<DistShardHeader> readShardHeaders(const std::string &prefix,
+                                                     std::size_t numShards,
+                                                     std::unique_ptr<PairTiling> &tiling)
+{
+  std::vector<DistShardHeader> out(numShards);
+  std::string missing;
+  for (std::size_t s = 0;s < numShards;++s)
+  {
+    if (!readDistShardHeader(distShardPath(prefix, s, numShards), out[s]) ||
+        out[s].shard != s || out[s].numShards != numShards)
+    {
+      missing += (missing.empty() ? "" : ", ") + std::to_string(s + 1);
+    }
+  }
+  if (!missing.empty())
+    Rcpp::stop("Missing shards of '" + prefix + "': " + missing + ". Run dist_shard() for them.");
+
+  tiling.reset(new PairTiling(out[0].numCurves, out[0].tileSize));
+  for (std::size_t s = 0;s < numShards;++s)
+  {
+    DistShardHeader expected = distShardHeader(out[0].fingerprint, out[0].numCurves, *tiling, s, numShards,
+                                               static_cast<DistValueType>(out[0].valueType));
+    if (std::memcmp(&out[s], &expected, sizeof(expected)) != 0)
+      Rcpp::stop("The shard " + std::to_string(s + 1) + " of '" + prefix +
+        "' was computed for other curves or arguments than the first one.");
+  }
+  return out;
+}
+
+// `dist` object merged from the `num_shards` shard files of `prefix`, which
+// must all be complete.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_shard_merge(std::string prefix, unsigned int num_shards)
+{
+  std::unique_ptr<PairTiling> tiling;
+  std::vector<DistShardHeader> headers = readShardHeaders(prefix, checkNumShards(num_shards), tiling);
+
+  std::size_t N = headers[0].numCurves;
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+
+  // One shard in memory at a time.
+  std::vector<double> values;
+  for (std::size_t s = 0;s < headers.size();++s)
+  {
+    std::string path = distShardPath(prefix, s, headers.size());
+    try
+    {
+      readDistShardValues(path, headers[s], values);
+    }
+    catch (const std::runtime_error &error)
+    {
+      Rcpp::stop(error.what());
+    }
+    forEachShardValue(*tiling, headers[s], values, [&out] (std::size_t k, double value) {
+      out[k] = value;
+    });
+  }
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+// Same as above, but the distances are merged into the memory-mapped file
+// `file` (see `dist_omp_file()`), with the value type of the shards, and a
+// handle to it is returned: the merge then never holds more than one shard
+// in memory.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_shard_merge_file(std::string prefix,
+                                           unsigned int num_shards,
+                                           std::string file)
+{
+  std::unique_ptr<PairTiling> tiling;
+  std::vector<DistShardHeader> headers = readShardHeaders(prefix, checkNumShards(num_shards), tiling);
+
+  std::string type = headers[0].valueType == DIST_FLOAT32 ? "float32" : "float64";
+  Rcpp::XPtr<DistFile> out = createDistFile(file, headers[0].numCurves, type);
+  DistFile &outFile = *out;
+
+  std::vector<double> values;
+  for (std::size_t s = 0;s < headers.size();++s)
+  {
+    std::string path = distShardPath(prefix, s, headers.size());
+    try
+    {
+      readDistShardValues(path, headers[s], values);
+    }
+    catch (const std::runtime_error &error)
+    {
+      Rcpp::stop(error.what());
+    }
+    forEachShardValue(*tiling, headers[s], values, [&outFile] (std::size_t k, double value) {
+      outFile.set(k, value);
+    });
+  }
+
+  outFile.flush();
+  return out;
+}
@@ -0,0 +1,1266 @@
+#include "hausdorff_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Keep multiplications and additions separate: a fused multiply-add rounds
+// only once and would break bit-for-bit agreement with the scalar kernel.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAUSDORFF_X86_DISPATCH 1
+#include <immintrin.h>
+#define HAUSDORFF_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+void AlignedDeleter::operator()(double *ptr) const
+{
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+void AlignedDeleter::operator()(float *ptr) const
+{
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+template <typename T>
+static T *allocateAligned(std::size_t n)
+{
+  std::size_t numBytes = std::max(n, std::size_t(1)) * sizeof(T);
+  void *ptr = nullptr;
+#ifdef _WIN32
+  ptr = _aligned_malloc(numBytes, 64);
+#else
+  if (posix_memalign(&ptr, 64, numBytes) != 0)
+    ptr = nullptr;
+#endif
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return static_cast<T *>(ptr);
+}
+
+CurvePlanes::CurvePlanes(std::size_t numCurves,
+                         unsigned int dimension,
+                         std::size_t numPoints)
+  : m_NumCurves(numCurves),
+    m_Dimension(dimension),
+    m_NumPoints(numPoints),
+    m_Stride((numPoints + CURVE_PLANE_ALIGNMENT - 1) / CURVE_PLANE_ALIGNMENT * CURVE_PLANE_ALIGNMENT),
+    m_Data(allocateAligned<double>(numCurves * dimension * m_Stride)) {}
+
+void CurvePlanes::pad(std::size_t i)
+{
+  if (m_NumPoints == 0)
+    return;
+
+  double *x = curve(i);
+  for (unsigned int k = 0;k < m_Dimension;++k)
+  {
+    double *plane = x + k * m_Stride;
+    std::fill(plane + m_NumPoints, plane + m_Stride, plane[m_NumPoints - 1]);
+  }
+}
+
+static std::size_t paddedSize(std::size_t numPoints)
+{
+  return (numPoints + CURVE_PLANE_ALIGNMENT - 1) / CURVE_PLANE_ALIGNMENT * CURVE_PLANE_ALIGNMENT;
+}
+
+static std::vector<std::size_t> raggedOffsets(const std::vector<std::size_t> &numPoints)
+{
+  std::vector<std::size_t> offsets(numPoints.size() + 1, 0);
+  for (std::size_t i = 0;i < numPoints.size();++i)
+    offsets[i + 1] = offsets[i] + paddedSize(numPoints[i]);
+  return offsets;
+}
+
+RaggedCurvePlanes::RaggedCurvePlanes(const std::vector<std::size_t> &numPoints,
+                                     unsigned int dimension)
+  : m_Dimension(dimension),
+    m_NumPoints(numPoints),
+    m_Offsets(raggedOffsets(numPoints)),
+    m_Data(allocateAligned<double>(m_Offsets.back() * dimension)) {}
+
+void RaggedCurvePlanes::pad(std::size_t i)
+{
+  std::size_t numPoints = m_NumPoints[i];
+  if (numPoints == 0)
+    return;
+
+  double *x = curve(i);
+  for (unsigned int k = 0;k < m_Dimension;++k)
+  {
+    double *plane = x + k * stride(i);
+    std::fill(plane + numPoints, plane + stride(i), plane[numPoints - 1]);
+  }
+}
+
+FloatCurvePlanes::FloatCurvePlanes(std::size_t numCurves,
+                                   unsigned int dimension,
+                                   std::size_t numPoints)
+  : m_Dimension(dimension),
+    m_NumPoints(numPoints),
+    m_Stride((numPoints + FLOAT_CURVE_PLANE_ALIGNMENT - 1) / FLOAT_CURVE_PLANE_ALIGNMENT * FLOAT_CURVE_PLANE_ALIGNMENT),
+    m_Data(allocateAligned<float>(numCurves * dimension * m_Stride)),
+    m_Magnitudes(new double[std::max(numCurves, std::size_t(1))]) {}
+
+void FloatCurvePlanes::assign(std::size_t i, const CurvePlanes &curves)
+{
+  const double *x = curves.curve(i);
+  float *out = m_Data.get() + i * m_Dimension * m_Stride;
+  double magnitude = 0.0;
+
+  for (unsigned int k = 0;k < m_Dimension;++k)
+  {
+    const double *plane = x + k * curves.stride();
+    float *outPlane = out + k * m_Stride;
+
+    for (std::size_t p = 0;p < m_NumPoints;++p)
+    {
+      magnitude = std::max(magnitude, std::abs(plane[p]));
+      outPlane[p] = plane[p];
+    }
+
+    if (m_NumPoints > 0)
+      std::fill(outPlane + m_NumPoints, outPlane + m_Stride, outPlane[m_NumPoints - 1]);
+  }
+
+  m_Magnitudes[i] = magnitude;
+}
+
+static double hausdorff_squared_scalar(const double *x,
+                                       const double *y,
+                                       unsigned int dimension,
+                                       std::size_t numPoints,
+                                       std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    double min_dist_x = std::numeric_limits<double>::infinity();
+    double min_dist_y = std::numeric_limits<double>::infinity();
+
+    for (std::size_t j = 0;j < numPoints;++j)
+    {
+      double dist_x = 0.0;
+      double dist_y = 0.0;
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        double diff_x = x[k * stride + i] - y[k * stride + j];
+        double diff_y = y[k * stride + i] - x[k * stride + j];
+        dist_x += diff_x * diff_x;
+        dist_y += diff_y * diff_y;
+      }
+
+      min_dist_x = std::min(min_dist_x, dist_x);
+      min_dist_y = std::min(min_dist_y, dist_y);
+    }
+
+    dX = std::max(dX, min_dist_x);
+    dY = std::max(dY, min_dist_y);
+  }
+
+  return std::max(dX, dY);
+}
+
+// Full scan specialized on the dimension `D`: the coordinate loop is unrolled
+// and the coordinates of the i-th points are hoisted out of the scan, so that
+// they stay in registers. The squared distances are accumulated in the same
+// order as in the generic kernel, hence the same result.
+template <unsigned int D>
+static double hausdorff_squared_scalar_fixed(const double *x,
+                                             const double *y,
+                                             unsigned int,
+                                             std::size_t numPoints,
+                                             std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    double x_i[D];
+    double y_i[D];
+    for (unsigned int k = 0;k < D;++k)
+    {
+      x_i[k] = x[k * stride + i];
+      y_i[k] = y[k * stride + i];
+    }
+
+    double min_dist_x = std::numeric_limits<double>::infinity();
+    double min_dist_y = std::numeric_limits<double>::infinity();
+
+    for (std::size_t j = 0;j < numPoints;++j)
+    {
+      double dist_x = 0.0;
+      double dist_y = 0.0;
+
+      for (unsigned int k = 0;k < D;++k)
+      {
+        double diff_x = x_i[k] - y[k * stride + j];
+        double diff_y = y_i[k] - x[k * stride + j];
+        dist_x += diff_x * diff_x;
+        dist_y += diff_y * diff_y;
+      }
+
+      min_dist_x = std::min(min_dist_x, dist_x);
+      min_dist_y = std::min(min_dist_y, dist_y);
+    }
+
+    dX = std::max(dX, min_dist_x);
+    dY = std::max(dY, min_dist_y);
+  }
+
+  return std::max(dX, dY);
+}
+
+// Directed pass of the early-break algorithm of Taha & Hanbury (2015): the
+// scan over `y` stops as soon as a squared distance no larger than the running
+// maximum `cmax` is found, since the i-th point of `x` can then no longer
+// increase the result. The pass is abandoned once the running maximum exceeds
+// `climit`. Returns the updated running maximum, and adds the number of
+// distances between points computed to `visited` if it is not null. The curves
+// may have different numbers of points, `x` being stored as planes of
+// `xStride` doubles and `y` as planes of `yStride` doubles.
+static double directed_early_break_scalar(const double *x,
+                                          const double *y,
+                                          unsigned int dimension,
+                                          std::size_t xNumPoints,
+                                          std::size_t xStride,
+                                          std::size_t yNumPoints,
+                                          std::size_t yStride,
+                                          double cmax,
+                                          double climit,
+                                          std::size_t *visited)
+{
+  std::size_t numVisited = 0;
+
+  for (std::size_t i = 0;i < xNumPoints;++i)
+  {
+    double min_dist = std::numeric_limits<double>::infinity();
+    std::size_t j = 0;
+
+    for (;j < yNumPoints;++j)
+    {
+      double dist = 0.0;
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        double diff = x[k * xStride + i] - y[k * yStride + j];
+        dist += diff * diff;
+      }
+
+      min_dist = std::min(min_dist, dist);
+      if (min_dist <= cmax)
+        break;
+    }
+
+    numVisited += std::min(j + 1, yNumPoints);
+    cmax = std::max(cmax, min_dist);
+    if (cmax > climit)
+      break;
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return cmax;
+}
+
+// Single-precision squared distances from each point of `x` to its nearest
+// point of `y` and the other way around, written to `minima_x` and
+// `minima_y`. Used by the mixed precision kernel.
+static void hausdorff_minima_f32_scalar(const float *x,
+                                        const float *y,
+                                        unsigned int dimension,
+                                        std::size_t numPoints,
+                                        std::size_t stride,
+                                        float *minima_x,
+                                        float *minima_y)
+{
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    float min_dist_x = std::numeric_limits<float>::infinity();
+    float min_dist_y = std::numeric_limits<float>::infinity();
+
+    for (std::size_t j = 0;j < numPoints;++j)
+    {
+      float dist_x = 0.0f;
+      float dist_y = 0.0f;
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        float diff_x = x[k * stride + i] - y[k * stride + j];
+        float diff_y = y[k * stride + i] - x[k * stride + j];
+        dist_x += diff_x * diff_x;
+        dist_y += diff_y * diff_y;
+      }
+
+      min_dist_x = std::min(min_dist_x, dist_x);
+      min_dist_y = std::min(min_dist_y, dist_y);
+    }
+
+    minima_x[i] = min_dist_x;
+    minima_y[i] = min_dist_y;
+  }
+}
+
+#ifdef HAUSDORFF_X86_DISPATCH
+
+// Each vectorized kernel broadcasts the i-th point of one curve and compares
+// it against a full register of consecutive points of the other curve, so
+// that the inner loop computes several squared distances and running minima
+// at once. Padding guarantees that `stride` is a multiple of the lane count.
+
+HAUSDORFF_TARGET("sse2")
+static double hausdorff_squared_sse2(const double *x,
+                                     const double *y,
+                                     unsigned int dimension,
+                                     std::size_t numPoints,
+                                     std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(16) double lanes[2];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m128d min_dist_x = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 2)
+    {
+      __m128d dist_x = _mm_setzero_pd();
+      __m128d dist_y = _mm_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const double *xk = x + k * stride;
+        const double *yk = y + k * stride;
+        __m128d diff_x = _mm_sub_pd(_mm_set1_pd(xk[i]), _mm_load_pd(yk + j));
+        __m128d diff_y = _mm_sub_pd(_mm_set1_pd(yk[i]), _mm_load_pd(xk + j));
+        dist_x = _mm_add_pd(dist_x, _mm_mul_pd(diff_x, diff_x));
+        dist_y = _mm_add_pd(dist_y, _mm_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, std::min(lanes[0], lanes[1]));
+    _mm_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, std::min(lanes[0], lanes[1]));
+  }
+
+  return std::max(dX, dY);
+}
+
+// Counterpart of `hausdorff_squared_scalar_fixed()`.
+template <unsigned int D>
+HAUSDORFF_TARGET("sse2")
+static double hausdorff_squared_sse2_fixed(const double *x,
+                                           const double *y,
+                                           unsigned int,
+                                           std::size_t numPoints,
+                                           std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(16) double lanes[2];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m128d x_i[D];
+    __m128d y_i[D];
+    for (unsigned int k = 0;k < D;++k)
+    {
+      x_i[k] = _mm_set1_pd(x[k * stride + i]);
+      y_i[k] = _mm_set1_pd(y[k * stride + i]);
+    }
+
+    __m128d min_dist_x = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 2)
+    {
+      __m128d dist_x = _mm_setzero_pd();
+      __m128d dist_y = _mm_setzero_pd();
+
+      for (unsigned int k = 0;k < D;++k)
+      {
+        __m128d diff_x = _mm_sub_pd(x_i[k], _mm_load_pd(y + k * stride + j));
+        __m128d diff_y = _mm_sub_pd(y_i[k], _mm_load_pd(x + k * stride + j));
+        dist_x = _mm_add_pd(dist_x, _mm_mul_pd(diff_x, diff_x));
+        dist_y = _mm_add_pd(dist_y, _mm_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, std::min(lanes[0], lanes[1]));
+    _mm_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, std::min(lanes[0], lanes[1]));
+  }
+
+  return std::max(dX, dY);
+}
+
+HAUSDORFF_TARGET("avx2")
+static double hausdorff_squared_avx2(const double *x,
+                                     const double *y,
+                                     unsigned int dimension,
+                                     std::size_t numPoints,
+                                     std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(32) double lanes[4];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m256d min_dist_x = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 4)
+    {
+      __m256d dist_x = _mm256_setzero_pd();
+      __m256d dist_y = _mm256_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const double *xk = x + k * stride;
+        const double *yk = y + k * stride;
+        __m256d diff_x = _mm256_sub_pd(_mm256_set1_pd(xk[i]), _mm256_load_pd(yk + j));
+        __m256d diff_y = _mm256_sub_pd(_mm256_set1_pd(yk[i]), _mm256_load_pd(xk + j));
+        dist_x = _mm256_add_pd(dist_x, _mm256_mul_pd(diff_x, diff_x));
+        dist_y = _mm256_add_pd(dist_y, _mm256_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm256_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm256_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm256_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, *std::min_element(lanes, lanes + 4));
+    _mm256_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, *std::min_element(lanes, lanes + 4));
+  }
+
+  return std::max(dX, dY);
+}
+
+// Counterpart of `hausdorff_squared_scalar_fixed()`.
+template <unsigned int D>
+HAUSDORFF_TARGET("avx2")
+static double hausdorff_squared_avx2_fixed(const double *x,
+                                           const double *y,
+                                           unsigned int,
+                                           std::size_t numPoints,
+                                           std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(32) double lanes[4];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m256d x_i[D];
+    __m256d y_i[D];
+    for (unsigned int k = 0;k < D;++k)
+    {
+      x_i[k] = _mm256_set1_pd(x[k * stride + i]);
+      y_i[k] = _mm256_set1_pd(y[k * stride + i]);
+    }
+
+    __m256d min_dist_x = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 4)
+    {
+      __m256d dist_x = _mm256_setzero_pd();
+      __m256d dist_y = _mm256_setzero_pd();
+
+      for (unsigned int k = 0;k < D;++k)
+      {
+        __m256d diff_x = _mm256_sub_pd(x_i[k], _mm256_load_pd(y + k * stride + j));
+        __m256d diff_y = _mm256_sub_pd(y_i[k], _mm256_load_pd(x + k * stride + j));
+        dist_x = _mm256_add_pd(dist_x, _mm256_mul_pd(diff_x, diff_x));
+        dist_y = _mm256_add_pd(dist_y, _mm256_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm256_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm256_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm256_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, *std::min_element(lanes, lanes + 4));
+    _mm256_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, *std::min_element(lanes, lanes + 4));
+  }
+
+  return std::max(dX, dY);
+}
+
+HAUSDORFF_TARGET("avx512f")
+static double hausdorff_squared_avx512(const double *x,
+                                       const double *y,
+                                       unsigned int dimension,
+                                       std::size_t numPoints,
+                                       std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(64) double lanes[8];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m512d min_dist_x = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    __m512d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 8)
+    {
+      __m512d dist_x = _mm512_setzero_pd();
+      __m512d dist_y = _mm512_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const double *xk = x + k * stride;
+        const double *yk = y + k * stride;
+        __m512d diff_x = _mm512_sub_pd(_mm512_set1_pd(xk[i]), _mm512_load_pd(yk + j));
+        __m512d diff_y = _mm512_sub_pd(_mm512_set1_pd(yk[i]), _mm512_load_pd(xk + j));
+        dist_x = _mm512_add_pd(dist_x, _mm512_mul_pd(diff_x, diff_x));
+        dist_y = _mm512_add_pd(dist_y, _mm512_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm512_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm512_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm512_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, *std::min_element(lanes, lanes + 8));
+    _mm512_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, *std::min_element(lanes, lanes + 8));
+  }
+
+  return std::max(dX, dY);
+}
+
+// Counterpart of `hausdorff_squared_scalar_fixed()`.
+template <unsigned int D>
+HAUSDORFF_TARGET("avx512f")
+static double hausdorff_squared_avx512_fixed(const double *x,
+                                             const double *y,
+                                             unsigned int,
+                                             std::size_t numPoints,
+                                             std::size_t stride)
+{
+  double dX = 0.0;
+  double dY = 0.0;
+  alignas(64) double lanes[8];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m512d x_i[D];
+    __m512d y_i[D];
+    for (unsigned int k = 0;k < D;++k)
+    {
+      x_i[k] = _mm512_set1_pd(x[k * stride + i]);
+      y_i[k] = _mm512_set1_pd(y[k * stride + i]);
+    }
+
+    __m512d min_dist_x = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    __m512d min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 8)
+    {
+      __m512d dist_x = _mm512_setzero_pd();
+      __m512d dist_y = _mm512_setzero_pd();
+
+      for (unsigned int k = 0;k < D;++k)
+      {
+        __m512d diff_x = _mm512_sub_pd(x_i[k], _mm512_load_pd(y + k * stride + j));
+        __m512d diff_y = _mm512_sub_pd(y_i[k], _mm512_load_pd(x + k * stride + j));
+        dist_x = _mm512_add_pd(dist_x, _mm512_mul_pd(diff_x, diff_x));
+        dist_y = _mm512_add_pd(dist_y, _mm512_mul_pd(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm512_min_pd(min_dist_x, dist_x);
+      min_dist_y = _mm512_min_pd(min_dist_y, dist_y);
+    }
+
+    _mm512_store_pd(lanes, min_dist_x);
+    dX = std::max(dX, *std::min_element(lanes, lanes + 8));
+    _mm512_store_pd(lanes, min_dist_y);
+    dY = std::max(dY, *std::min_element(lanes, lanes + 8));
+  }
+
+  return std::max(dX, dY);
+}
+
+// The vectorized early-break passes test a whole register of squared
+// distances against the running maximum before folding it into the minimum,
+// so the scan is abandoned at the first block containing a close enough point.
+
+HAUSDORFF_TARGET("sse2")
+static double directed_early_break_sse2(const double *x,
+                                        const double *y,
+                                        unsigned int dimension,
+                                        std::size_t xNumPoints,
+                                        std::size_t xStride,
+                                        std::size_t yNumPoints,
+                                        std::size_t yStride,
+                                        double cmax,
+                                        double climit,
+                                        std::size_t *visited)
+{
+  std::size_t numVisited = 0;
+  alignas(16) double lanes[2];
+
+  for (std::size_t i = 0;i < xNumPoints;++i)
+  {
+    __m128d max_dist = _mm_set1_pd(cmax);
+    __m128d min_dist = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    bool abandoned = false;
+    std::size_t j = 0;
+
+    for (;j < yStride;j += 2)
+    {
+      __m128d dist = _mm_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        __m128d diff = _mm_sub_pd(_mm_set1_pd(x[k * xStride + i]), _mm_load_pd(y + k * yStride + j));
+        dist = _mm_add_pd(dist, _mm_mul_pd(diff, diff));
+      }
+
+      if (_mm_movemask_pd(_mm_cmple_pd(dist, max_dist)) != 0)
+      {
+        abandoned = true;
+        break;
+      }
+
+      min_dist = _mm_min_pd(min_dist, dist);
+    }
+
+    numVisited += std::min(j + 2, yNumPoints);
+    if (!abandoned)
+    {
+      _mm_store_pd(lanes, min_dist);
+      cmax = std::max(cmax, std::min(lanes[0], lanes[1]));
+      if (cmax > climit)
+        break;
+    }
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return cmax;
+}
+
+HAUSDORFF_TARGET("avx2")
+static double directed_early_break_avx2(const double *x,
+                                        const double *y,
+                                        unsigned int dimension,
+                                        std::size_t xNumPoints,
+                                        std::size_t xStride,
+                                        std::size_t yNumPoints,
+                                        std::size_t yStride,
+                                        double cmax,
+                                        double climit,
+                                        std::size_t *visited)
+{
+  std::size_t numVisited = 0;
+  alignas(32) double lanes[4];
+
+  for (std::size_t i = 0;i < xNumPoints;++i)
+  {
+    __m256d max_dist = _mm256_set1_pd(cmax);
+    __m256d min_dist = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    bool abandoned = false;
+    std::size_t j = 0;
+
+    for (;j < yStride;j += 4)
+    {
+      __m256d dist = _mm256_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        __m256d diff = _mm256_sub_pd(_mm256_set1_pd(x[k * xStride + i]), _mm256_load_pd(y + k * yStride + j));
+        dist = _mm256_add_pd(dist, _mm256_mul_pd(diff, diff));
+      }
+
+      if (_mm256_movemask_pd(_mm256_cmp_pd(dist, max_dist, _CMP_LE_OQ)) != 0)
+      {
+        abandoned = true;
+        break;
+      }
+
+      min_dist = _mm256_min_pd(min_dist, dist);
+    }
+
+    numVisited += std::min(j + 4, yNumPoints);
+    if (!abandoned)
+    {
+      _mm256_store_pd(lanes, min_dist);
+      cmax = std::max(cmax, *std::min_element(lanes, lanes + 4));
+      if (cmax > climit)
+        break;
+    }
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return cmax;
+}
+
+HAUSDORFF_TARGET("avx512f")
+static double directed_early_break_avx512(const double *x,
+                                          const double *y,
+                                          unsigned int dimension,
+                                          std::size_t xNumPoints,
+                                          std::size_t xStride,
+                                          std::size_t yNumPoints,
+                                          std::size_t yStride,
+                                          double cmax,
+                                          double climit,
+                                          std::size_t *visited)
+{
+  std::size_t numVisited = 0;
+  alignas(64) double lanes[8];
+
+  for (std::size_t i = 0;i < xNumPoints;++i)
+  {
+    __m512d max_dist = _mm512_set1_pd(cmax);
+    __m512d min_dist = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    bool abandoned = false;
+    std::size_t j = 0;
+
+    for (;j < yStride;j += 8)
+    {
+      __m512d dist = _mm512_setzero_pd();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        __m512d diff = _mm512_sub_pd(_mm512_set1_pd(x[k * xStride + i]), _mm512_load_pd(y + k * yStride + j));
+        dist = _mm512_add_pd(dist, _mm512_mul_pd(diff, diff));
+      }
+
+      if (_mm512_cmp_pd_mask(dist, max_dist, _CMP_LE_OQ) != 0)
+      {
+        abandoned = true;
+        break;
+      }
+
+      min_dist = _mm512_min_pd(min_dist, dist);
+    }
+
+    numVisited += std::min(j + 8, yNumPoints);
+    if (!abandoned)
+    {
+      _mm512_store_pd(lanes, min_dist);
+      cmax = std::max(cmax, *std::min_element(lanes, lanes + 8));
+      if (cmax > climit)
+        break;
+    }
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return cmax;
+}
+
+// Single-precision counterparts of the full scan, with twice as many lanes
+// per register.
+
+HAUSDORFF_TARGET("sse2")
+static void hausdorff_minima_f32_sse2(const float *x,
+                                      const float *y,
+                                      unsigned int dimension,
+                                      std::size_t numPoints,
+                                      std::size_t stride,
+                                      float *minima_x,
+                                      float *minima_y)
+{
+  alignas(16) float lanes[4];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m128 min_dist_x = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 4)
+    {
+      __m128 dist_x = _mm_setzero_ps();
+      __m128 dist_y = _mm_setzero_ps();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const float *xk = x + k * stride;
+        const float *yk = y + k * stride;
+        __m128 diff_x = _mm_sub_ps(_mm_set1_ps(xk[i]), _mm_load_ps(yk + j));
+        __m128 diff_y = _mm_sub_ps(_mm_set1_ps(yk[i]), _mm_load_ps(xk + j));
+        dist_x = _mm_add_ps(dist_x, _mm_mul_ps(diff_x, diff_x));
+        dist_y = _mm_add_ps(dist_y, _mm_mul_ps(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm_min_ps(min_dist_x, dist_x);
+      min_dist_y = _mm_min_ps(min_dist_y, dist_y);
+    }
+
+    _mm_store_ps(lanes, min_dist_x);
+    minima_x[i] = *std::min_element(lanes, lanes + 4);
+    _mm_store_ps(lanes, min_dist_y);
+    minima_y[i] = *std::min_element(lanes, lanes + 4);
+  }
+}
+
+HAUSDORFF_TARGET("avx2")
+static void hausdorff_minima_f32_avx2(const float *x,
+                                      const float *y,
+                                      unsigned int dimension,
+                                      std::size_t numPoints,
+                                      std::size_t stride,
+                                      float *minima_x,
+                                      float *minima_y)
+{
+  alignas(32) float lanes[8];
+
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m256 min_dist_x = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 8)
+    {
+      __m256 dist_x = _mm256_setzero_ps();
+      __m256 dist_y = _mm256_setzero_ps();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const float *xk = x + k * stride;
+        const float *yk = y + k * stride;
+        __m256 diff_x = _mm256_sub_ps(_mm256_set1_ps(xk[i]), _mm256_load_ps(yk + j));
+        __m256 diff_y = _mm256_sub_ps(_mm256_set1_ps(yk[i]), _mm256_load_ps(xk + j));
+        dist_x = _mm256_add_ps(dist_x, _mm256_mul_ps(diff_x, diff_x));
+        dist_y = _mm256_add_ps(dist_y, _mm256_mul_ps(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm256_min_ps(min_dist_x, dist_x);
+      min_dist_y = _mm256_min_ps(min_dist_y, dist_y);
+    }
+
+    _mm256_store_ps(lanes, min_dist_x);
+    minima_x[i] = *std::min_element(lanes, lanes + 8);
+    _mm256_store_ps(lanes, min_dist_y);
+    minima_y[i] = *std::min_element(lanes, lanes + 8);
+  }
+}
+
+HAUSDORFF_TARGET("avx512f")
+static void hausdorff_minima_f32_avx512(const float *x,
+                                        const float *y,
+                                        unsigned int dimension,
+                                        std::size_t numPoints,
+                                        std::size_t stride,
+                                        float *minima_x,
+                                        float *minima_y)
+{
+  for (std::size_t i = 0;i < numPoints;++i)
+  {
+    __m512 min_dist_x = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+    __m512 min_dist_y = min_dist_x;
+
+    for (std::size_t j = 0;j < stride;j += 16)
+    {
+      __m512 dist_x = _mm512_setzero_ps();
+      __m512 dist_y = _mm512_setzero_ps();
+
+      for (unsigned int k = 0;k < dimension;++k)
+      {
+        const float *xk = x + k * stride;
+        const float *yk = y + k * stride;
+        __m512 diff_x = _mm512_sub_ps(_mm512_set1_ps(xk[i]), _mm512_load_ps(yk + j));
+        __m512 diff_y = _mm512_sub_ps(_mm512_set1_ps(yk[i]), _mm512_load_ps(xk + j));
+        dist_x = _mm512_add_ps(dist_x, _mm512_mul_ps(diff_x, diff_x));
+        dist_y = _mm512_add_ps(dist_y, _mm512_mul_ps(diff_y, diff_y));
+      }
+
+      min_dist_x = _mm512_min_ps(min_dist_x, dist_x);
+      min_dist_y = _mm512_min_ps(min_dist_y, dist_y);
+    }
+
+    minima_x[i] = _mm512_reduce_min_ps(min_dist_x);
+    minima_y[i] = _mm512_reduce_min_ps(min_dist_y);
+  }
+}
+
+#endif
+
+typedef double (*HausdorffSquaredKernel)(const double *,
+                                         const double *,
+                                         unsigned int,
+                                         std::size_t,
+                                         std::size_t);
+
+typedef double (*HausdorffDirectedKernel)(const double *,
+                                          const double *,
+                                          unsigned int,
+                                          std::size_t,
+                                          std::size_t,
+                                          std::size_t,
+                                          std::size_t,
+                                          double,
+                                          double,
+                                          std::size_t *);
+
+typedef void (*HausdorffMinimaKernel)(const float *,
+                                      const float *,
+                                      unsigned int,
+                                      std::size_t,
+                                      std::size_t,
+                                      float *,
+                                      float *);
+
+// Full scan kernels of one instruction set, indexed by dimension: entry 0 is
+// the generic kernel and entry D <= HAUSDORFF_MAX_FIXED_DIMENSION the one
+// specialized on D.
+struct HausdorffKernelChoice
+{
+  HausdorffSquaredKernel kernel[HAUSDORFF_MAX_FIXED_DIMENSION + 1];
+  HausdorffDirectedKernel earlyBreak;
+  HausdorffMinimaKernel minimaFloat;
+  const char *isa;
+};
+
+// Kernels of every instruction set the CPU supports, the widest first and the
+// scalar ones last.
+static std::vector<HausdorffKernelChoice> supportedHausdorffKernels()
+{
+  std::vector<HausdorffKernelChoice> out;
+#ifdef HAUSDORFF_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    out.push_back({{hausdorff_squared_avx512, hausdorff_squared_avx512_fixed<1>,
+                    hausdorff_squared_avx512_fixed<2>, hausdorff_squared_avx512_fixed<3>},
+                   directed_early_break_avx512, hausdorff_minima_f32_avx512, "avx512f"});
+  if (__builtin_cpu_supports("avx2"))
+    out.push_back({{hausdorff_squared_avx2, hausdorff_squared_avx2_fixed<1>,
+                    hausdorff_squared_avx2_fixed<2>, hausdorff_squared_avx2_fixed<3>},
+                   directed_early_break_avx2, hausdorff_minima_f32_avx2, "avx2"});
+  if (__builtin_cpu_supports("sse2"))
+    out.push_back({{hausdorff_squared_sse2, hausdorff_squared_sse2_fixed<1>,
+                    hausdorff_squared_sse2_fixed<2>, hausdorff_squared_sse2_fixed<3>},
+                   directed_early_break_sse2, hausdorff_minima_f32_sse2, "sse2"});
+#endif
+  out.push_back({{hausdorff_squared_scalar, hausdorff_squared_scalar_fixed<1>,
+                  hausdorff_squared_scalar_fixed<2>, hausdorff_squared_scalar_fixed<3>},
+                 directed_early_break_scalar, hausdorff_minima_f32_scalar, "scalar"});
+  return out;
+}
+
+static const std::vector<HausdorffKernelChoice> &hausdorffKernels()
+{
+  static const std::vector<HausdorffKernelChoice> kernels = supportedHausdorffKernels();
+  return kernels;
+}
+
+static const HausdorffKernelChoice &hausdorffKernel()
+{
+  static const HausdorffKernelChoice &choice = hausdorffKernels().front();
+  return choice;
+}
+
+double hausdorff_squared_simd(const double *x,
+                              const double *y,
+                              unsigned int dimension,
+                              std::size_t numPoints,
+                              std::size_t stride)
+{
+  const HausdorffKernelChoice &choice = hausdorffKernel();
+  unsigned int entry = dimension <= HAUSDORFF_MAX_FIXED_DIMENSION ? dimension : 0;
+  return choice.kernel[entry](x, y, dimension, numPoints, stride);
+}
+
+double hausdorff_squared_generic(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride)
+{
+  return hausdorffKernel().kernel[0](x, y, dimension, numPoints, stride);
+}
+
+double hausdorff_squared_early_break(const double *x,
+                                     const double *y,
+                                     unsigned int dimension,
+                                     std::size_t numPoints,
+                                     std::size_t stride,
+                                     double limit,
+                                     std::size_t *visited)
+{
+  HausdorffDirectedKernel directed = hausdorffKernel().earlyBreak;
+  double cmax = directed(x, y, dimension, numPoints, stride, numPoints, stride, 0.0, limit, visited);
+  if (cmax > limit)
+    return cmax;
+  return directed(y, x, dimension, numPoints, stride, numPoints, stride, cmax, limit, visited);
+}
+
+double hausdorff_squared_ragged(const RaggedCurvePlanes &x,
+                                std::size_t i,
+                                const RaggedCurvePlanes &y,
+                                std::size_t j,
+                                double limit)
+{
+  HausdorffDirectedKernel directed = hausdorffKernel().earlyBreak;
+  const double *xCurve = x.curve(i);
+  const double *yCurve = y.curve(j);
+  unsigned int dimension = x.dimension();
+
+  double cmax = directed(xCurve, yCurve, dimension, x.numPoints(i), x.stride(i), y.numPoints(j), y.stride(j), 0.0, limit,
+                         nullptr);
+  if (cmax > limit)
+    return cmax;
+  return directed(yCurve, xCurve, dimension, y.numPoints(j), y.stride(j), x.numPoints(i), x.stride(i), cmax, limit,
+                  nullptr);
+}
+
+double hausdorff_directed_squared_ragged(const RaggedCurvePlanes &x,
+                                         std::size_t i,
+                                         const RaggedCurvePlanes &y,
+                                         std::size_t j)
+{
+  HausdorffDirectedKernel directed = hausdorffKernel().earlyBreak;
+  return directed(x.curve(i), y.curve(j), x.dimension(), x.numPoints(i), x.stride(i),
+                  y.numPoints(j), y.stride(j), 0.0, std::numeric_limits<double>::infinity(), nullptr);
+}
+
+// Coordinates beyond this magnitude are handed to the double kernel, far
+// before single-precision squared distances could overflow.
+static const double MIXED_PRECISION_MAX_MAGNITUDE = 1e15;
+
+// Bound on the absolute error of a squared distance computed in single
+// precision (rounded coordinates, then D differences, squares and sums, with
+// separate multiplications and additions) between two points whose
+// coordinates do not exceed `magnitude` in absolute value. The last factor
+// absorbs the rounding of the bound itself.
+static double mixedPrecisionErrorBound(double magnitude, unsigned int dimension)
+{
+  const double u = std::ldexp(1.0, -24);
+  const double tiny = std::ldexp(1.0, -149);
+  double diffError = 4.0 * u * magnitude * (1.0 + u) + 3.0 * tiny;
+  double diffBound = 2.0 * magnitude + diffError;
+  double squareError = diffError * (4.0 * magnitude + diffError) + u * diffBound * diffBound + tiny;
+  double sumBound = dimension * (diffBound * diffBound * (1.0 + u) + tiny);
+  double gamma = (dimension - 1.0) * u / (1.0 - (dimension - 1.0) * u);
+  return (dimension * squareError + gamma * sumBound) * (1.0 + 1e-6);
+}
+
+// Exact squared distance in double from the i-th point of `x` to its nearest
+// point of `y`, computed as in the double kernels. The scan stops once the
+// minimum is no larger than `cmax`, in which case only `min <= cmax` matters.
+// The number of points of `y` scanned is added to `visited`.
+static double nearestSquared(const double *x,
+                             const double *y,
+                             std::size_t i,
+                             unsigned int dimension,
+                             std::size_t numPoints,
+                             std::size_t stride,
+                             double cmax,
+                             std::size_t &visited)
+{
+  double min_dist = std::numeric_limits<double>::infinity();
+  std::size_t j = 0;
+
+  for (;j < numPoints;++j)
+  {
+    double dist = 0.0;
+
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      double diff = x[k * stride + i] - y[k * stride + j];
+      dist += diff * diff;
+    }
+
+    min_dist = std::min(min_dist, dist);
+    if (min_dist <= cmax)
+      break;
+  }
+
+  visited += std::min(j + 1, numPoints);
+  return min_dist;
+}
+
+double hausdorff_squared_mixed(const CurvePlanes &x,
+                               const FloatCurvePlanes &xFloat,
+                               std::size_t i,
+                               const CurvePlanes &y,
+                               const FloatCurvePlanes &yFloat,
+                               std::size_t j,
+                               std::size_t *visited)
+{
+  unsigned int dimension = x.dimension();
+  std::size_t numPoints = x.numPoints();
+  std::size_t stride = x.stride();
+  const double *xCurve = x.curve(i);
+  const double *yCurve = y.curve(j);
+  double magnitude = std::max(xFloat.magnitude(i), yFloat.magnitude(j));
+
+  std::size_t numVisited = 2 * numPoints * numPoints;
+  if (numPoints == 0 || magnitude > MIXED_PRECISION_MAX_MAGNITUDE)
+  {
+    if (visited)
+      *visited += numVisited;
+    return hausdorff_squared_simd(xCurve, yCurve, dimension, numPoints, stride);
+  }
+
+  // Single-precision nearest distances of the points of x, then of y.
+  std::vector<float> minima(2 * numPoints);
+  hausdorffKernel().minimaFloat(xFloat.curve(i), yFloat.curve(j), dimension, numPoints, xFloat.stride(),
+                                minima.data(), minima.data() + numPoints);
+
+  // Every single-precision minimum is within `bound` of the exact one, so the
+  // points achieving the exact maximum are within twice `bound` of the
+  // single-precision maximum.
+  double bound = mixedPrecisionErrorBound(magnitude, dimension);
+  double threshold = *std::max_element(minima.begin(), minima.end()) - 2.0 * bound;
+  double dist = 0.0;
+
+  for (std::size_t p = 0;p < numPoints;++p)
+  {
+    if (minima[p] >= threshold)
+      dist = std::max(dist, nearestSquared(xCurve, yCurve, p, dimension, numPoints, stride, dist, numVisited));
+    if (minima[numPoints + p] >= threshold)
+      dist = std::max(dist, nearestSquared(yCurve, xCurve, p, dimension, numPoints, stride, dist, numVisited));
+  }
+
+  if (visited)
+    *visited += numVisited;
+  return dist;
+}
+
+double hausdorff_distance_simd(const CurvePlanes &curves,
+                               std::size_t i,
+                               std::size_t j,
+                               HausdorffAlgorithm algorithm)
+{
+  const double *x = curves.curve(i);
+  const double *y = curves.curve(j);
+  double dist = 0.0;
+
+  switch (algorithm)
+  {
+  case HAUSDORFF_EARLY_BREAK:
+    dist = hausdorff_squared_early_break(x, y, curves.dimension(), curves.numPoints(), curves.stride());
+    break;
+  default:
+    dist = hausdorff_squared_simd(x, y, curves.dimension(), curves.numPoints(), curves.stride());
+    break;
+  }
+
+  return std::sqrt(dist);
+}
+
+static void shufflePlanes(double *curve,
+                          unsigned int dimension,
+                          std::size_t numPoints,
+                          std::size_t stride,
+                          unsigned int seed)
+{
+  std::vector<std::size_t> order(numPoints);
+  std::vector<double> work(numPoints);
+
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+
+  for (unsigned int k = 0;k < dimension;++k)
+  {
+    double *plane = curve + k * stride;
+    for (std::size_t p = 0;p < numPoints;++p)
+      work[p] = plane[order[p]];
+    std::copy(work.begin(), work.end(), plane);
+  }
+}
+
+void shuffleCurvePoints(CurvePlanes &curves,
+                        std::size_t i,
+                        unsigned int seed)
+{
+  shufflePlanes(curves.curve(i), curves.dimension(), curves.numPoints(), curves.stride(), seed + i);
+  curves.pad(i);
+}
+
+void shuffleCurvePoints(RaggedCurvePlanes &curves,
+                        std::size_t i,
+                        unsigned int seed)
+{
+  shufflePlanes(curves.curve(i), curves.dimension(), curves.numPoints(i), curves.stride(i), seed + i);
+  curves.pad(i);
+}
+
+const char *hausdorff_simd_isa()
+{
+  return hausdorffKernel().isa;
+}
+
+std::size_t hausdorff_simd_num_isas()
+{
+  return hausdorffKernels().size();
+}
+
+const char *hausdorff_simd_isa(std::size_t n)
+{
+  return hausdorffKernels()[n].isa;
+}
+
+double hausdorff_squared_isa(std::size_t n,
+                             const double *x,
+                             const double *y,
+                             unsigned int dimension,
+                             std::size_t numPoints,
+                             std::size_t stride,
+                             bool fixed)
+{
+  const HausdorffKernelChoice &choice = hausdorffKernels()[n];
+  unsigned int entry = fixed && dimension <= HAUSDORFF_MAX_FIXED_DIMENSION ? dimension : 0;
+  return choice.kernel[entry](x, y, dimension, numPoints, stride);
+}
+
+double hausdorff_squared_early_break_isa(std::size_t n,
+                                         const double *x,
+                                         const double *y,
+                                         unsigned int dimension,
+                                         std::size_t numPoints,
+                                         std::size_t stride)
+{
+  HausdorffDirectedKernel directed = hausdorffKernels()[n].earlyBreak;
+  double limit = std::numeric_limits<double>::infinity();
+  double cmax = directed(x, y, dimension, numPoints, stride, numPoints, stride, 0.0, limit, nullptr);
+  return directed(y, x, dimension, numPoints, stride, numPoints, stride, cmax, limit, nullptr);
+}
@@ -0,0 +1,268 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Number of doubles in a 64-byte cache line. Every coordinate plane is padded
+// to a multiple of this so that the widest SIMD kernel never needs a
+// remainder loop.
+const std::size_t CURVE_PLANE_ALIGNMENT = 8;
+
+// Number of floats in a 64-byte cache line, for the single-precision planes.
+const std::size_t FLOAT_CURVE_PLANE_ALIGNMENT = 16;
+
+struct AlignedDeleter
+{
+  void operator()(double *ptr) const;
+  void operator()(float *ptr) const;
+};
+
+// A sample of curves stored as 64-byte aligned, padded coordinate planes.
+//
+// Curve `i` occupies `dimension` consecutive planes of `stride()` doubles,
+// plane `k` holding the `k`-th coordinate of its `numPoints` points. The
+// padding slots replicate the last point of the curve, which leaves every
+// nearest-neighbour search unchanged.
+class CurvePlanes
+{
+public:
+  CurvePlanes(std::size_t numCurves,
+              unsigned int dimension,
+              std::size_t numPoints);
+
+  std::size_t size() const { return m_NumCurves; }
+  unsigned int dimension() const { return m_Dimension; }
+  std::size_t numPoints() const { return m_NumPoints; }
+  std::size_t stride() const { return m_Stride; }
+
+  double *curve(std::size_t i)
+  {
+    return m_Data.get() + i * m_Dimension * m_Stride;
+  }
+
+  const double *curve(std::size_t i) const
+  {
+    return m_Data.get() + i * m_Dimension * m_Stride;
+  }
+
+  // Fills the padding slots of curve `i` once its points have been written.
+  void pad(std::size_t i);
+
+private:
+  std::size_t m_NumCurves;
+  unsigned int m_Dimension;
+  std::size_t m_NumPoints;
+  std::size_t m_Stride;
+  std::unique_ptr<double[], AlignedDeleter> m_Data;
+};
+
+// A sample of curves with different numbers of points, stored as one buffer
+// of values and the offsets of the curves in it.
+//
+// Curve `i` occupies `dimension` consecutive planes of `stride(i)` doubles,
+// laid out and padded as in `CurvePlanes`, so that the kernels can run on any
+// pair of curves.
+class RaggedCurvePlanes
+{
+public:
+  RaggedCurvePlanes(const std::vector<std::size_t> &numPoints,
+                    unsigned int dimension);
+
+  std::size_t size() const { return m_NumPoints.size(); }
+  unsigned int dimension() const { return m_Dimension; }
+  std::size_t numPoints(std::size_t i) const { return m_NumPoints[i]; }
+  const std::vector<std::size_t> &numPoints() const { return m_NumPoints; }
+  std::size_t stride(std::size_t i) const { return m_Offsets[i + 1] - m_Offsets[i]; }
+
+  double *curve(std::size_t i)
+  {
+    return m_Data.get() + m_Offsets[i] * m_Dimension;
+  }
+
+  const double *curve(std::size_t i) const
+  {
+    return m_Data.get() + m_Offsets[i] * m_Dimension;
+  }
+
+  // Fills the padding slots of curve `i` once its points have been written.
+  void pad(std::size_t i);
+
+private:
+  unsigned int m_Dimension;
+  std::vector<std::size_t> m_NumPoints;
+  // Start of each curve in padded points, followed by the total.
+  std::vector<std::size_t> m_Offsets;
+  std::unique_ptr<double[], AlignedDeleter> m_Data;
+};
+
+// Single-precision copy of a sample of curves, used by the mixed precision
+// kernel. Planes are laid out as in `CurvePlanes` but padded to a multiple of
+// 16 floats. The largest absolute coordinate of each curve is kept to bound
+// the rounding errors of single-precision distances.
+class FloatCurvePlanes
+{
+public:
+  FloatCurvePlanes(std::size_t numCurves,
+                   unsigned int dimension,
+                   std::size_t numPoints);
+
+  std::size_t stride() const { return m_Stride; }
+
+  const float *curve(std::size_t i) const
+  {
+    return m_Data.get() + i * m_Dimension * m_Stride;
+  }
+
+  double magnitude(std::size_t i) const { return m_Magnitudes[i]; }
+
+  // Rounds the i-th curve of `curves` to single precision. Distinct curves
+  // can be assigned concurrently.
+  void assign(std::size_t i, const CurvePlanes &curves);
+
+private:
+  unsigned int m_Dimension;
+  std::size_t m_NumPoints;
+  std::size_t m_Stride;
+  std::unique_ptr<float[], AlignedDeleter> m_Data;
+  std::unique_ptr<double[]> m_Magnitudes;
+};
+
+enum HausdorffAlgorithm
+{
+  // Full scan of all pairs of points.
+  HAUSDORFF_NAIVE,
+  // Exact early-break scan of Taha & Hanbury (2015), best on shuffled points.
+  HAUSDORFF_EARLY_BREAK,
+  // Early-break nearest neighbour queries against per-curve k-d trees
+  // (see `HausdorffSample`).
+  HAUSDORFF_KDTREE
+};
+
+// Largest dimension with a full scan kernel specialized at compile time.
+const unsigned int HAUSDORFF_MAX_FIXED_DIMENSION = 3;
+
+// Squared Hausdorff distance between two curves stored as padded planes.
+// The instruction set (AVX-512, AVX2, SSE2 or plain scalar code) is picked
+// once at runtime, and curves of dimension up to
+// `HAUSDORFF_MAX_FIXED_DIMENSION` use a kernel specialized on it. Squared
+// distances are accumulated in the same order and without fused multiply-add
+// so that the result is bit-for-bit identical to the scalar kernel of
+// `hausdorff_distance_cpp()`.
+double hausdorff_squared_simd(const double *x,
+                              const double *y,
+                              unsigned int dimension,
+                              std::size_t numPoints,
+                              std::size_t stride);
+
+// Generic kernel of `hausdorff_squared_simd()`, with the dimension known at
+// runtime only. Used to measure the gain of the specialized kernels.
+double hausdorff_squared_generic(const double *x,
+                                 const double *y,
+                                 unsigned int dimension,
+                                 std::size_t numPoints,
+                                 std::size_t stride);
+
+// Same as `hausdorff_squared_simd()` but each inner scan stops as soon as it
+// finds a point closer than the running maximum. The result is exact and
+// independent of the order of the points, but the earlier a close point is
+// met, the more work is saved: use it on curves shuffled by
+// `shuffleCurvePoints()`, since consecutive points of smooth curves are close
+// to each other and therefore poor early-break candidates.
+// The scan is abandoned as soon as the result is known to exceed `limit`, in
+// which case the returned value is larger than `limit` but not necessarily
+// the distance. If `visited` is not null, the number of distances between
+// points computed is added to it.
+double hausdorff_squared_early_break(const double *x,
+                                     const double *y,
+                                     unsigned int dimension,
+                                     std::size_t numPoints,
+                                     std::size_t stride,
+                                     double limit = std::numeric_limits<double>::infinity(),
+                                     std::size_t *visited = nullptr);
+
+enum HausdorffPrecision
+{
+  // All computations in double precision.
+  HAUSDORFF_DOUBLE,
+  // Nearest neighbour search in single precision, refined in double.
+  HAUSDORFF_MIXED
+};
+
+// Squared Hausdorff distance between the i-th curve of `x` and the j-th curve
+// of `y`, searching nearest neighbours on their single-precision copies with
+// twice as many SIMD lanes. The rounding errors of single-precision squared
+// distances are bounded from the magnitude of the coordinates, and every point
+// whose single-precision nearest distance is within twice this bound of the
+// maximum is recomputed in double. The result is therefore exactly the one of
+// `hausdorff_squared_simd()`. Curves with coordinates too large for single
+// precision fall back to the double kernel. If `visited` is not null, the
+// number of distances between points computed, in single and in double
+// precision, is added to it.
+double hausdorff_squared_mixed(const CurvePlanes &x,
+                               const FloatCurvePlanes &xFloat,
+                               std::size_t i,
+                               const CurvePlanes &y,
+                               const FloatCurvePlanes &yFloat,
+                               std::size_t j,
+                               std::size_t *visited = nullptr);
+
+// Squared Hausdorff distance between the i-th curve of `x` and the j-th curve
+// of `y`, which may have different numbers of points, with the early-break
+// passes of `hausdorff_squared_early_break()` and the same `limit`.
+double hausdorff_squared_ragged(const RaggedCurvePlanes &x,
+                                std::size_t i,
+                                const RaggedCurvePlanes &y,
+                                std::size_t j,
+                                double limit = std::numeric_limits<double>::infinity());
+
+// Squared directed Hausdorff distance from the i-th curve of `x` to the j-th
+// curve of `y`: the largest squared distance from a point of the first curve
+// to its nearest point on the second one.
+double hausdorff_directed_squared_ragged(const RaggedCurvePlanes &x,
+                                         std::size_t i,
+                                         const RaggedCurvePlanes &y,
+                                         std::size_t j);
+
+double hausdorff_distance_simd(const CurvePlanes &curves,
+                               std::size_t i,
+                               std::size_t j,
+                               HausdorffAlgorithm algorithm = HAUSDORFF_NAIVE);
+
+// Randomly permutes the points of the i-th curve, reproducibly for a given
+// seed.
+void shuffleCurvePoints(CurvePlanes &curves,
+                        std::size_t i,
+                        unsigned int seed = 1234);
+
+void shuffleCurvePoints(RaggedCurvePlanes &curves,
+                        std::size_t i,
+                        unsigned int seed = 1234);
+
+// Name of the instruction set selected by the runtime dispatcher.
+const char *hausdorff_simd_isa();
+
+// Number of instruction sets whose kernels can run on this CPU, the one
+// selected by the runtime dispatcher first and plain scalar code last, and
+// name of the n-th one.
+std::size_t hausdorff_simd_num_isas();
+const char *hausdorff_simd_isa(std::size_t n);
+
+// Same as `hausdorff_squared_simd()`, or `hausdorff_squared_generic()` if
+// `fixed` is false, and as `hausdorff_squared_early_break()` without limit,
+// but with the kernels of the n-th instruction set, so that they can be
+// checked against each other.
+double hausdorff_squared_isa(std::size_t n,
+                             const double *x,
+                             const double *y,
+                             unsigned int dimension,
+                             std::size_t numPoints,
+                             std::size_t stride,
+                             bool fixed = true);
+
+double hausdorff_squared_early_break_isa(std::size_t n,
+                                         const double *x,
+                                         const double *y,
+                                         unsigned int dimension,
+                                         std::size_t numPoints,
+                                         std::size_t stride);
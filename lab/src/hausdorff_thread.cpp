@@ -1,27 +1,384 @@
+#include "curve_metrics.h"
+#include "dist_job.h"
+#include "dist_profile.h"
 #include "hausdorff_utils.h"
 
 // [[Rcpp::plugins(cpp11)]]
 // [[Rcpp::depends(RcppThread)]]
 #include <RcppThread.h>
 
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+// The pool of the backend, kept between calls so that small inputs do not pay
+// for starting and joining `ncores` threads every time. It is recreated when
+// `ncores` changes, and its threads are joined when the code is unloaded.
+static RcppThread::ThreadPool &threadPool(unsigned int ncores)
+{
+  static std::unique_ptr<RcppThread::ThreadPool> pool;
+  static unsigned int poolSize = 0;
+
+  if (!pool || poolSize != ncores)
+  {
+    if (pool)
+      pool->join();
+    pool.reset(new RcppThread::ThreadPool(ncores));
+    poolSize = ncores;
+  }
+  return *pool;
+}
+
+// Waits for the tasks pushed to `pool`. `wait()` raises a user interrupt as an
+// exception while tasks may still be queued or running, and these refer to
+// the locals of the caller: they are told to return early through `cancelled`
+// and drained before the exception leaves, so that none is left either for
+// the next call.
+static void waitForPool(RcppThread::ThreadPool &pool, std::atomic<bool> &cancelled)
+{
+  try
+  {
+    pool.wait();
+  }
+  catch (...)
+  {
+    cancelled.store(true, std::memory_order_relaxed);
+    for (;;)
+    {
+      try
+      {
+        pool.wait();
+        break;
+      }
+      catch (...) {}
+    }
+    throw;
+  }
+}
+
+// Prepares the curves and calls `write(k, distance)` for each pair, where `k`
+// is the position of the pair in the `dist` vector. The pairs are scheduled
+// in tiles of `tileSize` curves, or of `defaultTileSize()` curves if it is 0,
+// and each tile runs through `profiler` (see `dist_profile.h`).
+template <typename Sample, typename Writer, typename Profiler = NoProfiler>
+void dist_thread(Sample &xSample,
+                 Writer write,
+                 unsigned int ncores,
+                 std::size_t tileSize = 0,
+                 Profiler profiler = Profiler())
+{
+  std::atomic<bool> cancelled(false);
+  auto prepare = [&xSample, &cancelled] (std::size_t i) {
+    if (!cancelled.load(std::memory_order_relaxed))
+      xSample.prepare(i);
+  };
+
+  RcppThread::ThreadPool &pool = threadPool(ncores);
+  pool.parallelFor(0, xSample.size(), prepare);
+  waitForPool(pool, cancelled);
+
+  PairTiling tiling(xSample.size(), tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+
+  auto task = [&xSample, &write, &tiling, &profiler, &cancelled] (std::size_t t) {
+    if (cancelled.load(std::memory_order_relaxed))
+      return;
+    profiler([&xSample, &write, &tiling, &profiler, t] {
+      std::size_t numPairs = 0;
+      tiling.forEachPair(t, [&xSample, &write, &profiler, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+        write(k, profiler.distance(xSample, i, j));
+        ++numPairs;
+      });
+      return numPairs;
+    });
+  };
+
+  pool.parallelFor(0, tiling.size(), task, tiling.size());
+  waitForPool(pool, cancelled);
+}
+
+// Runs `task(t)` for t in [0, numThreads), each on a thread of its own, and
+// joins them. The first exception thrown by a task is rethrown once all of
+// them have returned.
+template <typename Task>
+static void runOnDistinctThreads(std::size_t numThreads, Task task)
+{
+  std::vector<std::exception_ptr> errors(numThreads);
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads);
+
+  try
+  {
+    for (std::size_t t = 0;t < numThreads;++t)
+    {
+      threads.emplace_back([&task, &errors, t] {
+        try
+        {
+          task(t);
+        }
+        catch (...)
+        {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+  }
+  catch (...)
+  {
+    for (std::size_t t = 0;t < threads.size();++t)
+      threads[t].join();
+    throw;
+  }
+
+  for (std::size_t t = 0;t < numThreads;++t)
+    threads[t].join();
+  for (std::size_t t = 0;t < numThreads;++t)
+  {
+    if (errors[t])
+      std::rethrow_exception(errors[t]);
+  }
+}
+
+// See `dist_omp_placed()`. The workers of the pool take tasks in turn, so
+// that one of them may run the tasks of several threads of `placement` and
+// leave its node without a thread: each thread of `placement` runs instead
+// on a thread of its own, started for the call. A user interrupt is raised
+// once they have all returned.
+template <typename Writer>
+void dist_thread_placed(HausdorffSample &xSample,
+                        Writer write,
+                        const ThreadPlacement &placement,
+                        std::size_t tileSize = 0)
+{
+  xSample.placeCurves(placement);
+  std::size_t numThreads = placement.numThreads();
+
+  runOnDistinctThreads(numThreads, [&xSample, &placement] (std::size_t t) {
+    preparePlacedCurves(xSample, placement, t);
+  });
+
+  PairTiling tiling(xSample.size(), tileSize > 0 ? tileSize : defaultTileSize(xSample.curveBytes()));
+  NodeLocalTiles tiles(tiling, xSample.size(), placement.numNodes());
+
+  runOnDistinctThreads(numThreads, [&xSample, &write, &tiling, &tiles, &placement] (std::size_t t) {
+    computePlacedTiles(xSample, tiling, tiles, placement, t, write);
+  });
+  RcppThread::checkUserInterrupt();
+}
+
+// Same as `dist_omp_job()`, but the calling thread does not run tiles: it
+// polls the job until the workers of the pool have visited all of them.
+template <typename Sample>
+void dist_thread_job(Sample &xSample, DistJob &job, unsigned int ncores)
+{
+  std::atomic<bool> cancelled(false);
+  auto prepare = [&xSample, &cancelled] (std::size_t i) {
+    if (!cancelled.load(std::memory_order_relaxed))
+      xSample.prepare(i);
+  };
+
+  RcppThread::ThreadPool &pool = threadPool(ncores);
+  pool.parallelFor(0, xSample.size(), prepare);
+  waitForPool(pool, cancelled);
+
+  const PairTiling &tiling = job.tiling();
+  DistFile &outFile = job.file();
+
+  auto task = [&xSample, &job, &tiling, &outFile, &cancelled] (std::size_t t) {
+    if (cancelled.load(std::memory_order_relaxed))
+      return;
+    job.run(t, [&xSample, &tiling, &outFile, t] {
+      std::size_t numPairs = 0;
+      tiling.forEachPair(t, [&xSample, &outFile, &numPairs] (std::size_t i, std::size_t j, std::size_t k) {
+        outFile.set(k, xSample.distance(i, j));
+        ++numPairs;
+      });
+      return numPairs;
+    });
+  };
+
+  pool.parallelFor(0, tiling.size(), task, tiling.size());
+  while (job.tilesVisited() < tiling.size())
+  {
+    job.poll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  waitForPool(pool, cancelled);
+}
+
+template <typename Sample, typename Profiler = NoProfiler>
+Rcpp::NumericVector dist_thread_vector(Sample &xSample,
+                                       unsigned int ncores,
+                                       std::size_t tileSize,
+                                       const char *method,
+                                       Profiler profiler = Profiler())
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_thread(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, ncores, tileSize, profiler);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = method;
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_thread_placed(HausdorffSample &xSample,
+                                       const ThreadPlacement &placement)
+{
+  std::size_t N = xSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+  RcppParallel::RVector<double> outSafe(out);
+
+  dist_thread_placed(xSample, [&outSafe] (std::size_t k, double value) {
+    outSafe[k] = value;
+  }, placement);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = Rcpp::seq(1, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+Rcpp::NumericVector dist_thread(HausdorffSample &xSample,
+                                unsigned int ncores = 1,
+                                std::size_t tileSize = 0)
+{
+  return dist_thread_vector(xSample, ncores, tileSize, "hausdorff");
+}
+
 Rcpp::NumericVector dist_thread(Rcpp::NumericMatrix x,
                                 unsigned int dimension = 1,
-                                unsigned int ncores = 1)
+                                unsigned int ncores = 1,
+                                std::string algorithm = "naive",
+                                std::string precision = "double")
+{
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffSample xSample(packCurves(x, dimension), hausdorffAlgorithm,
+                          parseHausdorffPrecision(precision, hausdorffAlgorithm));
+  return dist_thread(xSample, ncores);
+}
+
+// See `dist_omp()` for `profile` and `affinity`.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_thread(SEXP x,
+                                unsigned int dimension = 1,
+                                unsigned int ncores = 1,
+                                std::string algorithm = "naive",
+                                std::string precision = "double",
+                                bool profile = false,
+                                std::string affinity = "none")
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  ThreadPlacement placement = parseThreadPlacement(affinity, ncores);
+  if (placement.isPinned())
+  {
+    if (profile)
+      Rcpp::stop("Profiling is not available with pinned threads. Use affinity = 'none'.");
+    return dist_thread_placed(*xSample, placement);
+  }
+
+  if (!profile)
+    return dist_thread(*xSample, ncores);
+
+  DistProfile distProfile;
+  DistProfiler profiler = {&distProfile};
+  Rcpp::NumericVector out = dist_thread_vector(*xSample, ncores, 0, "hausdorff", profiler);
+  out.attr("profile") = distProfile.summary();
+  return out;
+}
+
+// Out-of-core variant: the distances are written to the memory-mapped file
+// `file` as float64 or float32 and a handle to it is returned.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_thread_file(SEXP x,
+                                      std::string file,
+                                      unsigned int dimension = 1,
+                                      unsigned int ncores = 1,
+                                      std::string algorithm = "naive",
+                                      std::string type = "float64",
+                                      std::string precision = "double")
 {
-  unsigned int N = x.nrow();
-  unsigned int K = N * (N - 1) / 2;
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  Rcpp::XPtr<DistFile> out = createDistFile(file, xSample->size(), type);
+  DistFile &outFile = *out;
+
+  dist_thread(*xSample, [&outFile] (std::size_t k, double value) {
+    outFile.set(k, value);
+  }, ncores);
+
+  outFile.flush();
+  return out;
+}
+
+// Resumable variant of `dist_thread_file()` for long computations (see
+// `dist_job.h`): the tiles done are checkpointed in `<file>.ckpt` every
+// `checkpoint` seconds, and a later call with the same curves and arguments
+// only computes the remaining ones. The computation stops cleanly on a user
+// interrupt or after `time_limit` seconds (never if 0), and prints its
+// progress if `display_progress` is true.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_thread_job(SEXP x,
+                                     std::string file,
+                                     unsigned int dimension = 1,
+                                     unsigned int ncores = 1,
+                                     std::string algorithm = "naive",
+                                     std::string type = "float64",
+                                     std::string precision = "double",
+                                     double checkpoint = 60,
+                                     double time_limit = 0,
+                                     bool display_progress = false)
+{
+  Rcpp::XPtr<HausdorffSample> xSample = asHausdorffSample(x, dimension, algorithm, precision, ncores);
+  PairTiling tiling(xSample->size(), defaultTileSize(xSample->curveBytes()));
+
+  DistJobOptions options;
+  options.checkpointSeconds = checkpoint;
+  options.timeLimit = time_limit;
+  options.displayProgress = display_progress;
+  DistJob job(file, tiling, xSample->size(), parseDistValueType(type), sampleFingerprint(*xSample), options);
+
+  dist_thread_job(*xSample, job, ncores);
+  job.finish();
+  return dist_file_open(file);
+}
+
+// Curves with different numbers of points: the pairs are split into tasks of
+// similar cost, sorted most expensive first, and each task is its own batch so
+// that the thread pool takes them in that order.
+Rcpp::NumericVector dist_thread_ragged(const RaggedCurvePlanes &curves, unsigned int ncores = 1)
+{
+  std::size_t N = curves.size();
+  std::size_t K = N * (N - 1) / 2;
   Rcpp::NumericVector out(K);
-  RcppParallel::RMatrix<double> xSafe(x);
   RcppParallel::RVector<double> outSafe(out);
 
-  auto task = [&xSafe, &outSafe, &dimension] (unsigned int k) {
-    unsigned int N = xSafe.nrow();
-    unsigned int i = N - 2 - std::floor(std::sqrt(-8 * k + 4 * N * (N - 1) - 7) / 2.0 - 0.5);
-    unsigned int j = k + i + 1 - N * (N - 1) / 2 + (N - i) * ((N - i) - 1) / 2;
-    outSafe[k] = hausdorff_distance_cpp(xSafe.row(i), xSafe.row(j), dimension);
+  CostOrderedPairs tasks = raggedPairTasks(curves, ncores);
+
+  std::atomic<bool> cancelled(false);
+  auto task = [&curves, &outSafe, &tasks, &cancelled] (std::size_t t) {
+    if (cancelled.load(std::memory_order_relaxed))
+      return;
+    tasks.forEachPair(t, [&curves, &outSafe] (std::size_t i, std::size_t j, std::size_t k) {
+      outSafe[k] = std::sqrt(hausdorff_squared_ragged(curves, i, curves, j));
+    });
   };
 
-  RcppThread::parallelFor(0, K, task, ncores);
+  RcppThread::ThreadPool &pool = threadPool(ncores);
+  pool.parallelFor(0, tasks.size(), task, tasks.size());
+  waitForPool(pool, cancelled);
 
   out.attr("Size") = N;
   out.attr("Labels") = Rcpp::seq(1, N);
@@ -32,11 +389,36 @@ Rcpp::NumericVector dist_thread(Rcpp::NumericMatrix x,
   return out;
 }
 
+// `x` is a list of D x P_i curves with different numbers of points P_i, or
+// curves packed by `pack_ragged_curves()`.
 // [[Rcpp::export]]
-Rcpp::NumericVector dist_thread(Rcpp::List x,
-                                unsigned int dimension = 1,
-                                unsigned int ncores = 1)
+Rcpp::NumericVector dist_thread_ragged(SEXP x,
+                                       unsigned int dimension = 1,
+                                       unsigned int ncores = 1)
+{
+  Rcpp::XPtr<RaggedCurvePlanes> curves = asRaggedCurves(x, dimension, ncores);
+  return dist_thread_ragged(*curves, ncores);
+}
+
+struct ThreadMetricDist
+{
+  unsigned int m_NumCores;
+
+  template <typename Sample>
+  Rcpp::NumericVector operator()(Sample &xSample) const
+  {
+    return dist_thread_vector(xSample, m_NumCores, 0, xSample.method());
+  }
+};
+
+// Same as `dist_omp_metric()` with the RcppThread backend.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_thread_metric(Rcpp::List x,
+                                       std::string metric = "frechet",
+                                       unsigned int dimension = 1,
+                                       unsigned int ncores = 1,
+                                       int window = -1)
 {
-  Rcpp::NumericMatrix xMatrix = listToMatrix(x);
-  return dist_thread(xMatrix, dimension, ncores);
+  ThreadMetricDist backend = {ncores};
+  return distWithMetric(packCurves(x, dimension, ncores), parseCurveMetric(metric), window, backend);
 }
@@ -0,0 +1,156 @@
+#include "hausdorff_utils.h"
+
+// Fills the pairs of an enlarged `dist` vector that involve at least one new
+// curve. The first tasks are the tiles of the old x new rectangle, the
+// remaining ones the tiles of the new x new triangle.
+struct DistUpdater : public RcppParallel::Worker
+{
+  const HausdorffSample &m_OldCurves;
+  const HausdorffSample &m_NewCurves;
+  const PairTiling &m_NewTiling;
+  RcppParallel::RVector<double> m_SafeOutput;
+  std::size_t m_TileSize;
+  std::size_t m_NumOldTiles;
+  std::size_t m_NumCrossTiles;
+  std::size_t m_NumCurves;
+
+  DistUpdater(const HausdorffSample &oldCurves,
+              const HausdorffSample &newCurves,
+              const PairTiling &newTiling,
+              Rcpp::NumericVector out)
+    : m_OldCurves(oldCurves), m_NewCurves(newCurves), m_NewTiling(newTiling),
+      m_SafeOutput(out), m_TileSize(newTiling.tileSize()),
+      m_NumOldTiles((oldCurves.size() + m_TileSize - 1) / m_TileSize),
+      m_NumCrossTiles(m_NumOldTiles * ((newCurves.size() + m_TileSize - 1) / m_TileSize)),
+      m_NumCurves(oldCurves.size() + newCurves.size()) {}
+
+  std::size_t size() const { return m_NumCrossTiles + m_NewTiling.size(); }
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    std::size_t numOld = m_OldCurves.size();
+
+    for (std::size_t t = begin;t < end;++t)
+    {
+      if (t >= m_NumCrossTiles)
+      {
+        m_NewTiling.forEachPair(t - m_NumCrossTiles, [this, numOld] (std::size_t a, std::size_t b, std::size_t) {
+          m_SafeOutput[pairIndex(numOld + a, numOld + b, m_NumCurves)] = m_NewCurves.distance(a, b);
+        });
+        continue;
+      }
+
+      std::size_t rowStart = (t % m_NumOldTiles) * m_TileSize;
+      std::size_t rowEnd = std::min(rowStart + m_TileSize, numOld);
+      std::size_t colStart = (t / m_NumOldTiles) * m_TileSize;
+      std::size_t colEnd = std::min(colStart + m_TileSize, m_NewCurves.size());
+
+      for (std::size_t i = rowStart;i < rowEnd;++i)
+      {
+        std::size_t k = pairIndex(i, numOld + colStart, m_NumCurves);
+        for (std::size_t b = colStart;b < colEnd;++b, ++k)
+          m_SafeOutput[k] = m_OldCurves.distance(i, m_NewCurves, b);
+      }
+    }
+  }
+};
+
+// Labels of the enlarged `dist` object: the labels of `old_dist`, then the
+// names of the new curves `newNames`. Curves without a label or a name are
+// numbered by their position from 1, so that unnamed new curves continue the
+// numbering of the old ones.
+static Rcpp::RObject updatedLabels(Rcpp::NumericVector old_dist,
+                                   Rcpp::RObject newNames,
+                                   std::size_t numOld,
+                                   std::size_t N)
+{
+  Rcpp::RObject oldLabels = old_dist.attr("Labels");
+  bool hasOldLabels = !oldLabels.isNULL() && static_cast<std::size_t>(Rf_length(oldLabels)) == numOld;
+
+  if (newNames.isNULL() && (!hasOldLabels || TYPEOF(oldLabels) != STRSXP))
+  {
+    Rcpp::IntegerVector out = Rcpp::seq(1, N);
+    if (hasOldLabels)
+    {
+      Rcpp::IntegerVector labels = Rcpp::as<Rcpp::IntegerVector>(oldLabels);
+      std::copy(labels.begin(), labels.end(), out.begin());
+    }
+    return out;
+  }
+
+  Rcpp::CharacterVector out(N);
+  for (std::size_t i = 0;i < N;++i)
+    out[i] = std::to_string(i + 1);
+  if (hasOldLabels)
+  {
+    Rcpp::CharacterVector labels = Rcpp::as<Rcpp::CharacterVector>(oldLabels);
+    std::copy(labels.begin(), labels.end(), out.begin());
+  }
+  if (!newNames.isNULL())
+  {
+    Rcpp::CharacterVector names = Rcpp::as<Rcpp::CharacterVector>(newNames);
+    std::copy(names.begin(), names.end(), out.begin() + numOld);
+  }
+  return out;
+}
+
+Rcpp::NumericVector update_dist(Rcpp::NumericVector old_dist,
+                                const HausdorffSample &oldSample,
+                                const HausdorffSample &newSample,
+                                unsigned int ncores = 1,
+                                Rcpp::RObject newNames = Rcpp::RObject())
+{
+  std::size_t numOld = oldSample.size();
+  std::size_t oldSize = numOld * (numOld - 1) / 2;
+  if (static_cast<std::size_t>(old_dist.size()) != oldSize)
+    Rcpp::stop("`old_dist` holds %d distances, expected %d for %d curves.",
+               old_dist.size(), oldSize, numOld);
+
+  if (numOld > 0 && !oldSample.isCompatible(newSample))
+    Rcpp::stop("New curves must have the same dimension and number of points as the old ones.");
+
+  std::size_t N = numOld + newSample.size();
+  std::size_t K = N * (N - 1) / 2;
+  Rcpp::NumericVector out(K);
+
+  // The old pairs keep their order but each column of the lower triangle now
+  // ends with the pairs of its curve with the new curves.
+  for (std::size_t i = 0;i + 1 < numOld;++i)
+  {
+    std::size_t column = pairIndex(i, i + 1, numOld);
+    std::copy(old_dist.begin() + column, old_dist.begin() + column + (numOld - i - 1),
+              out.begin() + pairIndex(i, i + 1, N));
+  }
+
+  PairTiling newTiling(newSample.size(), defaultTileSize(newSample.curveBytes()));
+  DistUpdater distUpdater(oldSample, newSample, newTiling, out);
+  RcppParallel::parallelFor(0, distUpdater.size(), distUpdater, 1, ncores);
+
+  out.attr("Size") = N;
+  out.attr("Labels") = updatedLabels(old_dist, newNames, numOld, N);
+  out.attr("Diag") = false;
+  out.attr("Upper") = false;
+  out.attr("method") = "hausdorff";
+  out.attr("class") = "dist";
+  return out;
+}
+
+// Distances between `old_curves` and `new_curves` appended to them, given the
+// `dist` object `old_dist` of `old_curves`: only the pairs involving a new
+// curve are computed. `old_curves` can be packed by `pack_curves()`, in which
+// case `dimension`, `algorithm` and `precision` are taken from it. The labels
+// of `old_dist` are kept and followed by the names of `new_curves`, if any.
+// [[Rcpp::export]]
+Rcpp::NumericVector update_dist(Rcpp::NumericVector old_dist,
+                                SEXP old_curves,
+                                Rcpp::List new_curves,
+                                unsigned int dimension = 1,
+                                unsigned int ncores = 1,
+                                std::string algorithm = "naive",
+                                std::string precision = "double")
+{
+  Rcpp::XPtr<HausdorffSample> oldSample = asHausdorffSample(old_curves, dimension, algorithm, precision, ncores);
+  HausdorffSample newSample = prepareSample(new_curves, oldSample->curves().dimension(), oldSample->algorithm(),
+                                            oldSample->precision(), ncores);
+  return update_dist(old_dist, *oldSample, newSample, ncores, new_curves.attr("names"));
+}
@@ -1,97 +1,490 @@
 #include "hausdorff_utils.h"
+#include "dist_job.h"
+
+#include <chrono>
+#include <random>
 
 double hausdorff_distance_cpp(Rcpp::NumericVector x,
                               Rcpp::NumericVector y,
                               unsigned int dimension)
 {
-  unsigned int numDimensions = dimension;
-  unsigned int numPoints = x.size() / numDimensions;
+  return hausdorffDistanceNaive(x, y, dimension);
+}
 
-  double dX = 0.0;
-  double dY = 0.0;
+double hausdorff_distance_cpp(RcppParallel::RMatrix<double>::Row x,
+                              RcppParallel::RMatrix<double>::Row y,
+                              unsigned int dimension)
+{
+  return hausdorffDistanceNaive(x, y, dimension);
+}
 
-  for (unsigned int i = 0;i < numPoints;++i)
-  {
-    double min_dist_x = std::numeric_limits<double>::infinity();
-    double min_dist_y = std::numeric_limits<double>::infinity();
+// Pointers to the data of a list of D x P curve matrices, checked once so
+// that the curves can then be read concurrently without calling into R.
+struct CurveListView
+{
+  std::vector<const double *> m_Curves;
+  unsigned int m_Dimension;
+  std::size_t m_NumPoints;
+  // Number of points of each curve, which may differ if `ragged`.
+  std::vector<std::size_t> m_CurveSizes;
+  // Copies of the curves that are not stored as doubles.
+  std::vector<Rcpp::NumericMatrix> m_Coerced;
 
-    for (unsigned int j = 0;j < numPoints;++j)
+  // `dimension` is the expected number of rows of every curve, or 0 to take
+  // it from the first one.
+  CurveListView(Rcpp::List x, unsigned int dimension, bool ragged = false)
+    : m_Curves(x.size()), m_Dimension(dimension), m_NumPoints(0), m_CurveSizes(x.size())
+  {
+    for (R_xlen_t i = 0;i < x.size();++i)
     {
-      double dist_x = 0.0;
-      double dist_y = 0.0;
+      SEXP curve = x[i];
+      if (!Rf_isMatrix(curve) || (TYPEOF(curve) != REALSXP && TYPEOF(curve) != INTSXP))
+        Rcpp::stop("Curve %d is not a numeric matrix.", i + 1);
+
+      unsigned int nrow = Rf_nrows(curve);
+      std::size_t ncol = Rf_ncols(curve);
+      if (i == 0 && m_Dimension == 0)
+        m_Dimension = nrow;
+      if (i == 0)
+        m_NumPoints = ncol;
+
+      if (ragged && (nrow != m_Dimension || ncol == 0))
+        Rcpp::stop("Curve %d is a %d x %d matrix, expected %d rows and at least one column.",
+                   i + 1, nrow, ncol, m_Dimension);
+      if (!ragged && (nrow != m_Dimension || ncol != m_NumPoints))
+        Rcpp::stop("Curve %d is a %d x %d matrix, expected %d x %d.",
+                   i + 1, nrow, ncol, m_Dimension, m_NumPoints);
 
-      for (unsigned int k = 0;k < numDimensions;++k)
+      m_CurveSizes[i] = ncol;
+
+      if (TYPEOF(curve) == REALSXP)
+        m_Curves[i] = REAL(curve);
+      else
       {
-        unsigned int index_i = k * numPoints + i;
-        unsigned int index_j = k * numPoints + j;
-        dist_x += std::pow(x[index_i] - y[index_j], 2);
-        dist_y += std::pow(y[index_i] - x[index_j], 2);
+        m_Coerced.push_back(Rcpp::as<Rcpp::NumericMatrix>(curve));
+        m_Curves[i] = m_Coerced.back().begin();
       }
-      min_dist_x = std::min(min_dist_x, dist_x);
-      min_dist_y = std::min(min_dist_y, dist_y);
     }
+  }
+};
+
+// Copies point p of coordinate k of curve i to
+// `m_Output[i * m_CurveStride + k * m_PlaneStride + p * m_PointStride]`, which
+// describes both the rows of a `NumericMatrix` and `CurvePlanes`, and flags the
+// curves with non-finite coordinates in the same pass.
+struct CurveIngester : public RcppParallel::Worker
+{
+  const CurveListView &m_Input;
+  double *m_Output;
+  std::size_t m_CurveStride;
+  std::size_t m_PlaneStride;
+  std::size_t m_PointStride;
+  CurvePlanes *m_Planes;
+  std::vector<unsigned char> &m_NonFinite;
+
+  CurveIngester(const CurveListView &input,
+                double *output,
+                std::size_t curveStride,
+                std::size_t planeStride,
+                std::size_t pointStride,
+                CurvePlanes *planes,
+                std::vector<unsigned char> &nonFinite)
+    : m_Input(input), m_Output(output), m_CurveStride(curveStride),
+      m_PlaneStride(planeStride), m_PointStride(pointStride), m_Planes(planes),
+      m_NonFinite(nonFinite) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    unsigned int dimension = m_Input.m_Dimension;
+    std::size_t numPoints = m_Input.m_NumPoints;
+
+    for (std::size_t i = begin;i < end;++i)
+    {
+      double *out = m_Output + i * m_CurveStride;
+      bool finite = copyCurvePoints(m_Input.m_Curves[i], dimension, numPoints, out,
+                                    m_PlaneStride, m_PointStride);
+      m_NonFinite[i] = !finite;
+      if (m_Planes != nullptr)
+        m_Planes->pad(i);
+    }
+  }
+};
+
+// Copies each curve into its planes of `m_Output`, shuffles its points for
+// the early-break kernel and flags the curves with non-finite coordinates.
+struct RaggedCurveIngester : public RcppParallel::Worker
+{
+  const CurveListView &m_Input;
+  RaggedCurvePlanes &m_Output;
+  std::vector<unsigned char> &m_NonFinite;
+
+  RaggedCurveIngester(const CurveListView &input,
+                      RaggedCurvePlanes &output,
+                      std::vector<unsigned char> &nonFinite)
+    : m_Input(input), m_Output(output), m_NonFinite(nonFinite) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    unsigned int dimension = m_Input.m_Dimension;
 
-    dX = std::max(dX, min_dist_x);
-    dY = std::max(dY, min_dist_y);
+    for (std::size_t i = begin;i < end;++i)
+    {
+      bool finite = copyCurvePoints(m_Input.m_Curves[i], dimension, m_Output.numPoints(i),
+                                    m_Output.curve(i), m_Output.stride(i), 1);
+      m_NonFinite[i] = !finite;
+      shuffleCurvePoints(m_Output, i);
+    }
   }
+};
+
+template <typename Ingester>
+static void ingestCurves(Ingester &ingester, unsigned int ncores)
+{
+  RcppParallel::parallelFor(0, ingester.m_Input.m_Curves.size(), ingester, 1, ncores);
 
-  return std::sqrt(std::max(dX, dY));
+  std::vector<unsigned char>::const_iterator nonFinite =
+    std::find(ingester.m_NonFinite.begin(), ingester.m_NonFinite.end(), 1);
+  if (nonFinite != ingester.m_NonFinite.end())
+    Rcpp::stop("Curve %d has missing or infinite coordinates.",
+               nonFinite - ingester.m_NonFinite.begin() + 1);
 }
 
-double hausdorff_distance_cpp(RcppParallel::RMatrix<double>::Row x,
-                              RcppParallel::RMatrix<double>::Row y,
-                              unsigned int dimension)
+Rcpp::NumericMatrix listToMatrix(Rcpp::List x, unsigned int ncores)
 {
-  unsigned int numDimensions = dimension;
-  unsigned int numPoints = x.size() / numDimensions;
+  CurveListView input(x, 0);
+  std::size_t nrows = input.m_Curves.size();
+  std::size_t numPoints = input.m_NumPoints;
+  Rcpp::NumericMatrix out(nrows, input.m_Dimension * numPoints);
+  std::vector<unsigned char> nonFinite(nrows, 0);
 
-  double dX = 0.0;
-  double dY = 0.0;
+  // Row i of the column-major matrix, coordinate-major within the row.
+  CurveIngester ingester(input, out.begin(), 1, numPoints * nrows, nrows, nullptr, nonFinite);
+  ingestCurves(ingester, ncores);
+  return out;
+}
+
+CurvePlanes packCurves(Rcpp::List x, unsigned int dimension, unsigned int ncores)
+{
+  CurveListView input(x, dimension);
+  std::size_t nrows = input.m_Curves.size();
+  CurvePlanes out(nrows, dimension, input.m_NumPoints);
+  std::vector<unsigned char> nonFinite(nrows, 0);
 
-  for (unsigned int i = 0;i < numPoints;++i)
+  if (nrows > 0)
   {
-    double min_dist_x = std::numeric_limits<double>::infinity();
-    double min_dist_y = std::numeric_limits<double>::infinity();
+    CurveIngester ingester(input, out.curve(0), dimension * out.stride(), out.stride(), 1, &out, nonFinite);
+    ingestCurves(ingester, ncores);
+  }
 
-    for (unsigned int j = 0;j < numPoints;++j)
-    {
-      double dist_x = 0.0;
-      double dist_y = 0.0;
+  return out;
+}
+
+RaggedCurvePlanes packRaggedCurves(Rcpp::List x,
+                                   unsigned int dimension,
+                                   unsigned int ncores)
+{
+  CurveListView input(x, dimension, true);
+  RaggedCurvePlanes out(input.m_CurveSizes, dimension);
+  std::vector<unsigned char> nonFinite(input.m_Curves.size(), 0);
 
-      for (unsigned int k = 0;k < numDimensions;++k)
+  RaggedCurveIngester ingester(input, out, nonFinite);
+  ingestCurves(ingester, ncores);
+  return out;
+}
+
+CostOrderedPairs raggedPairTasks(const RaggedCurvePlanes &curves, unsigned int ncores)
+{
+  std::vector<double> weights(curves.numPoints().begin(), curves.numPoints().end());
+  return CostOrderedPairs(weights, RAGGED_TASKS_PER_THREAD * std::max(ncores, 1u));
+}
+
+double hausdorff_distance_simd(Rcpp::NumericVector x,
+                               Rcpp::NumericVector y,
+                               unsigned int dimension)
+{
+  unsigned int numPoints = x.size() / dimension;
+  CurvePlanes curves(2, dimension, numPoints);
+
+  for (unsigned int k = 0;k < dimension;++k)
+  {
+    std::copy(x.begin() + k * numPoints, x.begin() + (k + 1) * numPoints,
+              curves.curve(0) + k * curves.stride());
+    std::copy(y.begin() + k * numPoints, y.begin() + (k + 1) * numPoints,
+              curves.curve(1) + k * curves.stride());
+  }
+
+  curves.pad(0);
+  curves.pad(1);
+  return hausdorff_distance_simd(curves, 0, 1);
+}
+
+typedef double (*HausdorffKernel)(const double *, const double *, unsigned int, std::size_t, std::size_t);
+
+static double timeKernel(HausdorffKernel kernel,
+                         const CurvePlanes &curves,
+                         unsigned int repetitions)
+{
+  double best = std::numeric_limits<double>::infinity();
+  double sink = 0.0;
+
+  for (int batch = 0;batch < 5;++batch)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int r = 0;r < repetitions;++r)
+      sink += kernel(curves.curve(0), curves.curve(1), curves.dimension(), curves.numPoints(), curves.stride());
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / repetitions);
+  }
+
+  // Keeps the calls from being optimized away.
+  if (sink < 0.0)
+    Rcpp::Rcout << sink;
+  return best;
+}
+
+Rcpp::DataFrame benchmark_hausdorff_kernel(unsigned int numPoints,
+                                           unsigned int maxDimension,
+                                           unsigned int repetitions)
+{
+  Rcpp::IntegerVector dimension(maxDimension);
+  Rcpp::NumericVector generic(maxDimension);
+  Rcpp::NumericVector selected(maxDimension);
+  Rcpp::NumericVector speedup(maxDimension);
+  std::mt19937 generator(1234);
+  std::normal_distribution<double> normal;
+
+  for (unsigned int d = 1;d <= maxDimension;++d)
+  {
+    CurvePlanes curves(2, d, numPoints);
+    for (std::size_t i = 0;i < 2;++i)
+    {
+      for (unsigned int k = 0;k < d;++k)
       {
-        unsigned index_i = k * numPoints + i;
-        unsigned index_j = k * numPoints + j;
-        dist_x += std::pow(x[index_i] - y[index_j], 2);
-        dist_y += std::pow(y[index_i] - x[index_j], 2);
+        for (std::size_t p = 0;p < numPoints;++p)
+          curves.curve(i)[k * curves.stride() + p] = normal(generator);
       }
-
-      min_dist_x = std::min(min_dist_x, dist_x);
-      min_dist_y = std::min(min_dist_y, dist_y);
+      curves.pad(i);
     }
 
-    dX = std::max(dX, min_dist_x);
-    dY = std::max(dY, min_dist_y);
+    dimension[d - 1] = d;
+    generic[d - 1] = timeKernel(hausdorff_squared_generic, curves, repetitions);
+    selected[d - 1] = timeKernel(hausdorff_squared_simd, curves, repetitions);
+    speedup[d - 1] = generic[d - 1] / selected[d - 1];
   }
 
-  return std::sqrt(std::max(dX, dY));
+  return Rcpp::DataFrame::create(
+    Rcpp::Named("dimension") = dimension,
+    Rcpp::Named("generic") = generic,
+    Rcpp::Named("specialized") = selected,
+    Rcpp::Named("speedup") = speedup
+  );
 }
 
-Rcpp::NumericMatrix listToMatrix(Rcpp::List x)
+CurvePlanes packCurves(Rcpp::NumericMatrix x, unsigned int dimension)
 {
-  unsigned int nrows = x.size();
-  unsigned int ncols = Rcpp::as<Rcpp::NumericVector>(x[0]).size();
-  Rcpp::NumericMatrix out(nrows, ncols);
-  Rcpp::NumericMatrix workMatrix;
-  Rcpp::NumericVector workRow;
+  unsigned int nrows = x.nrow();
+  unsigned int numPoints = x.ncol() / dimension;
+  CurvePlanes out(nrows, dimension, numPoints);
+  RcppParallel::RMatrix<double> xSafe(x);
 
   for (unsigned int i = 0;i < nrows;++i)
   {
-    workMatrix = Rcpp::as<Rcpp::NumericMatrix>(x[i]);
-    workMatrix = Rcpp::transpose(workMatrix);
-    workRow = Rcpp::as<Rcpp::NumericVector>(workMatrix);
-    std::copy(workRow.begin(), workRow.end(), out.row(i).begin());
+    RcppParallel::RMatrix<double>::Row row = xSafe.row(i);
+    double *curve = out.curve(i);
+
+    for (unsigned int k = 0;k < dimension;++k)
+    {
+      for (unsigned int p = 0;p < numPoints;++p)
+        curve[k * out.stride() + p] = row[k * numPoints + p];
+    }
+
+    out.pad(i);
   }
 
   return out;
 }
+
+HausdorffAlgorithm parseHausdorffAlgorithm(std::string algorithm)
+{
+  if (algorithm == "naive")
+    return HAUSDORFF_NAIVE;
+  if (algorithm == "early_break")
+    return HAUSDORFF_EARLY_BREAK;
+  if (algorithm == "kdtree")
+    return HAUSDORFF_KDTREE;
+  Rcpp::stop("Unknown Hausdorff algorithm '%s'. Use 'naive', 'early_break' or 'kdtree'.", algorithm);
+}
+
+HausdorffPrecision parseHausdorffPrecision(std::string precision,
+                                           HausdorffAlgorithm algorithm)
+{
+  if (precision == "double")
+    return HAUSDORFF_DOUBLE;
+  if (precision != "mixed")
+    Rcpp::stop("Unknown precision '%s'. Use 'double' or 'mixed'.", precision);
+  if (algorithm != HAUSDORFF_NAIVE)
+    Rcpp::stop("Mixed precision is only available with algorithm = 'naive'.");
+  return HAUSDORFF_MIXED;
+}
+
+ThreadPlacement parseThreadPlacement(std::string affinity, unsigned int ncores)
+{
+  if (affinity == "none")
+    return ThreadPlacement(ncores);
+  if (affinity == "compact")
+    return ThreadPlacement(NumaTopology::detect(), AFFINITY_COMPACT, ncores);
+  if (affinity == "spread")
+    return ThreadPlacement(NumaTopology::detect(), AFFINITY_SPREAD, ncores);
+
+  std::vector<int> cpus;
+  if (!parseCpuList(affinity, cpus))
+    Rcpp::stop("Unknown affinity '%s'. Use 'none', 'compact', 'spread' or a list of CPUs such as '0-3,8'.", affinity);
+  return ThreadPlacement(NumaTopology::detect(), AFFINITY_LIST, ncores, cpus);
+}
+
+HausdorffSample prepareSample(Rcpp::List x,
+                              unsigned int dimension,
+                              HausdorffAlgorithm algorithm,
+                              HausdorffPrecision precision,
+                              unsigned int ncores)
+{
+  HausdorffSample out(packCurves(x, dimension, ncores), algorithm, precision);
+  CurvePreprocessor<HausdorffSample> curvePreprocessor(out);
+  RcppParallel::parallelFor(0, out.size(), curvePreprocessor, 1, ncores);
+  return out;
+}
+
+Rcpp::XPtr<HausdorffSample> pack_curves(Rcpp::List x,
+                                        unsigned int dimension,
+                                        std::string algorithm,
+                                        unsigned int ncores,
+                                        std::string precision)
+{
+  HausdorffAlgorithm hausdorffAlgorithm = parseHausdorffAlgorithm(algorithm);
+  HausdorffPrecision hausdorffPrecision = parseHausdorffPrecision(precision, hausdorffAlgorithm);
+  HausdorffSample *sample = new HausdorffSample(prepareSample(x, dimension, hausdorffAlgorithm, hausdorffPrecision, ncores));
+  Rcpp::XPtr<HausdorffSample> out(sample, true);
+  out.attr("class") = "hausdorff_curves";
+  return out;
+}
+
+Rcpp::XPtr<HausdorffSample> asPackedCurves(SEXP x)
+{
+  if (TYPEOF(x) != EXTPTRSXP || !Rf_inherits(x, "hausdorff_curves"))
+    Rcpp::stop("Expected curves packed by pack_curves().");
+
+  Rcpp::XPtr<HausdorffSample> out(x);
+  if (out.get() == nullptr)
+    Rcpp::stop("The packed curves are no longer available (e.g. restored from a saved session).");
+  return out;
+}
+
+Rcpp::XPtr<HausdorffSample> asHausdorffSample(SEXP x,
+                                              unsigned int dimension,
+                                              std::string algorithm,
+                                              std::string precision,
+                                              unsigned int ncores)
+{
+  if (TYPEOF(x) == EXTPTRSXP)
+    return asPackedCurves(x);
+  return pack_curves(x, dimension, algorithm, ncores, precision);
+}
+
+Rcpp::XPtr<RaggedCurvePlanes> pack_ragged_curves(Rcpp::List x,
+                                                 unsigned int dimension,
+                                                 unsigned int ncores)
+{
+  RaggedCurvePlanes *curves = new RaggedCurvePlanes(packRaggedCurves(x, dimension, ncores));
+  Rcpp::XPtr<RaggedCurvePlanes> out(curves, true);
+  out.attr("class") = "hausdorff_ragged_curves";
+  return out;
+}
+
+Rcpp::XPtr<RaggedCurvePlanes> asRaggedCurves(SEXP x,
+                                             unsigned int dimension,
+                                             unsigned int ncores)
+{
+  if (TYPEOF(x) != EXTPTRSXP)
+    return pack_ragged_curves(x, dimension, ncores);
+  if (!Rf_inherits(x, "hausdorff_ragged_curves"))
+    Rcpp::stop("Expected curves packed by pack_ragged_curves().");
+
+  Rcpp::XPtr<RaggedCurvePlanes> out(x);
+  if (out.get() == nullptr)
+    Rcpp::stop("The packed curves are no longer available (e.g. restored from a saved session).");
+  return out;
+}
+
+DistValueType parseDistValueType(std::string type)
+{
+  if (type == "float64")
+    return DIST_FLOAT64;
+  if (type == "float32")
+    return DIST_FLOAT32;
+  Rcpp::stop("Unknown value type '%s'. Use 'float64' or 'float32'.", type);
+}
+
+static Rcpp::XPtr<DistFile> wrapDistFile(DistFile *file)
+{
+  Rcpp::XPtr<DistFile> out(file, true);
+  out.attr("class") = "dist_file";
+  out.attr("Size") = static_cast<double>(file->numCurves());
+  out.attr("file") = file->path();
+  return out;
+}
+
+Rcpp::XPtr<DistFile> createDistFile(std::string file,
+                                    std::size_t numCurves,
+                                    std::string type)
+{
+  return wrapDistFile(new DistFile(file, numCurves, parseDistValueType(type)));
+}
+
+Rcpp::XPtr<DistFile> dist_file_open(std::string file)
+{
+  return wrapDistFile(new DistFile(file));
+}
+
+static Rcpp::XPtr<DistFile> asDistFile(SEXP x)
+{
+  if (TYPEOF(x) != EXTPTRSXP || !Rf_inherits(x, "dist_file"))
+    Rcpp::stop("Expected a handle returned by a dist_*_file() function or dist_file_open().");
+
+  Rcpp::XPtr<DistFile> out(x);
+  if (out.get() == nullptr)
+    Rcpp::stop("The distance file has been closed. Reopen it with dist_file_open().");
+  return out;
+}
+
+// Indices are passed as doubles from R so that they are not limited to 2^31.
+static std::size_t asCurveIndex(double i, std::size_t numCurves)
+{
+  if (!(i >= 1 && i <= numCurves) || i != std::floor(i))
+    Rcpp::stop("Curve index %g is out of range [1, %g].", i, static_cast<double>(numCurves));
+  return static_cast<std::size_t>(i) - 1;
+}
+
+Rcpp::NumericVector dist_file_get(SEXP handle,
+                                  Rcpp::NumericVector i,
+                                  Rcpp::NumericVector j)
+{
+  Rcpp::XPtr<DistFile> file = asDistFile(handle);
+  if (i.size() != j.size())
+    Rcpp::stop("`i` and `j` must have the same length.");
+
+  std::size_t N = file->numCurves();
+  Rcpp::NumericVector out(i.size());
+
+  for (R_xlen_t l = 0;l < i.size();++l)
+    out[l] = file->distance(asCurveIndex(i[l], N), asCurveIndex(j[l], N));
+
+  return out;
+}
+
+Rcpp::NumericVector dist_file_row(SEXP handle, double i)
+{
+  Rcpp::XPtr<DistFile> file = asDistFile(handle);
+  std::vector<double> row;
+  file->row(asCurveIndex(i, file->numCurves()), row);
+  return Rcpp::wrap(row);
+}
@@ -4,6 +4,13 @@
 // [[Rcpp::depends(RcppParallel)]]
 #include <RcppParallel.h>
 
+#include "curve_layout.h"
+#include "dist_file.h"
+#include "hausdorff_sample.h"
+#include "numa_placement.h"
+#include "pair_scheduler.h"
+#include "hausdorff_simd.h"
+
 // [[Rcpp::export]]
 double hausdorff_distance_cpp(
     Rcpp::NumericVector x,
@@ -17,4 +24,132 @@ double hausdorff_distance_cpp(
     unsigned int dimension = 1
 );
 
-Rcpp::NumericMatrix listToMatrix(Rcpp::List x);
+// [[Rcpp::export]]
+double hausdorff_distance_simd(
+    Rcpp::NumericVector x,
+    Rcpp::NumericVector y,
+    unsigned int dimension = 1
+);
+
+// Time per pair, in microseconds, of the generic full scan kernel and of the
+// kernel selected for each dimension from 1 to `maxDimension`, on random
+// curves of `numPoints` points (best of 5 batches of `repetitions` pairs).
+// [[Rcpp::export]]
+Rcpp::DataFrame benchmark_hausdorff_kernel(unsigned int numPoints = 200,
+                                           unsigned int maxDimension = 4,
+                                           unsigned int repetitions = 1000);
+
+// Copies a list of D x P curve matrices into the rows of a matrix (the P
+// values of the first coordinate, then of the second, ...) in one parallel
+// pass, checking that all curves have the same size and finite coordinates.
+Rcpp::NumericMatrix listToMatrix(Rcpp::List x, unsigned int ncores = 1);
+
+CurvePlanes packCurves(Rcpp::NumericMatrix x, unsigned int dimension = 1);
+
+// Same as `listToMatrix()` but copies the curves straight into the planes used
+// by the kernels.
+CurvePlanes packCurves(Rcpp::List x,
+                       unsigned int dimension = 1,
+                       unsigned int ncores = 1);
+
+// Packs a list of D x P_i curve matrices with different numbers of points
+// P_i, shuffling their points for the early-break kernel.
+RaggedCurvePlanes packRaggedCurves(Rcpp::List x,
+                                   unsigned int dimension = 1,
+                                   unsigned int ncores = 1);
+
+// Number of tasks per thread of the cost-ordered schedule of ragged samples.
+const std::size_t RAGGED_TASKS_PER_THREAD = 16;
+
+// Pairs of a ragged sample split into tasks of similar cost, the pair (i, j)
+// costing P_i x P_j, in decreasing order of cost.
+CostOrderedPairs raggedPairTasks(const RaggedCurvePlanes &curves,
+                                 unsigned int ncores);
+
+HausdorffAlgorithm parseHausdorffAlgorithm(std::string algorithm);
+
+HausdorffPrecision parseHausdorffPrecision(std::string precision,
+                                           HausdorffAlgorithm algorithm);
+
+// Placement of the `ncores` threads of a backend for its `affinity`
+// argument: "none" (threads not pinned), "compact" (filling the NUMA nodes
+// one after the other), "spread" (going to the nodes in turn) or an explicit
+// list of CPUs such as "0-3,8".
+ThreadPlacement parseThreadPlacement(std::string affinity, unsigned int ncores);
+
+// Packs a list of curves and prepares them with `ncores` threads.
+HausdorffSample prepareSample(Rcpp::List x,
+                              unsigned int dimension,
+                              HausdorffAlgorithm algorithm,
+                              HausdorffPrecision precision,
+                              unsigned int ncores);
+
+// Curves packed and prepared once, to be reused across calls from R.
+// [[Rcpp::export]]
+Rcpp::XPtr<HausdorffSample> pack_curves(Rcpp::List x,
+                                        unsigned int dimension = 1,
+                                        std::string algorithm = "naive",
+                                        unsigned int ncores = 1,
+                                        std::string precision = "double");
+
+Rcpp::XPtr<HausdorffSample> asPackedCurves(SEXP x);
+
+// Curves passed to the `dist_*()` functions: either packed by `pack_curves()`,
+// in which case `dimension`, `algorithm` and `precision` are those of the
+// packed curves, or a list of curves packed on the fly.
+Rcpp::XPtr<HausdorffSample> asHausdorffSample(SEXP x,
+                                              unsigned int dimension,
+                                              std::string algorithm,
+                                              std::string precision,
+                                              unsigned int ncores);
+
+// Curves with different numbers of points packed once, to be reused across
+// calls from R.
+// [[Rcpp::export]]
+Rcpp::XPtr<RaggedCurvePlanes> pack_ragged_curves(Rcpp::List x,
+                                                 unsigned int dimension = 1,
+                                                 unsigned int ncores = 1);
+
+// Curves passed to the `dist_*_ragged()` functions: either packed by
+// `pack_ragged_curves()` or a list of curves packed on the fly.
+Rcpp::XPtr<RaggedCurvePlanes> asRaggedCurves(SEXP x,
+                                             unsigned int dimension,
+                                             unsigned int ncores);
+
+DistValueType parseDistValueType(std::string type);
+
+// Creates the memory-mapped output of the `dist_*_file()` functions.
+Rcpp::XPtr<DistFile> createDistFile(std::string file,
+                                    std::size_t numCurves,
+                                    std::string type);
+
+// Handle to a distance file written by a `dist_*_file()` function, e.g. in a
+// previous session.
+// [[Rcpp::export]]
+Rcpp::XPtr<DistFile> dist_file_open(std::string file);
+
+// Distances between the curves `i[l]` and `j[l]` (1-based).
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_file_get(SEXP handle,
+                                  Rcpp::NumericVector i,
+                                  Rcpp::NumericVector j);
+
+// Distances from the i-th curve (1-based) to all curves.
+// [[Rcpp::export]]
+Rcpp::NumericVector dist_file_row(SEXP handle, double i);
+
+template <typename Sample>
+struct CurvePreprocessor : public RcppParallel::Worker
+{
+  Sample &m_Sample;
+
+  CurvePreprocessor(Sample &x)
+    : m_Sample(x) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin;i < end;++i)
+      m_Sample.prepare(i);
+  }
+};
+
@@ -0,0 +1,259 @@
+#include "numa_placement.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+NumaTopology::NumaTopology(std::vector<std::vector<int>> nodeCpus)
+  : m_NodeCpus(std::move(nodeCpus))
+{
+  if (m_NodeCpus.empty())
+    m_NodeCpus.push_back(std::vector<int>(1, 0));
+}
+
+// CPUs this process may run on.
+static std::vector<int> allowedCpus()
+{
+  std::vector<int> out;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0;cpu < CPU_SETSIZE;++cpu)
+    {
+      if (CPU_ISSET(cpu, &set))
+        out.push_back(cpu);
+    }
+  }
+#endif
+  if (out.empty())
+  {
+    unsigned int numCpus = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int cpu = 0;cpu < numCpus;++cpu)
+      out.push_back(cpu);
+  }
+  return out;
+}
+
+NumaTopology NumaTopology::detect()
+{
+  std::vector<int> allowed = allowedCpus();
+
+  const char *emulated = std::getenv("HAUSDORFF_NUMA_NODES");
+  int numEmulated = emulated ? std::atoi(emulated) : 0;
+  if (numEmulated > 0)
+  {
+    // Nodes of consecutive CPUs, as sockets are numbered, sharing the CPUs
+    // when there are fewer CPUs than nodes.
+    std::size_t numNodes = numEmulated;
+    std::vector<std::vector<int>> nodeCpus(numNodes);
+    for (std::size_t n = 0;n < numNodes;++n)
+    {
+      std::size_t begin = nodeCurveBegin(n, allowed.size(), numNodes);
+      std::size_t end = nodeCurveBegin(n + 1, allowed.size(), numNodes);
+      if (begin == end)
+        nodeCpus[n].push_back(allowed[n % allowed.size()]);
+      else
+        nodeCpus[n].assign(allowed.begin() + begin, allowed.begin() + end);
+    }
+
+    NumaTopology out(nodeCpus);
+    out.m_Emulated = true;
+    return out;
+  }
+
+  std::vector<std::vector<int>> nodeCpus;
+  for (int node = 0;;++node)
+  {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string text;
+    if (!in || !std::getline(in, text))
+      break;
+
+    std::vector<int> cpus;
+    if (!parseCpuList(text, cpus))
+      break;
+
+    std::vector<int> usable;
+    for (int cpu : cpus)
+    {
+      if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+        usable.push_back(cpu);
+    }
+    if (!usable.empty())
+      nodeCpus.push_back(usable);
+  }
+
+  if (nodeCpus.empty())
+    nodeCpus.push_back(allowed);
+  return NumaTopology(nodeCpus);
+}
+
+std::size_t NumaTopology::nodeOf(int cpu) const
+{
+  for (std::size_t n = 0;n < m_NodeCpus.size();++n)
+  {
+    if (std::find(m_NodeCpus[n].begin(), m_NodeCpus[n].end(), cpu) != m_NodeCpus[n].end())
+      return n;
+  }
+  return 0;
+}
+
+ThreadPlacement::ThreadPlacement(std::size_t numThreads)
+  : m_Affinity(AFFINITY_NONE), m_Cpus(numThreads, -1), m_Nodes(numThreads, 0),
+    m_RanksOnNode(numThreads), m_NumThreadsOnNode(1, numThreads)
+{
+  for (std::size_t t = 0;t < numThreads;++t)
+    m_RanksOnNode[t] = t;
+}
+
+ThreadPlacement::ThreadPlacement(const NumaTopology &topology,
+                                 ThreadAffinity affinity,
+                                 std::size_t numThreads,
+                                 const std::vector<int> &cpuList)
+  : m_Affinity(affinity), m_Cpus(numThreads, -1), m_Nodes(numThreads, 0),
+    m_RanksOnNode(numThreads, 0)
+{
+  std::vector<std::size_t> topologyNodes(numThreads, 0);
+
+  if (affinity == AFFINITY_COMPACT)
+  {
+    std::vector<int> cpus;
+    std::vector<std::size_t> nodes;
+    for (std::size_t n = 0;n < topology.numNodes();++n)
+    {
+      cpus.insert(cpus.end(), topology.cpus(n).begin(), topology.cpus(n).end());
+      nodes.insert(nodes.end(), topology.cpus(n).size(), n);
+    }
+    for (std::size_t t = 0;t < numThreads;++t)
+    {
+      m_Cpus[t] = cpus[t % cpus.size()];
+      topologyNodes[t] = nodes[t % cpus.size()];
+    }
+  }
+  else if (affinity == AFFINITY_SPREAD)
+  {
+    for (std::size_t t = 0;t < numThreads;++t)
+    {
+      std::size_t n = t % topology.numNodes();
+      const std::vector<int> &cpus = topology.cpus(n);
+      m_Cpus[t] = cpus[t / topology.numNodes() % cpus.size()];
+      topologyNodes[t] = n;
+    }
+  }
+  else if (affinity == AFFINITY_LIST && !cpuList.empty())
+  {
+    for (std::size_t t = 0;t < numThreads;++t)
+    {
+      m_Cpus[t] = cpuList[t % cpuList.size()];
+      topologyNodes[t] = topology.nodeOf(m_Cpus[t]);
+    }
+  }
+  else
+    m_Affinity = AFFINITY_NONE;
+
+  // Renumbers the nodes with threads from 0, in the order of the topology.
+  std::vector<std::size_t> used(topologyNodes.begin(), topologyNodes.end());
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+  m_NumThreadsOnNode.assign(std::max(used.size(), std::size_t(1)), 0);
+  for (std::size_t t = 0;t < numThreads;++t)
+  {
+    m_Nodes[t] = std::lower_bound(used.begin(), used.end(), topologyNodes[t]) - used.begin();
+    m_RanksOnNode[t] = m_NumThreadsOnNode[m_Nodes[t]]++;
+  }
+}
+
+bool parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+  cpus.clear();
+  std::stringstream in(text);
+  std::string range;
+  while (std::getline(in, range, ','))
+  {
+    range.erase(std::remove_if(range.begin(), range.end(), [] (unsigned char c) { return std::isspace(c); }), range.end());
+    if (range.empty())
+      continue;
+
+    char *end = nullptr;
+    long first = std::strtol(range.c_str(), &end, 10);
+    long last = first;
+    if (end == range.c_str() || first < 0)
+      return false;
+    if (*end == '-')
+    {
+      const char *lastText = end + 1;
+      last = std::strtol(lastText, &end, 10);
+      if (end == lastText || last < first)
+        return false;
+    }
+    if (*end != '\0')
+      return false;
+
+    for (long cpu = first;cpu <= last;++cpu)
+      cpus.push_back(static_cast<int>(cpu));
+  }
+  return !cpus.empty();
+}
+
+ScopedThreadAffinity::ScopedThreadAffinity(int cpu)
+{
+#ifdef __linux__
+  if (cpu < 0 || cpu >= CPU_SETSIZE || sched_getaffinity(0, sizeof(m_Previous), &m_Previous) != 0)
+    return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  m_Pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void) cpu;
+#endif
+}
+
+ScopedThreadAffinity::~ScopedThreadAffinity()
+{
+#ifdef __linux__
+  if (m_Pinned)
+    sched_setaffinity(0, sizeof(m_Previous), &m_Previous);
+#endif
+}
+
+CurvePlanes placeCurvesOnNodes(const CurvePlanes &curves, const ThreadPlacement &placement)
+{
+  std::size_t numCurves = curves.size();
+  std::size_t numNodes = placement.numNodes();
+  CurvePlanes out(numCurves, curves.dimension(), curves.numPoints());
+  std::size_t valuesPerCurve = curves.dimension() * curves.stride();
+
+  // One thread per node, pinned to the CPU of the first thread of the node.
+  std::vector<std::thread> writers;
+  for (std::size_t n = 0;n < numNodes;++n)
+  {
+    int cpu = -1;
+    for (std::size_t t = 0;t < placement.numThreads() && cpu < 0;++t)
+    {
+      if (placement.node(t) == n)
+        cpu = placement.cpu(t);
+    }
+
+    std::size_t begin = nodeCurveBegin(n, numCurves, numNodes);
+    std::size_t end = nodeCurveBegin(n + 1, numCurves, numNodes);
+    if (begin == end)
+      continue;
+
+    writers.emplace_back([&curves, &out, cpu, begin, end, valuesPerCurve] {
+      ScopedThreadAffinity affinity(cpu);
+      std::memcpy(out.curve(begin), curves.curve(begin), (end - begin) * valuesPerCurve * sizeof(double));
+    });
+  }
+
+  for (std::size_t w = 0;w < writers.size();++w)
+    writers[w].join();
+  return out;
+}
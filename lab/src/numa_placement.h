@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "hausdorff_simd.h"
+#include "pair_scheduler.h"
+
+// CPUs of each NUMA node of the machine that this process may run on.
+class NumaTopology
+{
+public:
+  explicit NumaTopology(std::vector<std::vector<int>> nodeCpus);
+
+  // Reads the nodes from `/sys/devices/system/node`, or makes a single node
+  // of all the CPUs where that is not available. If the environment variable
+  // `HAUSDORFF_NUMA_NODES` is set to k > 0, the CPUs are instead split into k
+  // emulated nodes of consecutive CPUs, which exercises the placement on a
+  // machine with a single node.
+  static NumaTopology detect();
+
+  std::size_t numNodes() const { return m_NodeCpus.size(); }
+  const std::vector<int> &cpus(std::size_t node) const { return m_NodeCpus[node]; }
+
+  // Node of `cpu`, or 0 if it belongs to none.
+  std::size_t nodeOf(int cpu) const;
+
+  bool isEmulated() const { return m_Emulated; }
+
+private:
+  std::vector<std::vector<int>> m_NodeCpus;
+  bool m_Emulated = false;
+};
+
+enum ThreadAffinity
+{
+  // Threads are left to the scheduler of the operating system.
+  AFFINITY_NONE,
+  // Threads fill the CPUs of the first node before moving to the next one.
+  AFFINITY_COMPACT,
+  // Threads go to the nodes in turn.
+  AFFINITY_SPREAD,
+  // Threads go to the CPUs of a list in turn.
+  AFFINITY_LIST
+};
+
+// CPU and NUMA node of each of the `numThreads` threads of a backend.
+//
+// Nodes are numbered from 0 among the ones with at least one thread, in the
+// order of the topology, so that `node(t) < numNodes()` always holds. Without
+// affinity, there is a single node and threads are not pinned.
+class ThreadPlacement
+{
+public:
+  explicit ThreadPlacement(std::size_t numThreads = 1);
+
+  ThreadPlacement(const NumaTopology &topology,
+                  ThreadAffinity affinity,
+                  std::size_t numThreads,
+                  const std::vector<int> &cpuList = std::vector<int>());
+
+  bool isPinned() const { return m_Affinity != AFFINITY_NONE; }
+  std::size_t numThreads() const { return m_Cpus.size(); }
+  std::size_t numNodes() const { return m_NumThreadsOnNode.size(); }
+
+  // CPU of the t-th thread, -1 if it is not pinned.
+  int cpu(std::size_t t) const { return m_Cpus[t]; }
+  std::size_t node(std::size_t t) const { return m_Nodes[t]; }
+
+  // Rank of the t-th thread among the threads of its node.
+  std::size_t rankOnNode(std::size_t t) const { return m_RanksOnNode[t]; }
+  std::size_t numThreadsOnNode(std::size_t node) const { return m_NumThreadsOnNode[node]; }
+
+private:
+  ThreadAffinity m_Affinity;
+  std::vector<int> m_Cpus;
+  std::vector<std::size_t> m_Nodes;
+  std::vector<std::size_t> m_RanksOnNode;
+  std::vector<std::size_t> m_NumThreadsOnNode;
+};
+
+// Parses a list of CPUs such as "0-3,8,10-11" into `cpus`, in order, and
+// returns whether it is well formed.
+bool parseCpuList(const std::string &text, std::vector<int> &cpus);
+
+// Pins the calling thread to `cpu` for the lifetime of the object and then
+// restores its previous affinity, so that pooled threads (OpenMP, TBB or
+// RcppThread) are left as they were found. Does nothing for a negative `cpu`
+// or where thread affinity is not supported.
+class ScopedThreadAffinity
+{
+public:
+  explicit ScopedThreadAffinity(int cpu);
+  ~ScopedThreadAffinity();
+
+  ScopedThreadAffinity(const ScopedThreadAffinity &) = delete;
+  ScopedThreadAffinity &operator=(const ScopedThreadAffinity &) = delete;
+
+  bool isPinned() const { return m_Pinned; }
+
+private:
+  bool m_Pinned = false;
+#ifdef __linux__
+  cpu_set_t m_Previous;
+#endif
+};
+
+// Copy of `curves` whose pages are first touched, hence allocated by Linux,
+// on the node that will read them: the curves of node n (see `curveNode()`)
+// are copied by a thread pinned to a CPU of the n-th node of `placement`.
+CurvePlanes placeCurvesOnNodes(const CurvePlanes &curves, const ThreadPlacement &placement);
+
+// Work of the t-th thread of `placement` in the first phase of a placed
+// computation: pins the thread and prepares its share of the curves of its
+// node.
+template <typename Sample>
+void preparePlacedCurves(Sample &sample, const ThreadPlacement &placement, std::size_t t)
+{
+  ScopedThreadAffinity affinity(placement.cpu(t));
+
+  std::size_t numCurves = sample.size();
+  std::size_t numNodes = placement.numNodes();
+  std::size_t node = placement.node(t);
+  std::size_t end = nodeCurveBegin(node + 1, numCurves, numNodes);
+  for (std::size_t i = nodeCurveBegin(node, numCurves, numNodes) + placement.rankOnNode(t);i < end;
+       i += placement.numThreadsOnNode(node))
+  {
+    sample.prepare(i);
+  }
+}
+
+// Work of the t-th thread of `placement` in the second phase: pins the thread
+// and calls `write(k, distance)` for the pairs of the tiles it takes from
+// `tiles`, those of its node first.
+template <typename Sample, typename Writer>
+void computePlacedTiles(const Sample &sample,
+                        const PairTiling &tiling,
+                        NodeLocalTiles &tiles,
+                        const ThreadPlacement &placement,
+                        std::size_t t,
+                        Writer &write)
+{
+  ScopedThreadAffinity affinity(placement.cpu(t));
+
+  std::size_t tile;
+  while (tiles.next(placement.node(t), tile))
+  {
+    tiling.forEachPair(tile, [&sample, &write] (std::size_t i, std::size_t j, std::size_t k) {
+      write(k, sample.distance(i, j));
+    });
+  }
+}
@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Position of the pair (i, j), i < j, in the lower triangle of a `dist`
+// object of size N, stored column by column.
+inline std::size_t pairIndex(std::size_t i, std::size_t j, std::size_t N)
+{
+  return i * (2 * N - i - 1) / 2 + (j - i - 1);
+}
+
+// Tiling of the pairs (i, j), i < j, of a sample of N curves into square
+// blocks of `tileSize` x `tileSize` pairs.
+//
+// The curves of a tile are reused `tileSize` times each, so they stay in L2
+// cache while the tile is processed. Within a tile, pairs are enumerated row
+// by row with integer arithmetic only and the pairs of each row are
+// consecutive in the output, so a tile writes `tileSize` contiguous slices of
+// the `dist` vector instead of scattered elements.
+class PairTiling
+{
+public:
+  PairTiling(std::size_t numCurves, std::size_t tileSize)
+    : m_NumCurves(numCurves), m_TileSize(std::max(tileSize, std::size_t(1)))
+  {
+    std::size_t numTileRows = (m_NumCurves + m_TileSize - 1) / m_TileSize;
+    m_RowStart.resize(numTileRows + 1, 0);
+    for (std::size_t a = 0;a < numTileRows;++a)
+      m_RowStart[a + 1] = m_RowStart[a] + (numTileRows - a);
+  }
+
+  // Number of tiles.
+  std::size_t size() const { return m_RowStart.back(); }
+
+  std::size_t tileSize() const { return m_TileSize; }
+
+  // Calls `f(i, j, k)` for each pair (i, j) of the t-th tile, where `k` is
+  // the position of the pair in the `dist` vector.
+  template <typename Function>
+  void forEachPair(std::size_t t, Function f) const
+  {
+    Tile tile = bounds(t);
+
+    for (std::size_t i = tile.rowStart;i < tile.rowEnd;++i)
+    {
+      std::size_t j = std::max(tile.colStart, i + 1);
+      if (j >= tile.colEnd)
+        continue;
+
+      std::size_t k = pairIndex(i, j, m_NumCurves);
+      for (;j < tile.colEnd;++j, ++k)
+        f(i, j, k);
+    }
+  }
+
+  // Number of pairs of the t-th tile.
+  std::size_t numPairs(std::size_t t) const
+  {
+    Tile tile = bounds(t);
+    std::size_t out = 0;
+
+    for (std::size_t i = tile.rowStart;i < tile.rowEnd;++i)
+    {
+      std::size_t j = std::max(tile.colStart, i + 1);
+      if (j < tile.colEnd)
+        out += tile.colEnd - j;
+    }
+
+    return out;
+  }
+
+  // First curve of the rows and of the columns of the t-th tile.
+  std::size_t rowStart(std::size_t t) const { return bounds(t).rowStart; }
+  std::size_t colStart(std::size_t t) const { return bounds(t).colStart; }
+
+private:
+  struct Tile
+  {
+    std::size_t rowStart;
+    std::size_t rowEnd;
+    std::size_t colStart;
+    std::size_t colEnd;
+  };
+
+  Tile bounds(std::size_t t) const
+  {
+    std::size_t a = std::upper_bound(m_RowStart.begin(), m_RowStart.end(), t) - m_RowStart.begin() - 1;
+    std::size_t b = a + (t - m_RowStart[a]);
+    Tile tile;
+    tile.rowStart = a * m_TileSize;
+    tile.rowEnd = std::min((a + 1) * m_TileSize, m_NumCurves);
+    tile.colStart = b * m_TileSize;
+    tile.colEnd = std::min(tile.colStart + m_TileSize, m_NumCurves);
+    return tile;
+  }
+
+  std::size_t m_NumCurves;
+  std::size_t m_TileSize;
+  std::vector<std::size_t> m_RowStart;
+};
+
+// The N curves of a sample split into `numNodes` ranges of consecutive
+// curves, one per NUMA node: the n-th range starts at `nodeCurveBegin(n)`,
+// and curve i belongs to node `curveNode(i)`.
+inline std::size_t nodeCurveBegin(std::size_t node, std::size_t numCurves, std::size_t numNodes)
+{
+  return (node * numCurves + numNodes - 1) / numNodes;
+}
+
+inline std::size_t curveNode(std::size_t i, std::size_t numCurves, std::size_t numNodes)
+{
+  return i * numNodes / numCurves;
+}
+
+// Tiles of a `PairTiling` handed out to threads running on `numNodes` NUMA
+// nodes, the curves being split between the nodes as by `curveNode()`.
+//
+// A tile reads the curves of its rows and of its columns; it belongs to the
+// node of its rows or of its columns in turn along each row of tiles, so that
+// every node gets about the same number of tiles. Threads take the tiles of
+// their own node first, in order, and then those left on the other nodes.
+class NodeLocalTiles
+{
+public:
+  NodeLocalTiles(const PairTiling &tiling, std::size_t numCurves, std::size_t numNodes)
+    : m_Tiles(std::max(numNodes, std::size_t(1))), m_Next(new std::atomic<std::size_t>[m_Tiles.size()])
+  {
+    std::size_t tileSize = tiling.tileSize();
+    for (std::size_t t = 0;t < tiling.size();++t)
+    {
+      std::size_t rowStart = tiling.rowStart(t);
+      std::size_t colStart = tiling.colStart(t);
+      std::size_t curve = (rowStart + colStart) / tileSize % 2 == 0 ? rowStart : colStart;
+      m_Tiles[curveNode(curve, numCurves, m_Tiles.size())].push_back(t);
+    }
+
+    for (std::size_t n = 0;n < m_Tiles.size();++n)
+      m_Next[n].store(0, std::memory_order_relaxed);
+  }
+
+  std::size_t numNodes() const { return m_Tiles.size(); }
+
+  // Number of tiles that belong to `node`.
+  std::size_t numTiles(std::size_t node) const { return m_Tiles[node].size(); }
+
+  // Sets `t` to the next tile for a thread of `node` and returns true, or
+  // returns false once all the tiles have been handed out.
+  bool next(std::size_t node, std::size_t &t)
+  {
+    std::size_t numNodes = m_Tiles.size();
+    for (std::size_t n = 0;n < numNodes;++n)
+    {
+      std::size_t from = (node + n) % numNodes;
+      if (m_Next[from].load(std::memory_order_relaxed) >= m_Tiles[from].size())
+        continue;
+
+      std::size_t position = m_Next[from].fetch_add(1, std::memory_order_relaxed);
+      if (position < m_Tiles[from].size())
+      {
+        t = m_Tiles[from][position];
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::vector<std::vector<std::size_t>> m_Tiles;
+  std::unique_ptr<std::atomic<std::size_t>[]> m_Next;
+};
+
+// Tile side such that the curves of a tile fill about half of a 256 KiB L2
+// cache, given the memory footprint of one packed curve.
+inline std::size_t defaultTileSize(std::size_t bytesPerCurve)
+{
+  const std::size_t l2Budget = 128 * 1024;
+  std::size_t tileSize = l2Budget / (2 * std::max(bytesPerCurve, std::size_t(1)));
+  return std::min(std::max(tileSize, std::size_t(1)), std::size_t(64));
+}
+
+// Split of the pairs (i, j), i < j, of a sample of curves with different
+// costs into tasks of similar cost, for samples whose pairs do not all cost
+// the same (e.g. curves with different numbers of points, where the pair (i,
+// j) costs `weights[i] * weights[j]`).
+//
+// A task is a slice of consecutive pairs (i, j) of column i of the lower
+// triangle, so it reads curve i once and writes a contiguous slice of the
+// `dist` vector. Slices are cut as soon as they reach `1 / numTasks` of the
+// total cost, so a single expensive pair makes a task on its own. Tasks are
+// sorted by decreasing cost: handed out in order by a dynamic schedule, the
+// expensive ones start first and the cheap ones fill the gaps at the end.
+class CostOrderedPairs
+{
+public:
+  CostOrderedPairs(const std::vector<double> &weights, std::size_t numTasks)
+    : m_NumCurves(weights.size())
+  {
+    std::vector<double> prefix(m_NumCurves + 1, 0.0);
+    for (std::size_t i = 0;i < m_NumCurves;++i)
+      prefix[i + 1] = prefix[i] + weights[i];
+
+    double totalCost = 0.0;
+    for (std::size_t i = 0;i < m_NumCurves;++i)
+      totalCost += weights[i] * (prefix[m_NumCurves] - prefix[i + 1]);
+    double taskCost = totalCost / std::max(numTasks, std::size_t(1));
+
+    for (std::size_t i = 0;i + 1 < m_NumCurves;++i)
+    {
+      for (std::size_t jBegin = i + 1;jBegin < m_NumCurves;)
+      {
+        // First column end at which the slice reaches the task cost.
+        double target = weights[i] > 0.0 ? prefix[jBegin] + taskCost / weights[i] : prefix[m_NumCurves];
+        std::size_t jEnd = std::lower_bound(prefix.begin() + jBegin + 1, prefix.end(), target) - prefix.begin();
+        jEnd = std::min(jEnd, m_NumCurves);
+
+        Task task = {i, jBegin, jEnd, weights[i] * (prefix[jEnd] - prefix[jBegin])};
+        m_Tasks.push_back(task);
+        jBegin = jEnd;
+      }
+    }
+
+    std::stable_sort(m_Tasks.begin(), m_Tasks.end(), [] (const Task &a, const Task &b) {
+      return a.cost > b.cost;
+    });
+  }
+
+  // Number of tasks.
+  std::size_t size() const { return m_Tasks.size(); }
+
+  double cost(std::size_t t) const { return m_Tasks[t].cost; }
+
+  // Calls `f(i, j, k)` for each pair (i, j) of the t-th task, where `k` is
+  // the position of the pair in the `dist` vector.
+  template <typename Function>
+  void forEachPair(std::size_t t, Function f) const
+  {
+    const Task &task = m_Tasks[t];
+    std::size_t k = pairIndex(task.i, task.jBegin, m_NumCurves);
+    for (std::size_t j = task.jBegin;j < task.jEnd;++j, ++k)
+      f(task.i, j, k);
+  }
+
+private:
+  struct Task
+  {
+    std::size_t i;
+    std::size_t jBegin;
+    std::size_t jEnd;
+    double cost;
+  };
+
+  std::size_t m_NumCurves;
+  std::vector<Task> m_Tasks;
+};
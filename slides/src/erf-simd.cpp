@@ -0,0 +1,151 @@
+//---------------------------------
+#include <Rcpp.h>
+
+// [[Rcpp::depends(BH)]]
+#include <boost/math/special_functions/erf.hpp>
+
+// [[Rcpp::depends(RcppParallel)]]
+#include <RcppParallel.h>
+
+// // [[Rcpp::plugins(openmp)]] // Remove `//` on Windows and Linux
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "erf-simd.h"
+
+// Values per call of the kernel, which keeps each call in the L1 cache and
+// leaves enough blocks to balance the threads.
+static const std::size_t ERF_SIMD_BLOCK_SIZE = 4096;
+
+static ErfAccuracy parseErfAccuracy(const std::string &accuracy)
+{
+  if (accuracy == "fast")
+    return ERF_FAST;
+  if (accuracy == "full")
+    return ERF_FULL;
+  Rcpp::stop("The accuracy should be either 'fast' or 'full', not '%s'.", accuracy);
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector erf_simd(Rcpp::NumericVector x, std::string accuracy = "full")
+{
+  ErfAccuracy mode = parseErfAccuracy(accuracy);
+  Rcpp::NumericVector out(x.size());
+  erfSimd(x.begin(), out.begin(), x.size(), mode);
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector erf_simd_omp(Rcpp::NumericVector x,
+                                 unsigned int ncores,
+                                 std::string accuracy = "full")
+{
+  ErfAccuracy mode = parseErfAccuracy(accuracy);
+  std::size_t n = x.size();
+  std::size_t numBlocks = (n + ERF_SIMD_BLOCK_SIZE - 1) / ERF_SIMD_BLOCK_SIZE;
+  Rcpp::NumericVector out(n);
+
+  RcppParallel::RVector<double> wo(out);
+  RcppParallel::RVector<double> wx(x);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(ncores) schedule(static)
+#endif
+  for (std::size_t b = 0;b < numBlocks;++b)
+  {
+    std::size_t begin = b * ERF_SIMD_BLOCK_SIZE;
+    std::size_t size = std::min(ERF_SIMD_BLOCK_SIZE, n - begin);
+    erfSimd(wx.begin() + begin, wo.begin() + begin, size, mode);
+  }
+
+  return out;
+}
+
+struct ErfSimdFunctor : public RcppParallel::Worker
+{
+  const RcppParallel::RVector<double> m_InputVector;
+  RcppParallel::RVector<double> m_OutputVector;
+  ErfAccuracy m_Accuracy;
+
+  ErfSimdFunctor(const Rcpp::NumericVector input, Rcpp::NumericVector output, ErfAccuracy accuracy)
+    : m_InputVector(input), m_OutputVector(output), m_Accuracy(accuracy) {}
+
+  // The whole range goes to the kernel, which vectorizes it.
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    erfSimd(m_InputVector.begin() + begin, m_OutputVector.begin() + begin, end - begin, m_Accuracy);
+  }
+};
+
+// [[Rcpp::export]]
+Rcpp::NumericVector erf_simd_parallel_impl(Rcpp::NumericVector x, std::string accuracy = "full")
+{
+  Rcpp::NumericVector y(x.size());
+
+  ErfSimdFunctor erfFunctor(x, y, parseErfAccuracy(accuracy));
+  RcppParallel::parallelFor(0, x.size(), erfFunctor, ERF_SIMD_BLOCK_SIZE);
+
+  return y;
+}
+
+// [[Rcpp::export]]
+std::string erf_simd_isa()
+{
+  return erfSimdIsa();
+}
+
+// Largest error of the kernel against Boost in extended precision, on `n`
+// values: random bit patterns, which cover the whole double range, and
+// uniform values in [-6, 6], where erf is not yet rounded to +/-1.
+// [[Rcpp::export]]
+Rcpp::NumericVector erf_simd_error(std::string accuracy = "full", double n = 1e7)
+{
+  ErfAccuracy mode = parseErfAccuracy(accuracy);
+  std::size_t size = static_cast<std::size_t>(n);
+  std::vector<double> x(size), y(size);
+
+  std::mt19937_64 generator(42);
+  std::uniform_real_distribution<double> uniform(-6.0, 6.0);
+  for (std::size_t i = 0;i < size;++i)
+  {
+    if (i % 2 == 0)
+    {
+      std::uint64_t bits = generator();
+      std::memcpy(&x[i], &bits, sizeof(double));
+      if (std::isnan(x[i]))
+        x[i] = 0.0;
+    }
+    else
+      x[i] = uniform(generator);
+  }
+
+  erfSimd(x.data(), y.data(), size, mode);
+
+  double maxUlp = 0.0;
+  double maxRelative = 0.0;
+  double worstValue = 0.0;
+  for (std::size_t i = 0;i < size;++i)
+  {
+    long double exact = boost::math::erf(static_cast<long double>(x[i]));
+    long double error = std::fabs(static_cast<long double>(y[i]) - exact);
+    double rounded = static_cast<double>(exact);
+    double ulp = std::nextafter(std::fabs(rounded), std::numeric_limits<double>::infinity()) - std::fabs(rounded);
+    if (static_cast<double>(error / ulp) > maxUlp)
+    {
+      maxUlp = static_cast<double>(error / ulp);
+      worstValue = x[i];
+    }
+    if (std::fabs(rounded) >= std::numeric_limits<double>::min())
+      maxRelative = std::max(maxRelative, static_cast<double>(error / std::fabs(exact)));
+  }
+
+  return Rcpp::NumericVector::create(Rcpp::Named("max_ulp") = maxUlp,
+                                     Rcpp::Named("max_relative") = maxRelative,
+                                     Rcpp::Named("worst_x") = worstValue);
+}
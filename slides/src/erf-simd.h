@@ -0,0 +1,377 @@
+//---------------------------------
+// Vectorized error function with two accuracies:
+//
+// - "full": within 2 ulp of the exact value over the whole double range, from
+//   the piecewise rational approximations of FreeBSD's `s_erf.c` (fdlibm).
+// - "fast": relative error below 1.2e-7, from a Taylor polynomial for
+//   |x| < 0.5 and the Chebyshev fit of erfc of Numerical Recipes beyond.
+//
+// The kernel is written once with the vector extensions of GCC and Clang and
+// compiled for AVX-512, AVX2 + FMA and the baseline ISA, the best one being
+// selected at run time as in `lab/src/hausdorff_simd.cpp`. Branches on |x|
+// become blends: each range is only evaluated if one of the lanes of the
+// vector falls in it.
+//
+// The coefficients of the "full" mode are those of fdlibm:
+//
+// Copyright (C) 1993 by Sun Microsystems, Inc. All rights reserved.
+//
+// Developed at SunSoft, a Sun Microsystems, Inc. business.
+// Permission to use, copy, modify, and distribute this
+// software is freely granted, provided that this notice
+// is preserved.
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+enum ErfAccuracy
+{
+  ERF_FAST,
+  ERF_FULL
+};
+
+#if defined(__GNUC__)
+#define ERF_SIMD_VECTORS 1
+#define ERF_SIMD_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define ERF_SIMD_X86_DISPATCH 1
+#define ERF_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#ifdef ERF_SIMD_VECTORS
+
+// `W` doubles and their bits, which the target of the calling function maps
+// to SSE2, AVX2 or AVX-512 registers. The helpers below take these vectors by
+// reference and write their results through a reference: GCC warns that
+// passing or returning vectors wider than the baseline ISA by value changes
+// the ABI (-Wpsabi), even for helpers always inlined into kernels compiled
+// for the right target. Some of these warnings are only issued at the end of
+// the translation unit, where diagnostic pragmas no longer apply.
+template <int W>
+struct ErfLanes
+{
+  typedef double Real __attribute__((vector_size(8 * W)));
+  typedef unsigned long long Bits __attribute__((vector_size(8 * W)));
+};
+
+// Lane masks are built from sign bits with integer operations, since some
+// compilers split vector comparisons of 512-bit registers into scalar ones.
+//
+// All bits set in the lanes where a < b, for b finite and a non-negative or
+// NaN (which is never smaller).
+template <typename Real, typename Bits>
+ERF_SIMD_INLINE void erfLess(const Real &a, double b, Bits &out)
+{
+  out = -((Bits)(a - b) >> 63);
+}
+
+// `a` in the lanes of `mask`, `b` in the others. `out` may be `a` or `b`.
+template <typename Real, typename Bits>
+ERF_SIMD_INLINE void erfSelect(const Bits &mask, const Real &a, const Real &b, Real &out)
+{
+  out = (Real)(((Bits)a & mask) | ((Bits)b & ~mask));
+}
+
+// Horner step p = p * s + c, with c = a in the lanes of `mask` and b in the
+// others.
+template <typename Real, typename Bits>
+ERF_SIMD_INLINE void erfHorner(Real &p, const Real &s, const Bits &mask, double a, double b)
+{
+  Real c;
+  erfSelect(mask, Real{} + a, Real{} + b, c);
+  p = p * s + c;
+}
+
+template <typename Bits>
+ERF_SIMD_INLINE bool erfAnyLane(const Bits &mask)
+{
+  unsigned long long any = 0;
+  for (std::size_t l = 0;l < sizeof(Bits) / 8;++l)
+    any |= mask[l];
+  return any != 0;
+}
+
+static const double ERF_INV_FACTORIALS[14] = {
+  1.0, 1.0, 1.0 / 2.0, 1.0 / 6.0, 1.0 / 24.0, 1.0 / 120.0, 1.0 / 720.0,
+  1.0 / 5040.0, 1.0 / 40320.0, 1.0 / 362880.0, 1.0 / 3628800.0,
+  1.0 / 39916800.0, 1.0 / 479001600.0, 1.0 / 6227020800.0
+};
+
+// exp(x) for x in [-700, 700]: x = n log(2) + r with |r| <= log(2) / 2,
+// exp(r) from its Taylor polynomial of degree `Degree` and n added to the
+// exponent of the result. Degree 13 is within 1 ulp, degree 7 within 1e-8.
+template <typename Real, typename Bits, int Degree>
+ERF_SIMD_INLINE void erfExp(const Real &x, Real &out)
+{
+  const double shift = 6755399441055744.0; // 1.5 * 2^52, rounds to integers
+  Real t = x * 1.44269504088896338700e+00 + shift;
+  Real n = t - shift;
+  Real r = x - n * 6.93147180369123816490e-01;
+  r = r - n * 1.90821492927058770002e-10;
+
+  Real p = Real{} + ERF_INV_FACTORIALS[Degree];
+  for (int k = Degree - 1;k >= 0;--k)
+    p = p * r + ERF_INV_FACTORIALS[k];
+
+  Real shiftLanes = Real{} + shift;
+  Bits scale = ((Bits)t - (Bits)shiftLanes) << 52;
+  out = (Real)((Bits)p + scale);
+}
+
+template <typename Real, typename Bits>
+ERF_SIMD_INLINE void erfFull(const Real &x, Real &out)
+{
+  const unsigned long long signBit = 0x8000000000000000ULL;
+  Bits sign = (Bits)x & signBit;
+  Real ax = (Real)((Bits)x & ~signBit);
+
+  // |x| >= 6, where erf(x) rounds to 1, and infinities.
+  Real y = Real{} + 1.0;
+
+  // |x| < 0.84375: erf(x) = x + x R(x^2) / S(x^2).
+  Bits small;
+  erfLess(ax, 0.84375, small);
+  if (erfAnyLane(small))
+  {
+    Real z = ax * ax;
+    Real r = -2.37630166566501626084e-05 * z - 5.77027029648944159157e-03;
+    r = r * z - 2.84817495755985104766e-02;
+    r = r * z - 3.25042107247001499370e-01;
+    r = r * z + 1.28379167095512558561e-01;
+    Real s = -3.96022827877536812320e-06 * z + 1.32494738004321644526e-04;
+    s = s * z + 5.08130628187576562776e-03;
+    s = s * z + 6.50222499887672944485e-02;
+    s = s * z + 3.97917223959155352819e-01;
+    s = s * z + 1.0;
+    erfSelect(small, ax + ax * (r / s), y, y);
+  }
+
+  // 0.84375 <= |x| < 1.25: erf(x) = erx + P(|x| - 1) / Q(|x| - 1).
+  Bits below;
+  erfLess(ax, 1.25, below);
+  Bits middle = ~small & below;
+  if (erfAnyLane(middle))
+  {
+    Real s = ax - 1.0;
+    Real p = -2.16637559486879084300e-03 * s + 3.54783043256182359371e-02;
+    p = p * s - 1.10894694282396677476e-01;
+    p = p * s + 3.18346619901161753674e-01;
+    p = p * s - 3.72207876035701323847e-01;
+    p = p * s + 4.14856118683748331666e-01;
+    p = p * s - 2.36211856075265944077e-03;
+    Real q = 1.19844998467991074170e-02 * s + 1.36370839120290507362e-02;
+    q = q * s + 1.26171219808761642112e-01;
+    q = q * s + 7.18286544141962662868e-02;
+    q = q * s + 5.40397917702171048937e-01;
+    q = q * s + 1.06420880400844228286e-01;
+    q = q * s + 1.0;
+    erfSelect(middle, 8.45062911510467529297e-01 + p / q, y, y);
+  }
+
+  // 1.25 <= |x| < 6, with the coefficients of [1.25, 1 / 0.35] or
+  // [1 / 0.35, 6]:
+  //
+  //   erf(x) = 1 - exp(-x^2 - 0.5625 + R(1 / x^2) / S(1 / x^2)) / |x|
+  Bits tail;
+  erfLess(ax, 6.0, tail);
+  tail &= ~below;
+  if (erfAnyLane(tail))
+  {
+    Real a;
+    erfSelect(tail, ax, Real{} + 2.0, a);
+    Real s = 1.0 / (a * a);
+    Bits near;
+    erfLess(a, 1.0 / 0.35, near);
+    Real r = Real{};
+    erfHorner(r, s, near, -9.81432934416914548592e+00, 0.0);
+    erfHorner(r, s, near, -8.12874355063065934246e+01, -4.83519191608651397019e+02);
+    erfHorner(r, s, near, -1.84605092906711035994e+02, -1.02509513161107724954e+03);
+    erfHorner(r, s, near, -1.62396669462573470355e+02, -6.37566443368389627722e+02);
+    erfHorner(r, s, near, -6.23753324503260060396e+01, -1.60636384855821916062e+02);
+    erfHorner(r, s, near, -1.05586262253232909814e+01, -1.77579549177547519889e+01);
+    erfHorner(r, s, near, -6.93858572707181764372e-01, -7.99283237680523006574e-01);
+    erfHorner(r, s, near, -9.86494403484714822705e-03, -9.86494292470009928597e-03);
+    Real q = Real{};
+    erfHorner(q, s, near, -6.04244152148580987438e-02, 0.0);
+    erfHorner(q, s, near, 6.57024977031928170135e+00, -2.24409524465858183362e+01);
+    erfHorner(q, s, near, 1.08635005541779435134e+02, 4.74528541206955367215e+02);
+    erfHorner(q, s, near, 4.29008140027567833386e+02, 2.55305040643316442583e+03);
+    erfHorner(q, s, near, 6.45387271733267880336e+02, 3.19985821950859553908e+03);
+    erfHorner(q, s, near, 4.34565877475229228821e+02, 1.53672958608443695994e+03);
+    erfHorner(q, s, near, 1.37657754143519042600e+02, 3.25792512996573918826e+02);
+    erfHorner(q, s, near, 1.96512716674392571292e+01, 3.03380607434824582924e+01);
+    q = q * s + 1.0;
+
+    // z keeps the upper 21 bits of the mantissa of |x|, so that z^2 is exact
+    // and exp(-x^2) is the product of exp(-z^2) and exp((z - x)(z + x)).
+    Real z = (Real)((Bits)a & 0xffffffff00000000ULL);
+    Real ez, ed;
+    erfExp<Real, Bits, 13>(-z * z - 0.5625, ez);
+    erfExp<Real, Bits, 13>((z - a) * (z + a) + r / q, ed);
+    erfSelect(tail, 1.0 - ez * ed / a, y, y);
+  }
+
+  // NaN stays NaN: its bits exceed those of infinity.
+  Bits nan = -((0x7ff0000000000000ULL - (Bits)ax) >> 63);
+  erfSelect(nan, ax, y, y);
+  out = (Real)((Bits)y | sign);
+}
+
+template <typename Real, typename Bits>
+ERF_SIMD_INLINE void erfFast(const Real &x, Real &out)
+{
+  const unsigned long long signBit = 0x8000000000000000ULL;
+  Bits sign = (Bits)x & signBit;
+  Real ax = (Real)((Bits)x & ~signBit);
+  Real y = Real{} + 1.0;
+
+  // |x| < 0.5: Taylor polynomial of degree 13.
+  Bits small;
+  erfLess(ax, 0.5, small);
+  if (erfAnyLane(small))
+  {
+    const double twoOverSqrtPi = 1.12837916709551257390e+00;
+    Real z = ax * ax;
+    Real p = z * (twoOverSqrtPi / 9360.0) - twoOverSqrtPi / 1320.0;
+    p = p * z + twoOverSqrtPi / 216.0;
+    p = p * z - twoOverSqrtPi / 42.0;
+    p = p * z + twoOverSqrtPi / 10.0;
+    p = p * z - twoOverSqrtPi / 3.0;
+    p = p * z + twoOverSqrtPi;
+    erfSelect(small, ax * p, y, y);
+  }
+
+  // 0.5 <= |x| < 6: erf(x) = 1 - t exp(-x^2 + P(t)), t = 2 / (2 + |x|).
+  Bits tail;
+  erfLess(ax, 6.0, tail);
+  tail &= ~small;
+  if (erfAnyLane(tail))
+  {
+    Real a;
+    erfSelect(tail, ax, Real{} + 1.0, a);
+    Real t = 2.0 / (2.0 + a);
+    Real p = t * 0.17087277 - 0.82215223;
+    p = p * t + 1.48851587;
+    p = p * t - 1.13520398;
+    p = p * t + 0.27886807;
+    p = p * t - 0.18628806;
+    p = p * t + 0.09678418;
+    p = p * t + 0.37409196;
+    p = p * t + 1.00002368;
+    p = p * t - 1.26551223;
+    Real e;
+    erfExp<Real, Bits, 7>(p - a * a, e);
+    erfSelect(tail, 1.0 - t * e, y, y);
+  }
+
+  Bits nan = -((0x7ff0000000000000ULL - (Bits)ax) >> 63);
+  erfSelect(nan, ax, y, y);
+  out = (Real)((Bits)y | sign);
+}
+
+// Transforms full vectors of `W` values, then the remaining values in a
+// partially filled one.
+template <int W>
+ERF_SIMD_INLINE void erfLanes(const double *x,
+                              double *out,
+                              std::size_t n,
+                              ErfAccuracy accuracy)
+{
+  typedef typename ErfLanes<W>::Real Real;
+  typedef typename ErfLanes<W>::Bits Bits;
+
+  std::size_t i = 0;
+  for (;i + W <= n;i += W)
+  {
+    Real v;
+    std::memcpy(&v, x + i, sizeof(v));
+    Real y;
+    if (accuracy == ERF_FULL)
+      erfFull<Real, Bits>(v, y);
+    else
+      erfFast<Real, Bits>(v, y);
+    std::memcpy(out + i, &y, sizeof(y));
+  }
+
+  if (i < n)
+  {
+    Real v = {};
+    std::memcpy(&v, x + i, (n - i) * sizeof(double));
+    Real y;
+    if (accuracy == ERF_FULL)
+      erfFull<Real, Bits>(v, y);
+    else
+      erfFast<Real, Bits>(v, y);
+    std::memcpy(out + i, &y, (n - i) * sizeof(double));
+  }
+}
+
+#ifdef ERF_SIMD_X86_DISPATCH
+ERF_SIMD_TARGET("avx512f")
+inline void erf_avx512(const double *x, double *out, std::size_t n, ErfAccuracy accuracy)
+{
+  erfLanes<8>(x, out, n, accuracy);
+}
+
+ERF_SIMD_TARGET("avx2,fma")
+inline void erf_avx2(const double *x, double *out, std::size_t n, ErfAccuracy accuracy)
+{
+  erfLanes<4>(x, out, n, accuracy);
+}
+#endif
+
+// SSE2 on x86-64, NEON on ARM64.
+inline void erf_baseline(const double *x, double *out, std::size_t n, ErfAccuracy accuracy)
+{
+  erfLanes<2>(x, out, n, accuracy);
+}
+
+#else
+
+inline void erf_baseline(const double *x, double *out, std::size_t n, ErfAccuracy)
+{
+  for (std::size_t i = 0;i < n;++i)
+    out[i] = std::erf(x[i]);
+}
+
+#endif
+
+typedef void (*ErfKernel)(const double *, double *, std::size_t, ErfAccuracy);
+
+struct ErfKernelChoice
+{
+  ErfKernel kernel;
+  const char *isa;
+};
+
+inline ErfKernelChoice selectErfKernel()
+{
+#ifdef ERF_SIMD_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return {erf_avx512, "avx512f"};
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return {erf_avx2, "avx2"};
+#endif
+  return {erf_baseline, "baseline"};
+}
+
+inline const ErfKernelChoice &erfKernel()
+{
+  static const ErfKernelChoice choice = selectErfKernel();
+  return choice;
+}
+
+// Writes erf(x[i]) into out[i] for i < n.
+inline void erfSimd(const double *x, double *out, std::size_t n, ErfAccuracy accuracy)
+{
+  erfKernel().kernel(x, out, n, accuracy);
+}
+
+// Instruction set of the kernel selected for this CPU.
+inline const char *erfSimdIsa()
+{
+  return erfKernel().isa;
+}
@@ -0,0 +1,124 @@
+//---------------------------------
+#include <Rcpp.h>
+
+// [[Rcpp::depends(RcppParallel)]]
+#include <RcppParallel.h>
+
+#include <cmath>
+#include <string>
+
+#include "erf-simd.h"
+#include "lazy-parallel.h"
+
+static ErfAccuracy parseErfAccuracy(const std::string &accuracy)
+{
+  if (accuracy == "fast")
+    return ERF_FAST;
+  if (accuracy == "full")
+    return ERF_FULL;
+  Rcpp::stop("The accuracy should be either 'fast' or 'full', not '%s'.", accuracy);
+}
+
+struct ErfBlockKernel
+{
+  ErfAccuracy m_Accuracy;
+
+  void operator()(const double *x, double *out, std::size_t n) const
+  {
+    erfSimd(x, out, n, m_Accuracy);
+  }
+};
+
+struct Affine
+{
+  double m_Slope;
+  double m_Intercept;
+
+  double operator()(double x) const
+  {
+    return m_Slope * x + m_Intercept;
+  }
+};
+
+// a * erf(x) + b, as a type: nothing is computed yet.
+typedef LazyMap<LazyBlockMap<double, LazyVector<double>, ErfBlockKernel>, Affine> ErfAffine;
+
+static ErfAffine erfAffine(const RcppParallel::RVector<double> &x, double a, double b, ErfAccuracy accuracy)
+{
+  ErfBlockKernel kernel = {accuracy};
+  Affine affine = {a, b};
+  return lazyMap(lazyBlockMap<double>(lazyVector(x), kernel), affine);
+}
+
+// Same as `a * erf_simd_parallel(x) + b` in R, in one pass over `x` and
+// without allocating the two intermediate vectors.
+// [[Rcpp::export]]
+Rcpp::NumericVector erf_affine_lazy(Rcpp::NumericVector x,
+                                    double a,
+                                    double b,
+                                    unsigned int ncores,
+                                    std::string accuracy = "full")
+{
+  RcppParallel::RVector<double> wx(x);
+  ErfAffine expr = erfAffine(wx, a, b, parseErfAccuracy(accuracy));
+
+  Rcpp::NumericVector y(x.size());
+  lazyAssign(RcppParallel::RVector<double>(y), expr, ncores);
+  return y;
+}
+
+// Same as `sum(a * erf(x) + b)`, without storing any value in memory.
+// [[Rcpp::export]]
+double erf_affine_sum_lazy(Rcpp::NumericVector x,
+                           double a,
+                           double b,
+                           unsigned int ncores,
+                           std::string accuracy = "full")
+{
+  RcppParallel::RVector<double> wx(x);
+  return lazySum(erfAffine(wx, a, b, parseErfAccuracy(accuracy)), ncores);
+}
+
+// Same as `sum(pmax(x - y, 0))`, NaN included: a NaN difference is kept, as
+// `pmax()` does, and makes the sum NaN. The difference is computed twice per
+// value, for the condition and for the selected branch, which costs less than
+// reading it back from memory.
+// [[Rcpp::export]]
+double positive_part_sum_lazy(Rcpp::NumericVector x,
+                              Rcpp::NumericVector y,
+                              unsigned int ncores)
+{
+  if (x.size() != y.size())
+    Rcpp::stop("x and y should have the same length.");
+
+  RcppParallel::RVector<double> wx(x);
+  RcppParallel::RVector<double> wy(y);
+  auto difference = lazyZip(lazyVector(wx), lazyVector(wy), [] (double u, double v) {
+    return u - v;
+  });
+  auto isKept = lazyMap(difference, [] (double d) {
+    return !(d <= 0.0);
+  });
+
+  return lazySum(lazyWhere(isKept, difference, lazyConstant(0.0, x.size())), ncores);
+}
+
+// Same as `max(abs(x - y))`, with NaN propagated as in R.
+// [[Rcpp::export]]
+double max_abs_diff_lazy(Rcpp::NumericVector x,
+                         Rcpp::NumericVector y,
+                         unsigned int ncores)
+{
+  if (x.size() != y.size())
+    Rcpp::stop("x and y should have the same length.");
+
+  RcppParallel::RVector<double> wx(x);
+  RcppParallel::RVector<double> wy(y);
+  auto distance = lazyZip(lazyVector(wx), lazyVector(wy), [] (double u, double v) {
+    return std::fabs(u - v);
+  });
+
+  return lazyReduce(distance, 0.0, [] (double u, double v) {
+    return u > v || std::isnan(u) ? u : v;
+  }, ncores);
+}
@@ -0,0 +1,317 @@
+//---------------------------------
+// Lazy expressions over vectors, evaluated in a single pass.
+//
+// `a * erf(x) + b` in R, or in C++ with one `transformVector()`-like pass per
+// operation, reads and writes a full vector per operation and allocates
+// every intermediate result. Here, `lazyMap()`, `lazyZip()`, `lazyWhere()`
+// and `lazyBlockMap()` only build a tree of small objects describing the
+// computation. Nothing is computed until the tree is evaluated, one block of
+// `LAZY_BLOCK_SIZE` values at a time: each node computes its block from the
+// blocks of its children, which stay in the L1 cache, so that memory is only
+// read for the input vectors and written for the final result, if any.
+//
+// Each expression has a `value_type`, a `size()`, and a
+// `block(begin, n, buffer)` member returning a pointer to its values
+// [begin, begin + n), n <= LAZY_BLOCK_SIZE, either computed into `buffer` or,
+// for input vectors, read in place. The blocks are independent, so the
+// drivers of `lazy-parallel.h` hand them to threads; the ones below evaluate
+// a range of blocks on the calling thread.
+//
+// Expressions hold their inputs by pointer and their children by value:
+// the input vectors must outlive the expression, and the output of
+// `lazyEvaluateBlocks()` must not be one of them.
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "reductions.h"
+
+// Values per block: 8 kB of doubles, so that the blocks of an expression of
+// a few nodes fit together in the L1 cache.
+const std::size_t LAZY_BLOCK_SIZE = 1024;
+
+inline std::size_t numLazyBlocks(std::size_t n)
+{
+  return (n + LAZY_BLOCK_SIZE - 1) / LAZY_BLOCK_SIZE;
+}
+
+// Buffer for the block of a child: the block of the parent itself when they
+// have the same type, since a parent computing its i-th value from the i-th
+// value of its child can overwrite it, and a local buffer otherwise. Sharing
+// the block keeps the working set of a chain of maps to a single block.
+template <typename T>
+T *childBuffer(T *parentBuffer, T *)
+{
+  return parentBuffer;
+}
+
+template <typename T, typename U>
+T *childBuffer(U *, T *localBuffer)
+{
+  return localBuffer;
+}
+
+// Contiguous input vector: an `RcppParallel::RVector`, an Rcpp vector or a
+// `std::vector`, whose blocks are read in place.
+template <typename T>
+class LazyVector
+{
+public:
+  typedef T value_type;
+
+  LazyVector(const T *data, std::size_t size)
+    : m_Data(data), m_Size(size) {}
+
+  std::size_t size() const { return m_Size; }
+
+  const T *block(std::size_t begin, std::size_t, T *) const
+  {
+    return m_Data + begin;
+  }
+
+private:
+  const T *m_Data;
+  std::size_t m_Size;
+};
+
+template <typename Vector>
+LazyVector<typename std::remove_cv<typename std::remove_reference<decltype(*std::declval<const Vector &>().begin())>::type>::type>
+lazyVector(const Vector &x)
+{
+  typedef typename std::remove_cv<typename std::remove_reference<decltype(*x.begin())>::type>::type T;
+  std::size_t size = x.end() - x.begin();
+  return LazyVector<T>(size > 0 ? &*x.begin() : nullptr, size);
+}
+
+// `size` copies of `value`, e.g. the other branch of a `lazyWhere()`.
+template <typename T>
+class LazyConstant
+{
+public:
+  typedef T value_type;
+
+  LazyConstant(T value, std::size_t size)
+    : m_Value(value), m_Size(size) {}
+
+  std::size_t size() const { return m_Size; }
+
+  const T *block(std::size_t, std::size_t n, T *buffer) const
+  {
+    std::fill(buffer, buffer + n, m_Value);
+    return buffer;
+  }
+
+private:
+  T m_Value;
+  std::size_t m_Size;
+};
+
+template <typename T>
+LazyConstant<T> lazyConstant(T value, std::size_t size)
+{
+  return LazyConstant<T>(value, size);
+}
+
+// f(x[i]) for a function `f` of one value, inlined in the loop over the
+// block, which the compiler can then vectorize.
+template <typename Expr, typename F>
+class LazyMap
+{
+public:
+  typedef typename Expr::value_type input_type;
+  typedef typename std::decay<decltype(std::declval<const F &>()(std::declval<input_type>()))>::type value_type;
+
+  LazyMap(Expr expr, F f)
+    : m_Expr(std::move(expr)), m_F(std::move(f)) {}
+
+  std::size_t size() const { return m_Expr.size(); }
+
+  const value_type *block(std::size_t begin, std::size_t n, value_type *buffer) const
+  {
+    input_type local[LAZY_BLOCK_SIZE];
+    const input_type *x = m_Expr.block(begin, n, childBuffer(buffer, local));
+    for (std::size_t i = 0;i < n;++i)
+      buffer[i] = m_F(x[i]);
+    return buffer;
+  }
+
+private:
+  Expr m_Expr;
+  F m_F;
+};
+
+template <typename Expr, typename F>
+LazyMap<Expr, F> lazyMap(Expr expr, F f)
+{
+  return LazyMap<Expr, F>(std::move(expr), std::move(f));
+}
+
+// f(x[i], y[i]) for two expressions of the same size.
+template <typename Expr1, typename Expr2, typename F>
+class LazyZip
+{
+public:
+  typedef typename Expr1::value_type input1_type;
+  typedef typename Expr2::value_type input2_type;
+  typedef typename std::decay<decltype(std::declval<const F &>()(std::declval<input1_type>(), std::declval<input2_type>()))>::type value_type;
+
+  LazyZip(Expr1 expr1, Expr2 expr2, F f)
+    : m_Expr1(std::move(expr1)), m_Expr2(std::move(expr2)), m_F(std::move(f))
+  {
+    if (m_Expr1.size() != m_Expr2.size())
+      throw std::invalid_argument("Zipped expressions must have the same size.");
+  }
+
+  std::size_t size() const { return m_Expr1.size(); }
+
+  const value_type *block(std::size_t begin, std::size_t n, value_type *buffer) const
+  {
+    input1_type local1[LAZY_BLOCK_SIZE];
+    input2_type local2[LAZY_BLOCK_SIZE];
+    const input1_type *x = m_Expr1.block(begin, n, childBuffer(buffer, local1));
+    const input2_type *y = m_Expr2.block(begin, n, local2);
+    for (std::size_t i = 0;i < n;++i)
+      buffer[i] = m_F(x[i], y[i]);
+    return buffer;
+  }
+
+private:
+  Expr1 m_Expr1;
+  Expr2 m_Expr2;
+  F m_F;
+};
+
+template <typename Expr1, typename Expr2, typename F>
+LazyZip<Expr1, Expr2, F> lazyZip(Expr1 expr1, Expr2 expr2, F f)
+{
+  return LazyZip<Expr1, Expr2, F>(std::move(expr1), std::move(expr2), std::move(f));
+}
+
+// condition[i] ? x[i] : y[i], as `ifelse()` in R. Both branches are computed
+// for the whole block, so that the selection vectorizes.
+template <typename Condition, typename Expr1, typename Expr2>
+class LazyWhere
+{
+public:
+  typedef typename Condition::value_type condition_type;
+  typedef typename std::common_type<typename Expr1::value_type, typename Expr2::value_type>::type value_type;
+
+  LazyWhere(Condition condition, Expr1 expr1, Expr2 expr2)
+    : m_Condition(std::move(condition)), m_Expr1(std::move(expr1)), m_Expr2(std::move(expr2))
+  {
+    if (m_Condition.size() != m_Expr1.size() || m_Condition.size() != m_Expr2.size())
+      throw std::invalid_argument("The condition and both branches must have the same size.");
+  }
+
+  std::size_t size() const { return m_Condition.size(); }
+
+  const value_type *block(std::size_t begin, std::size_t n, value_type *buffer) const
+  {
+    typedef typename Expr1::value_type input1_type;
+    typedef typename Expr2::value_type input2_type;
+    condition_type localCondition[LAZY_BLOCK_SIZE];
+    input1_type local1[LAZY_BLOCK_SIZE];
+    input2_type local2[LAZY_BLOCK_SIZE];
+
+    const condition_type *condition = m_Condition.block(begin, n, localCondition);
+    const input1_type *x = m_Expr1.block(begin, n, childBuffer(buffer, local1));
+    const input2_type *y = m_Expr2.block(begin, n, local2);
+    for (std::size_t i = 0;i < n;++i)
+      buffer[i] = condition[i] ? x[i] : y[i];
+    return buffer;
+  }
+
+private:
+  Condition m_Condition;
+  Expr1 m_Expr1;
+  Expr2 m_Expr2;
+};
+
+template <typename Condition, typename Expr1, typename Expr2>
+LazyWhere<Condition, Expr1, Expr2> lazyWhere(Condition condition, Expr1 expr1, Expr2 expr2)
+{
+  return LazyWhere<Condition, Expr1, Expr2>(std::move(condition), std::move(expr1), std::move(expr2));
+}
+
+// kernel(x, out, n) writing n values of type `Output` from the n values of a
+// block at once, for kernels that work on arrays such as `erfSimd()`. The
+// kernel never gets the same array as input and output.
+template <typename Output, typename Expr, typename Kernel>
+class LazyBlockMap
+{
+public:
+  typedef typename Expr::value_type input_type;
+  typedef Output value_type;
+
+  LazyBlockMap(Expr expr, Kernel kernel)
+    : m_Expr(std::move(expr)), m_Kernel(std::move(kernel)) {}
+
+  std::size_t size() const { return m_Expr.size(); }
+
+  const value_type *block(std::size_t begin, std::size_t n, value_type *buffer) const
+  {
+    input_type local[LAZY_BLOCK_SIZE];
+    const input_type *x = m_Expr.block(begin, n, local);
+    m_Kernel(x, buffer, n);
+    return buffer;
+  }
+
+private:
+  Expr m_Expr;
+  Kernel m_Kernel;
+};
+
+template <typename Output, typename Expr, typename Kernel>
+LazyBlockMap<Output, Expr, Kernel> lazyBlockMap(Expr expr, Kernel kernel)
+{
+  return LazyBlockMap<Output, Expr, Kernel>(std::move(expr), std::move(kernel));
+}
+
+// Writes the values of the blocks [beginBlock, endBlock) of `expr` into
+// out[0], ..., out[expr.size() - 1]: the last node of the expression writes
+// straight into `out`.
+template <typename Expr>
+void lazyEvaluateBlocks(const Expr &expr,
+                        typename Expr::value_type *out,
+                        std::size_t beginBlock,
+                        std::size_t endBlock)
+{
+  std::size_t size = expr.size();
+  for (std::size_t b = beginBlock;b < endBlock;++b)
+  {
+    std::size_t begin = b * LAZY_BLOCK_SIZE;
+    std::size_t n = std::min(LAZY_BLOCK_SIZE, size - begin);
+    const typename Expr::value_type *values = expr.block(begin, n, out + begin);
+    if (values != out + begin)
+      std::copy(values, values + n, out + begin);
+  }
+}
+
+// op(...op(op(init, x[begin]), x[begin + 1])..., x[end - 1]) over the
+// values of the b-th block, without storing them anywhere but in the cache.
+template <typename Expr, typename T, typename Op>
+T lazyReduceBlock(const Expr &expr, std::size_t b, T init, Op op)
+{
+  typename Expr::value_type buffer[LAZY_BLOCK_SIZE];
+  std::size_t begin = b * LAZY_BLOCK_SIZE;
+  std::size_t n = std::min(LAZY_BLOCK_SIZE, expr.size() - begin);
+  const typename Expr::value_type *values = expr.block(begin, n, buffer);
+  for (std::size_t i = 0;i < n;++i)
+    init = op(init, values[i]);
+  return init;
+}
+
+// Sum of the values of the b-th block, added pairwise as in
+// `reductions.h`, which vectorizes unlike the sequential `lazyReduceBlock()`.
+template <typename Expr>
+double lazySumBlock(const Expr &expr, std::size_t b)
+{
+  static_assert(std::is_same<typename Expr::value_type, double>::value, "Only expressions of doubles can be summed pairwise.");
+  double buffer[LAZY_BLOCK_SIZE];
+  std::size_t begin = b * LAZY_BLOCK_SIZE;
+  std::size_t n = std::min(LAZY_BLOCK_SIZE, expr.size() - begin);
+  return pairwiseSum(expr.block(begin, n, buffer), n);
+}
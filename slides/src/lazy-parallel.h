@@ -0,0 +1,105 @@
+//---------------------------------
+// Parallel evaluation of the lazy expressions of `lazy-expr.h` with
+// RcppParallel: the blocks of the expression are handed to the threads of
+// `parallelFor()`, so that a whole chain of operations costs a single
+// parallel loop. Reductions combine the results of the blocks in a fixed
+// order, so that they do not depend on the number of threads.
+#pragma once
+#include <RcppParallel.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "lazy-expr.h"
+
+template <typename Expr>
+struct LazyEvaluateFunctor : public RcppParallel::Worker
+{
+  const Expr &m_Expr;
+  typename Expr::value_type *m_Output;
+
+  LazyEvaluateFunctor(const Expr &expr, typename Expr::value_type *output)
+    : m_Expr(expr), m_Output(output) {}
+
+  // Works on blocks rather than values.
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    lazyEvaluateBlocks(m_Expr, m_Output, begin, end);
+  }
+};
+
+// Writes the values of `expr` into `output`, which is the only vector
+// written. `numThreads` is passed to `parallelFor()`: -1 uses the setting of
+// `RcppParallel::setThreadOptions()`.
+template <typename Expr>
+void lazyAssign(RcppParallel::RVector<typename Expr::value_type> output,
+                const Expr &expr,
+                int numThreads = -1)
+{
+  if (output.length() != expr.size())
+    throw std::invalid_argument("The output must have the size of the expression.");
+
+  LazyEvaluateFunctor<Expr> functor(expr, output.begin());
+  RcppParallel::parallelFor(0, numLazyBlocks(expr.size()), functor, 1, numThreads);
+}
+
+template <typename Expr, typename T, typename Op>
+struct LazyReduceFunctor : public RcppParallel::Worker
+{
+  const Expr &m_Expr;
+  T m_Init;
+  Op m_Op;
+  std::vector<T> &m_Output;
+
+  LazyReduceFunctor(const Expr &expr, T init, Op op, std::vector<T> &output)
+    : m_Expr(expr), m_Init(init), m_Op(op), m_Output(output) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t b = begin;b < end;++b)
+      m_Output[b] = lazyReduceBlock(m_Expr, b, m_Init, m_Op);
+  }
+};
+
+// Reduces the values of `expr` with `op`, which must be associative and
+// have `init` as its identity: each block is reduced from `init`, and the
+// results of the blocks are combined from first to last.
+template <typename Expr, typename T, typename Op>
+T lazyReduce(const Expr &expr, T init, Op op, int numThreads = -1)
+{
+  std::vector<T> blocks(numLazyBlocks(expr.size()), init);
+  LazyReduceFunctor<Expr, T, Op> functor(expr, init, op, blocks);
+  RcppParallel::parallelFor(0, blocks.size(), functor, 1, numThreads);
+
+  T out = init;
+  for (std::size_t b = 0;b < blocks.size();++b)
+    out = op(out, blocks[b]);
+  return out;
+}
+
+template <typename Expr>
+struct LazySumFunctor : public RcppParallel::Worker
+{
+  const Expr &m_Expr;
+  std::vector<double> &m_Output;
+
+  LazySumFunctor(const Expr &expr, std::vector<double> &output)
+    : m_Expr(expr), m_Output(output) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t b = begin;b < end;++b)
+      m_Output[b] = lazySumBlock(m_Expr, b);
+  }
+};
+
+// Sum of the values of `expr`, added pairwise within and across blocks.
+template <typename Expr>
+double lazySum(const Expr &expr, int numThreads = -1)
+{
+  std::vector<double> blocks(numLazyBlocks(expr.size()));
+  LazySumFunctor<Expr> functor(expr, blocks);
+  RcppParallel::parallelFor(0, blocks.size(), functor, 1, numThreads);
+  return pairwiseSum(blocks.data(), blocks.size());
+}
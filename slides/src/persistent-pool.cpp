@@ -0,0 +1,48 @@
+#include <Rcpp.h>
+
+// [[Rcpp::plugins(cpp11)]]
+
+#include "persistent-pool.h"
+
+// Same as `rcpp_thread_example1()`, on the pool of the process and with one
+// task per range of indices.
+// [[Rcpp::export]]
+std::vector<unsigned int> pool_example1(unsigned int n,
+                                        unsigned int ncores)
+{
+  PersistentPool &pool = PersistentPool::instance(ncores);
+  std::vector<unsigned int> x(n);
+  pool.pushBatch(0, n, [&x] (std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin;i < end;++i)
+      x[i] = i;
+  });
+  pool.wait();
+  return x;
+}
+
+// Same as `rcpp_thread_example2()`, without futures: the results are written
+// in place.
+// [[Rcpp::export]]
+std::vector<unsigned int> pool_example2(unsigned int n,
+                                        unsigned int ncores)
+{
+  PersistentPool &pool = PersistentPool::instance(ncores);
+
+  std::vector<unsigned int> x(n);
+  for (unsigned int i = 0;i < n;++i)
+    x[i] = i + 1;
+
+  std::vector<unsigned int> results(n);
+  pool.mapReturn(results, [&x] (std::size_t i) {
+    return x[i] * x[i];
+  });
+
+  return results;
+}
+
+// Number of threads of the pool, 0 until the first call.
+// [[Rcpp::export]]
+unsigned int pool_size()
+{
+  return PersistentPool::instance().size();
+}
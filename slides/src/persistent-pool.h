@@ -0,0 +1,202 @@
+//---------------------------------
+// A thread pool that outlives the calls from R.
+//
+// Creating an `RcppThread::ThreadPool` on every call starts and joins its
+// threads every time, and `pushReturn()` allocates a `std::future` per task:
+// for small inputs, that is most of the time of the call. `PersistentPool`
+// keeps its workers between calls, resizes itself when asked for another
+// number of threads, and takes ranges of indices as single tasks, whose
+// results go into a vector allocated beforehand.
+//
+// The pool does not talk to R: tasks must not call the R API, and `wait()`
+// does not check for user interrupts.
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PersistentPool
+{
+public:
+  explicit PersistentPool(std::size_t numThreads = 0)
+  {
+    resize(numThreads);
+  }
+
+  PersistentPool(const PersistentPool &) = delete;
+  PersistentPool &operator=(const PersistentPool &) = delete;
+
+  ~PersistentPool()
+  {
+    resize(0);
+  }
+
+  // The pool of the process, created without workers on the first call.
+  // Its threads are joined when the program, or the shared library compiled
+  // by `Rcpp::sourceCpp()`, is unloaded. It must only be used from the main
+  // thread.
+  static PersistentPool &instance()
+  {
+    static PersistentPool pool;
+    return pool;
+  }
+
+  // The pool of the process, resized to `numThreads` if needed.
+  static PersistentPool &instance(std::size_t numThreads)
+  {
+    PersistentPool &pool = instance();
+    if (pool.size() != numThreads)
+      pool.resize(numThreads);
+    return pool;
+  }
+
+  std::size_t size() const
+  {
+    return m_Workers.size();
+  }
+
+  // Waits for the pending tasks, then starts or stops workers. With 0
+  // workers, tasks run on the calling thread when pushed.
+  void resize(std::size_t numThreads)
+  {
+    wait();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_NumWorkers = numThreads;
+    m_TaskAvailable.notify_all();
+    lock.unlock();
+
+    // Workers beyond the new size see it and return.
+    while (m_Workers.size() > numThreads)
+    {
+      m_Workers.back().join();
+      m_Workers.pop_back();
+    }
+    while (m_Workers.size() < numThreads)
+    {
+      std::size_t id = m_Workers.size();
+      m_Workers.emplace_back([this, id] { work(id); });
+    }
+  }
+
+  template <typename Task>
+  void push(Task task)
+  {
+    if (m_Workers.empty())
+    {
+      runTask(task);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Tasks.emplace_back(std::move(task));
+    ++m_NumPending;
+    m_TaskAvailable.notify_one();
+  }
+
+  // Splits [begin, end) into `numBatches` ranges of consecutive indices, or
+  // into 4 per worker if 0, and pushes each as a single task calling
+  // `task(rangeBegin, rangeEnd)`.
+  template <typename Task>
+  void pushBatch(std::size_t begin, std::size_t end, Task task, std::size_t numBatches = 0)
+  {
+    if (end <= begin)
+      return;
+
+    std::size_t n = end - begin;
+    if (numBatches == 0)
+      numBatches = 4 * std::max<std::size_t>(1, size());
+    numBatches = std::min(numBatches, n);
+
+    // The first `n % numBatches` ranges get one more index.
+    std::size_t batchSize = n / numBatches;
+    std::size_t numLarger = n % numBatches;
+    std::size_t rangeBegin = begin;
+    for (std::size_t b = 0;b < numBatches;++b)
+    {
+      std::size_t rangeEnd = rangeBegin + batchSize + (b < numLarger ? 1 : 0);
+      push([task, rangeBegin, rangeEnd] { task(rangeBegin, rangeEnd); });
+      rangeBegin = rangeEnd;
+    }
+  }
+
+  // Writes `task(i)` into results[i] for each i < results.size(), in
+  // batches, and waits for them. `results` is sized by the caller.
+  template <typename Result, typename Task>
+  void mapReturn(std::vector<Result> &results, Task task, std::size_t numBatches = 0)
+  {
+    Result *out = results.data();
+    pushBatch(0, results.size(), [out, &task] (std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin;i < end;++i)
+        out[i] = task(i);
+    }, numBatches);
+    wait();
+  }
+
+  // Waits until all the tasks pushed so far are done, and rethrows the first
+  // exception thrown by one of them, if any.
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_AllDone.wait(lock, [this] { return m_NumPending == 0; });
+
+    std::exception_ptr error = m_Error;
+    m_Error = nullptr;
+    lock.unlock();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  template <typename Task>
+  void runTask(Task &task)
+  {
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      if (!m_Error)
+        m_Error = std::current_exception();
+    }
+  }
+
+  void work(std::size_t id)
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+      m_TaskAvailable.wait(lock, [this, id] { return id >= m_NumWorkers || !m_Tasks.empty(); });
+      if (id >= m_NumWorkers)
+        return;
+
+      std::function<void()> task = std::move(m_Tasks.front());
+      m_Tasks.pop_front();
+      lock.unlock();
+
+      runTask(task);
+
+      lock.lock();
+      if (--m_NumPending == 0)
+        m_AllDone.notify_all();
+    }
+  }
+
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_TaskAvailable;
+  std::condition_variable m_AllDone;
+  std::size_t m_NumWorkers = 0;
+  std::size_t m_NumPending = 0;
+  std::exception_ptr m_Error;
+};
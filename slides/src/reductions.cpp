@@ -0,0 +1,155 @@
+//---------------------------------
+#include <Rcpp.h>
+
+// [[Rcpp::depends(RcppParallel)]]
+#include <RcppParallel.h>
+
+// // [[Rcpp::plugins(openmp)]] // Uncomment on Windows and Linux
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "reductions.h"
+
+// [[Rcpp::export]]
+bool all_finite_simd(Rcpp::NumericVector x)
+{
+  return allFinite(x.begin(), x.size());
+}
+
+// [[Rcpp::export]]
+bool all_finite_simd_omp(Rcpp::NumericVector x, unsigned int ncores)
+{
+  RcppParallel::RVector<double> wx(x);
+  std::size_t n = wx.length();
+  std::size_t numBlocks = numReductionBlocks(n);
+  std::atomic<bool> found(false);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ncores)
+#endif
+  for (std::size_t b = 0;b < numBlocks;++b)
+    findNonFiniteBlocks(wx.begin(), n, b, b + 1, found);
+
+  return !found.load();
+}
+
+struct AllFiniteFunctor : public RcppParallel::Worker
+{
+  const RcppParallel::RVector<double> m_InputVector;
+  std::atomic<bool> &m_Found;
+
+  AllFiniteFunctor(const Rcpp::NumericVector input, std::atomic<bool> &found)
+    : m_InputVector(input), m_Found(found) {}
+
+  // Works on blocks rather than values.
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    findNonFiniteBlocks(m_InputVector.begin(), m_InputVector.length(), begin, end, m_Found);
+  }
+};
+
+// [[Rcpp::export]]
+bool all_finite_parallel_impl(Rcpp::NumericVector x)
+{
+  std::atomic<bool> found(false);
+  AllFiniteFunctor allFiniteFunctor(x, found);
+  RcppParallel::parallelFor(0, numReductionBlocks(x.size()), allFiniteFunctor, 16);
+  return !found.load();
+}
+
+// Reduces each block of `input` independently into `output`, which the
+// caller then combines in a fixed order: unlike `parallelReduce()`, whose
+// joins depend on how the work was split, the result does not depend on the
+// number of threads.
+template <typename Output, Output (*reduceBlock)(const double *, std::size_t)>
+struct BlockReductionFunctor : public RcppParallel::Worker
+{
+  const RcppParallel::RVector<double> m_InputVector;
+  std::vector<Output> &m_Output;
+
+  BlockReductionFunctor(const Rcpp::NumericVector input, std::vector<Output> &output)
+    : m_InputVector(input), m_Output(output) {}
+
+  void operator()(std::size_t begin, std::size_t end)
+  {
+    std::size_t n = m_InputVector.length();
+    for (std::size_t b = begin;b < end;++b)
+    {
+      std::size_t offset = b * REDUCTION_BLOCK_SIZE;
+      m_Output[b] = reduceBlock(m_InputVector.begin() + offset, std::min(REDUCTION_BLOCK_SIZE, n - offset));
+    }
+  }
+};
+
+template <typename Output, Output (*reduceBlock)(const double *, std::size_t)>
+static std::vector<Output> reduceBlocksOmp(Rcpp::NumericVector x, unsigned int ncores)
+{
+  RcppParallel::RVector<double> wx(x);
+  std::size_t n = wx.length();
+  std::size_t numBlocks = numReductionBlocks(n);
+  std::vector<Output> out(numBlocks);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(ncores)
+#endif
+  for (std::size_t b = 0;b < numBlocks;++b)
+  {
+    std::size_t offset = b * REDUCTION_BLOCK_SIZE;
+    out[b] = reduceBlock(wx.begin() + offset, std::min(REDUCTION_BLOCK_SIZE, n - offset));
+  }
+
+  return out;
+}
+
+template <typename Output, Output (*reduceBlock)(const double *, std::size_t)>
+static std::vector<Output> reduceBlocksParallel(Rcpp::NumericVector x)
+{
+  std::vector<Output> out(numReductionBlocks(x.size()));
+  BlockReductionFunctor<Output, reduceBlock> functor(x, out);
+  RcppParallel::parallelFor(0, out.size(), functor);
+  return out;
+}
+
+static Rcpp::List statsToList(const VectorStats &stats)
+{
+  // NA in, NA out, as `sum()`, `mean()` or `var()` without `na.rm = TRUE`.
+  bool na = stats.anyNA;
+  return Rcpp::List::create(
+    Rcpp::Named("any_na") = stats.anyNA,
+    Rcpp::Named("min") = na ? NA_REAL : stats.min,
+    Rcpp::Named("max") = na ? NA_REAL : stats.max,
+    Rcpp::Named("sum") = na ? NA_REAL : stats.sum,
+    Rcpp::Named("mean") = na || stats.count == 0 ? NA_REAL : stats.mean,
+    Rcpp::Named("var") = na ? NA_REAL : stats.variance()
+  );
+}
+
+// [[Rcpp::export]]
+double sum_pairwise_omp(Rcpp::NumericVector x, unsigned int ncores)
+{
+  std::vector<double> sums = reduceBlocksOmp<double, pairwiseSum>(x, ncores);
+  return pairwiseSum(sums.data(), sums.size());
+}
+
+// [[Rcpp::export]]
+double sum_pairwise_parallel_impl(Rcpp::NumericVector x)
+{
+  std::vector<double> sums = reduceBlocksParallel<double, pairwiseSum>(x);
+  return pairwiseSum(sums.data(), sums.size());
+}
+
+// [[Rcpp::export]]
+Rcpp::List vector_stats_omp(Rcpp::NumericVector x, unsigned int ncores)
+{
+  std::vector<VectorStats> stats = reduceBlocksOmp<VectorStats, blockStats>(x, ncores);
+  return statsToList(mergeStatsPairwise(stats.data(), stats.size()));
+}
+
+// [[Rcpp::export]]
+Rcpp::List vector_stats_parallel_impl(Rcpp::NumericVector x)
+{
+  std::vector<VectorStats> stats = reduceBlocksParallel<VectorStats, blockStats>(x);
+  return statsToList(mergeStatsPairwise(stats.data(), stats.size()));
+}
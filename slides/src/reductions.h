@@ -0,0 +1,239 @@
+//---------------------------------
+// Reductions over the values of a numeric vector, for the threadsafe
+// `RVector` wrappers of RcppParallel or any other contiguous storage.
+//
+// The values are split in blocks of `REDUCTION_BLOCK_SIZE`, whose boundaries
+// do not depend on the number of threads. Each block is reduced on its own,
+// in a fixed order, and the results of the blocks are combined pairwise, also
+// in a fixed order, so that sums, means and variances are bit-identical for
+// any number of threads. Pairwise summation also keeps the rounding error in
+// O(log n) instead of O(n) for a running sum.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Values per block: 32 kB, which fits in the L1 cache so that the two passes
+// of `blockStats()` only read memory once.
+const std::size_t REDUCTION_BLOCK_SIZE = 4096;
+
+inline std::size_t numReductionBlocks(std::size_t n)
+{
+  return (n + REDUCTION_BLOCK_SIZE - 1) / REDUCTION_BLOCK_SIZE;
+}
+
+// Whether x[0], ..., x[n - 1] are all finite: x - x is 0 for finite values
+// and NaN for infinities, NaN and NA, and NaN stays NaN once added. Unlike
+// testing the sum of the values, this cannot overflow, and the 8 interleaved
+// running sums vectorize as in `pairwiseSum()`.
+inline bool allFiniteBlock(const double *x, std::size_t n)
+{
+  double lanes[8] = {};
+  std::size_t i = 0;
+  for (;i + 8 <= n;i += 8)
+  {
+    for (std::size_t l = 0;l < 8;++l)
+      lanes[l] += x[i + l] - x[i + l];
+  }
+
+  double flags = 0.0;
+  for (;i < n;++i)
+    flags += x[i] - x[i];
+  for (std::size_t l = 0;l < 8;++l)
+    flags += lanes[l];
+
+  return flags == 0.0;
+}
+
+// Checks the blocks [beginBlock, endBlock) of x[0], ..., x[n - 1] in turn and
+// sets `found` on the first value that is not finite. Threads sharing `found`
+// skip their remaining blocks as soon as one of them sets it.
+inline void findNonFiniteBlocks(const double *x,
+                                std::size_t n,
+                                std::size_t beginBlock,
+                                std::size_t endBlock,
+                                std::atomic<bool> &found)
+{
+  for (std::size_t b = beginBlock;b < endBlock;++b)
+  {
+    if (found.load(std::memory_order_relaxed))
+      return;
+
+    std::size_t begin = b * REDUCTION_BLOCK_SIZE;
+    std::size_t size = std::min(REDUCTION_BLOCK_SIZE, n - begin);
+    if (!allFiniteBlock(x + begin, size))
+      found.store(true, std::memory_order_relaxed);
+  }
+}
+
+inline bool allFinite(const double *x, std::size_t n)
+{
+  std::atomic<bool> found(false);
+  findNonFiniteBlocks(x, n, 0, numReductionBlocks(n), found);
+  return !found.load(std::memory_order_relaxed);
+}
+
+// Sum of x[0], ..., x[n - 1]: 8 interleaved running sums up to 128 values,
+// which vectorize, and the sums of the two halves beyond. The order of the
+// additions only depends on n.
+inline double pairwiseSum(const double *x, std::size_t n)
+{
+  if (n <= 128)
+  {
+    double lanes[8] = {};
+    std::size_t i = 0;
+    for (;i + 8 <= n;i += 8)
+    {
+      for (std::size_t l = 0;l < 8;++l)
+        lanes[l] += x[i + l];
+    }
+
+    double sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+      ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (;i < n;++i)
+      sum += x[i];
+    return sum;
+  }
+
+  std::size_t half = n / 2 / 8 * 8;
+  return pairwiseSum(x, half) + pairwiseSum(x + half, n - half);
+}
+
+// Number of values, NaN or NA among them, extrema, sum, mean and sum of
+// squared deviations from the mean of the values that are not NaN, or of all
+// of them when `anyNA` is false.
+struct VectorStats
+{
+  std::size_t count = 0;
+  bool anyNA = false;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  double sum = 0.0;
+  double mean = 0.0;
+  double m2 = 0.0;
+
+  // Unbiased variance, as `var()` in R.
+  double variance() const
+  {
+    return count > 1 ? m2 / (count - 1) : std::numeric_limits<double>::quiet_NaN();
+  }
+};
+
+// Statistics of x[0], ..., x[n - 1], in a first pass for the number of NaN,
+// the extrema and the sum and in a second one for the deviations from the
+// mean, which is more accurate than summing squares.
+inline VectorStats blockStats(const double *x, std::size_t n)
+{
+  VectorStats out;
+
+  double sum[8] = {};
+  double min[8], max[8];
+  std::size_t numNaN[8] = {};
+  std::fill(min, min + 8, out.min);
+  std::fill(max, max + 8, out.max);
+  std::size_t i = 0;
+  for (;i + 8 <= n;i += 8)
+  {
+    for (std::size_t l = 0;l < 8;++l)
+    {
+      double value = x[i + l];
+      bool isNaN = value != value;
+      numNaN[l] += isNaN;
+      sum[l] += isNaN ? 0.0 : value;
+      min[l] = value < min[l] ? value : min[l];
+      max[l] = value > max[l] ? value : max[l];
+    }
+  }
+  for (;i < n;++i)
+  {
+    double value = x[i];
+    bool isNaN = value != value;
+    numNaN[0] += isNaN;
+    sum[0] += isNaN ? 0.0 : value;
+    min[0] = value < min[0] ? value : min[0];
+    max[0] = value > max[0] ? value : max[0];
+  }
+
+  std::size_t nans = 0;
+  for (std::size_t l = 0;l < 8;++l)
+  {
+    nans += numNaN[l];
+    out.min = std::min(out.min, min[l]);
+    out.max = std::max(out.max, max[l]);
+  }
+  out.count = n - nans;
+  out.anyNA = nans > 0;
+  out.sum = ((sum[0] + sum[1]) + (sum[2] + sum[3])) + ((sum[4] + sum[5]) + (sum[6] + sum[7]));
+  if (out.count == 0)
+    return out;
+  out.mean = out.sum / out.count;
+
+  // The sum of finite values overflowed: the mean is summed from the values
+  // divided by their number instead.
+  if (!std::isfinite(out.sum) && std::isfinite(out.min) && std::isfinite(out.max))
+  {
+    double mean = 0.0;
+    for (i = 0;i < n;++i)
+      mean += x[i] != x[i] ? 0.0 : x[i] / out.count;
+    out.mean = mean;
+  }
+
+  double m2[8] = {};
+  for (i = 0;i + 8 <= n;i += 8)
+  {
+    for (std::size_t l = 0;l < 8;++l)
+    {
+      double deviation = x[i + l] - out.mean;
+      m2[l] += deviation != deviation ? 0.0 : deviation * deviation;
+    }
+  }
+  for (;i < n;++i)
+  {
+    double deviation = x[i] - out.mean;
+    m2[0] += deviation != deviation ? 0.0 : deviation * deviation;
+  }
+  out.m2 = ((m2[0] + m2[1]) + (m2[2] + m2[3])) + ((m2[4] + m2[5]) + (m2[6] + m2[7]));
+
+  return out;
+}
+
+// Statistics of the union of the values of `a` and `b` (Chan et al.). The
+// mean is updated from the two means rather than divided from the sum, so
+// that it stays finite when the sum overflows.
+inline VectorStats mergeStats(const VectorStats &a, const VectorStats &b)
+{
+  if (b.count == 0 || a.count == 0)
+  {
+    VectorStats out = b.count == 0 ? a : b;
+    out.anyNA = a.anyNA || b.anyNA;
+    return out;
+  }
+
+  VectorStats out;
+  out.count = a.count + b.count;
+  out.anyNA = a.anyNA || b.anyNA;
+  out.min = std::min(a.min, b.min);
+  out.max = std::max(a.max, b.max);
+  out.sum = a.sum + b.sum;
+
+  double weight = static_cast<double>(b.count) / out.count;
+  double delta = b.mean - a.mean;
+  out.mean = a.mean + delta * weight;
+  out.m2 = a.m2 + b.m2 + delta * delta * a.count * weight;
+  return out;
+}
+
+// Merges stats[0], ..., stats[n - 1] pairwise, in an order that only depends
+// on n.
+inline VectorStats mergeStatsPairwise(const VectorStats *stats, std::size_t n)
+{
+  if (n == 0)
+    return VectorStats();
+  if (n == 1)
+    return stats[0];
+
+  std::size_t half = n / 2;
+  return mergeStats(mergeStatsPairwise(stats, half), mergeStatsPairwise(stats + half, n - half));
+}
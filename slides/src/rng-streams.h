@@ -0,0 +1,90 @@
+//---------------------------------
+// Reproducible parallel random numbers with the counter-based generator of
+// sitmo.
+//
+// The outputs are split in chunks of `RNG_STREAM_CHUNK_SIZE` indices, and the
+// generator of each chunk is keyed by the seed and the index of the chunk.
+// The draws of an output only depend on the seed and on its index, never on
+// which thread computes it, so the results are bit-identical for any number
+// of threads and any schedule.
+#pragma once
+#include <sitmo.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Output indices per chunk.
+const std::size_t RNG_STREAM_CHUNK_SIZE = 1024;
+
+// Draws generated at once by the batched functions.
+const std::size_t RNG_BATCH_SIZE = 256;
+
+inline std::size_t numRngChunks(std::size_t n)
+{
+  return (n + RNG_STREAM_CHUNK_SIZE - 1) / RNG_STREAM_CHUNK_SIZE;
+}
+
+// Sets `eng` at the start of the stream of the `chunk`-th chunk of outputs
+// for `seed`. The 256-bit counter starts at zero in each stream, which leaves
+// 2^64 blocks of 8 draws before it wraps.
+inline void setChunkStream(sitmo::prng &eng, std::uint32_t seed, std::uint64_t chunk)
+{
+  eng.set_key(seed, chunk);
+  eng.set_counter();
+}
+
+// Uniform value in (0, 1) from 32 random bits, never 0 so that its logarithm
+// is finite. The bits go through a signed integer, the only one that SSE2 and
+// AVX2 convert to double, so that loops over a batch vectorize.
+inline double uniformFromBits(std::uint32_t bits)
+{
+  double value = static_cast<double>(static_cast<std::int32_t>(bits ^ 0x80000000u));
+  return (value + 2147483648.5) * (1.0 / 4294967296.0);
+}
+
+// Fills out[0], ..., out[n - 1] with uniform values in (0, 1): the draws of a
+// batch are stored first, then converted in a separate loop.
+inline void uniformBatch(sitmo::prng &eng, double *out, std::size_t n)
+{
+  std::uint32_t bits[RNG_BATCH_SIZE];
+  for (std::size_t begin = 0;begin < n;begin += RNG_BATCH_SIZE)
+  {
+    std::size_t size = std::min(RNG_BATCH_SIZE, n - begin);
+    for (std::size_t i = 0;i < size;++i)
+      bits[i] = eng();
+    for (std::size_t i = 0;i < size;++i)
+      out[begin + i] = uniformFromBits(bits[i]);
+  }
+}
+
+// Standard normal values by the Box-Muller transform, two per pair of
+// uniform values. An odd `n` draws one pair more than it uses.
+inline void normalBatch(sitmo::prng &eng, double *out, std::size_t n)
+{
+  const double twoPi = 6.283185307179586;
+  double u[RNG_BATCH_SIZE];
+  for (std::size_t begin = 0;begin < n;begin += RNG_BATCH_SIZE)
+  {
+    std::size_t size = std::min(RNG_BATCH_SIZE, n - begin);
+    std::size_t numPairs = (size + 1) / 2;
+    uniformBatch(eng, u, 2 * numPairs);
+    for (std::size_t p = 0;p < numPairs;++p)
+    {
+      double radius = std::sqrt(-2.0 * std::log(u[2 * p]));
+      double angle = twoPi * u[2 * p + 1];
+      out[begin + 2 * p] = radius * std::cos(angle);
+      if (2 * p + 1 < size)
+        out[begin + 2 * p + 1] = radius * std::sin(angle);
+    }
+  }
+}
+
+// Standard exponential values by inversion.
+inline void exponentialBatch(sitmo::prng &eng, double *out, std::size_t n)
+{
+  uniformBatch(eng, out, n);
+  for (std::size_t i = 0;i < n;++i)
+    out[i] = -std::log(out[i]);
+}
@@ -0,0 +1,117 @@
+//---------------------------------
+#include <Rcpp.h>
+#include <sitmo.h>
+
+// // [[Rcpp::plugins(openmp)]] // Uncomment on Windows and Linux
+
+// [[Rcpp::depends(sitmo)]]
+
+#include <algorithm>
+#include <string>
+
+#include "rng-streams.h"
+
+// [[Rcpp::export]]
+Rcpp::NumericVector sumunif_sitmo_streams(unsigned int n,
+                                          unsigned int nstep,
+                                          unsigned int seed,
+                                          unsigned int ncores)
+{
+  Rcpp::NumericVector out(n);
+  double *values = out.begin();
+  std::size_t numChunks = numRngChunks(n);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(ncores)
+#endif
+  for (std::size_t c = 0;c < numChunks;++c)
+  {
+    // Everything a chunk needs is local to its iteration.
+    sitmo::prng eng;
+    setChunkStream(eng, seed, c);
+    double draws[RNG_BATCH_SIZE];
+
+    std::size_t end = std::min<std::size_t>(n, (c + 1) * RNG_STREAM_CHUNK_SIZE);
+    for (std::size_t i = c * RNG_STREAM_CHUNK_SIZE;i < end;++i)
+    {
+      double sum = 0.0;
+      for (std::size_t k = 0;k < nstep;k += RNG_BATCH_SIZE)
+      {
+        std::size_t size = std::min<std::size_t>(RNG_BATCH_SIZE, nstep - k);
+        uniformBatch(eng, draws, size);
+        for (std::size_t j = 0;j < size;++j)
+          sum += draws[j];
+      }
+      values[i] = sum;
+    }
+  }
+
+  return out;
+}
+
+// n values location + scale * X, with X of the standard distribution `type`,
+// the chunks of the output being filled in parallel from their own streams.
+static Rcpp::NumericVector randomStreams(unsigned int n,
+                                         unsigned int seed,
+                                         unsigned int ncores,
+                                         const std::string &type,
+                                         double location = 0.0,
+                                         double scale = 1.0)
+{
+  void (*fillBatch)(sitmo::prng &, double *, std::size_t) = uniformBatch;
+  if (type == "normal")
+    fillBatch = normalBatch;
+  else if (type == "exponential")
+    fillBatch = exponentialBatch;
+
+  Rcpp::NumericVector out(n);
+  double *values = out.begin();
+  std::size_t numChunks = numRngChunks(n);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(ncores)
+#endif
+  for (std::size_t c = 0;c < numChunks;++c)
+  {
+    sitmo::prng eng;
+    setChunkStream(eng, seed, c);
+    std::size_t begin = c * RNG_STREAM_CHUNK_SIZE;
+    std::size_t size = std::min<std::size_t>(RNG_STREAM_CHUNK_SIZE, n - begin);
+    fillBatch(eng, values + begin, size);
+    if (location != 0.0 || scale != 1.0)
+    {
+      for (std::size_t i = begin;i < begin + size;++i)
+        values[i] = location + scale * values[i];
+    }
+  }
+
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector runif_streams(unsigned int n, unsigned int seed, unsigned int ncores = 1)
+{
+  return randomStreams(n, seed, ncores, "uniform");
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector rnorm_streams(unsigned int n,
+                                  unsigned int seed,
+                                  unsigned int ncores = 1,
+                                  double mean = 0.0,
+                                  double sd = 1.0)
+{
+  return randomStreams(n, seed, ncores, "normal", mean, sd);
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector rexp_streams(unsigned int n,
+                                 unsigned int seed,
+                                 unsigned int ncores = 1,
+                                 double rate = 1.0)
+{
+  if (rate <= 0.0)
+    Rcpp::stop("The rate should be positive.");
+
+  return randomStreams(n, seed, ncores, "exponential", 0.0, 1.0 / rate);
+}